@@ -0,0 +1,459 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// engine API definitions, platform independend helpers available for game code
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SSE2 is used where it helps, otherwise plain code is used
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// number of set bits
+inline int BitCount(uint32_t value)
+{
+#if defined(_MSC_VER)
+    return int(__popcnt(value));
+#else
+    return __builtin_popcount(value);
+#endif
+}
+
+
+// index of lowest set bit, value should not be zero
+inline int BitScan(uint32_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return int(index);
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+
+// deterministic pseudo random number generator (splitmix64)
+// game logic uses it instead of rand(), so games started with same seed
+// always play the same way on any platform
+class Random
+{
+public:
+    Random(uint64_t seed = 0) :
+        p_state(seed)
+    {}
+
+    void Seed(uint64_t seed) { p_state = seed; }
+
+    // current state, Seed() with it continues same sequence
+    uint64_t state() const { return p_state; }
+
+    uint32_t Next()
+    {
+        uint64_t z = (p_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return uint32_t((z ^ (z >> 31)) >> 32);
+    }
+
+    // random number in [0, range) range
+    uint32_t Next(uint32_t range) { return Next() % range; }
+
+private:
+    uint64_t p_state;
+};
+
+
+// linear allocator over caller supplied memory block
+// allocations are never freed one by one, whole arena is reset at once
+// returns nullptr when there's not enough memory left
+class Arena
+{
+public:
+    enum { ALIGNMENT = 16 };
+
+    Arena() :
+        p_memory(nullptr),
+        p_size(0),
+        p_used(0)
+    {}
+
+    Arena(void *memory, size_t size) :
+        p_memory(static_cast<uint8_t*>(memory)),
+        p_size(size),
+        p_used(0)
+    {}
+
+    // size rounded up to allocation alignment, use it to compute how much
+    // memory arena needs
+    static size_t Align(size_t size)
+    {
+        return (size + ALIGNMENT - 1) & ~size_t(ALIGNMENT - 1);
+    }
+
+    void *Allocate(size_t size)
+    {
+        // block itself could be not aligned, so align actual address
+        uintptr_t address = uintptr_t(p_memory + p_used);
+        size_t padding = size_t((ALIGNMENT - address % ALIGNMENT) % ALIGNMENT);
+
+        if (p_memory == nullptr || p_used + padding + size > p_size) {
+            return nullptr;
+        }
+
+        void *result = p_memory + p_used + padding;
+        p_used += padding + Align(size);
+        return result;
+    }
+
+    // allocates and default constructs array of objects
+    template <typename T>
+    T *New(size_t count)
+    {
+        T *result = static_cast<T*>(Allocate(sizeof(T) * count));
+        if (result) {
+            for (size_t n = 0; n < count; ++n) {
+                new (result + n) T();
+            }
+        }
+        return result;
+    }
+
+    void Reset() { p_used = 0; }
+
+    size_t size() const { return p_size; }
+    size_t used() const { return p_used; }
+
+private:
+    uint8_t *p_memory;
+    size_t   p_size;
+    size_t   p_used;
+};
+
+
+// streaming histogram with logarithmic buckets (HDR histogram style)
+// keeps fixed amount of memory regardless of number of recorded values,
+// relative error of reported values is below 2^-(HISTOGRAM_SUB_BITS - 1)
+// values are expected to be 32 bit (e.g. microseconds), larger ones are clamped
+enum HistogramBuckets
+{
+    HISTOGRAM_SUB_BITS     = 6,
+    HISTOGRAM_SUB_COUNT    = 1 << HISTOGRAM_SUB_BITS,
+    HISTOGRAM_HALF_COUNT   = HISTOGRAM_SUB_COUNT / 2,
+    HISTOGRAM_BUCKET_COUNT = (32 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_HALF_COUNT + HISTOGRAM_HALF_COUNT
+};
+
+class Histogram
+{
+public:
+    Histogram() { Reset(); }
+
+    void Reset();
+    void Record(uint64_t value);
+
+    // value below which given fraction (0..1) of recorded values are
+    uint64_t Percentile(double fraction) const;
+
+    uint64_t count() const { return p_count; }
+    uint64_t min() const { return p_count ? p_min : 0; }
+    uint64_t max() const { return p_max; }
+    double mean() const { return p_count ? double(p_sum) / double(p_count) : 0; }
+
+private:
+    static int BucketIndex(uint32_t value);
+    static uint64_t BucketTop(int index);
+
+private:
+    uint64_t p_count;
+    uint64_t p_sum;
+    uint64_t p_min;
+    uint64_t p_max;
+    uint32_t p_buckets[HISTOGRAM_BUCKET_COUNT];
+};
+
+
+
+// frame pacing on any microsecond clock
+// platform sleeps for SleepTime() while it's non zero, then spins until
+// Ready(), then calls NextFrame() after each frame
+// sleep usually oversleeps, so the last part of the wait (margin) is spun,
+// margin follows oversleep reported with Slept()
+class FramePacer
+{
+public:
+    FramePacer() :
+        p_period(0),
+        p_deadline(0),
+        p_margin(2000)
+    {}
+
+    void Start(uint64_t now, uint64_t period)
+    {
+        p_period = period;
+        p_deadline = now;
+    }
+
+    // moves deadline to the next frame, frames which are late don't run
+    // back to back to catch up, deadline just skips to the next period
+    // boundary, so frames stay on the same grid
+    void NextFrame(uint64_t now)
+    {
+        p_deadline += p_period;
+        if (now > p_deadline && p_period > 0) {
+            p_deadline += (now - p_deadline + p_period - 1) / p_period * p_period;
+        }
+    }
+
+    uint64_t SleepTime(uint64_t now) const
+    {
+        uint64_t remaining = Ready(now) ? 0 : p_deadline - now;
+        return remaining > p_margin ? remaining - p_margin : 0;
+    }
+
+    bool Ready(uint64_t now) const { return now >= p_deadline; }
+
+    // grows margin right away when sleep overslept more than margin allows
+    // and slowly shrinks it back otherwise
+    void Slept(uint64_t requested, uint64_t actual)
+    {
+        uint64_t oversleep = actual > requested ? actual - requested : 0;
+        uint64_t margin = oversleep + oversleep / 4 + 200;
+
+        p_margin -= p_margin / 64;
+        p_margin = margin > p_margin ? margin : p_margin;
+        p_margin = p_margin < 500 ? 500 : p_margin;
+        p_margin = p_margin > p_period / 2 ? p_period / 2 : p_margin;
+    }
+
+    uint64_t deadline() const { return p_deadline; }
+
+private:
+    uint64_t p_period;   // frame period
+    uint64_t p_deadline; // time next frame should start
+    uint64_t p_margin;   // part of the wait which is spun
+};
+
+// bounded hash table from 64 bit key (like field hash) to 64 bit value
+// could be shared by many threads without any locks: entry stores value and
+// key xor value, torn entry written by two threads at once just doesn't match
+// its key and is treated as missing, new entries simply replace old ones
+class HashCache
+{
+public:
+    // capacity is rounded up to power of two
+    HashCache(size_t capacity)
+    {
+        p_capacity = 1;
+        while (p_capacity < capacity) {
+            p_capacity <<= 1;
+        }
+
+        p_entries = new Entry[p_capacity];
+        Clear();
+    }
+
+    ~HashCache()
+    {
+        delete[] p_entries;
+    }
+
+    void Clear()
+    {
+        // empty entry could only match key ~0
+        for (size_t n = 0; n < p_capacity; ++n) {
+            p_entries[n].check.store(~0ull, std::memory_order_relaxed);
+            p_entries[n].value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool Lookup(uint64_t key, uint64_t &value) const
+    {
+        const Entry &entry = p_entries[key & (p_capacity - 1)];
+        uint64_t entryvalue = entry.value.load(std::memory_order_relaxed);
+        uint64_t check = entry.check.load(std::memory_order_relaxed);
+
+        if ((check ^ entryvalue) != key) {
+            return false;
+        }
+
+        value = entryvalue;
+        return true;
+    }
+
+    void Store(uint64_t key, uint64_t value)
+    {
+        Entry &entry = p_entries[key & (p_capacity - 1)];
+        entry.value.store(value, std::memory_order_relaxed);
+        entry.check.store(key ^ value, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return p_capacity; }
+
+private:
+    HashCache(const HashCache&);
+    HashCache &operator=(const HashCache&);
+
+    struct Entry
+    {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> value;
+    };
+
+    Entry  *p_entries;
+    size_t  p_capacity;
+};
+
+
+// fixed size particle pool for visual effects
+// particles are kept in structure of arrays layout and updated 4 at a time,
+// dead particles are removed by compacting arrays, so live particles are
+// always first count() entries
+// all memory comes from arena, pool never allocates by itself
+class ParticlePool
+{
+public:
+    ParticlePool() :
+        p_x(nullptr),
+        p_y(nullptr),
+        p_vx(nullptr),
+        p_vy(nullptr),
+        p_life(nullptr),
+        p_fade(nullptr),
+        p_tag(nullptr),
+        p_capacity(0),
+        p_count(0)
+    {}
+
+    // memory pool needs for given capacity
+    static size_t MemorySize(size_t capacity)
+    {
+        return Arena::Align(sizeof(float) * Padded(capacity)) * 7;
+    }
+
+    void Allocate(Arena &arena, size_t capacity)
+    {
+        // arrays are padded to whole number of 4 particle blocks
+        size_t padded = Padded(capacity);
+        p_x = arena.New<float>(padded);
+        p_y = arena.New<float>(padded);
+        p_vx = arena.New<float>(padded);
+        p_vy = arena.New<float>(padded);
+        p_life = arena.New<float>(padded);
+        p_fade = arena.New<float>(padded);
+        p_tag = arena.New<uint32_t>(padded);
+        p_capacity = capacity;
+        p_count = 0;
+    }
+
+    void Clear() { p_count = 0; }
+
+    // adds particle which lives for given time (in seconds), tag is any user
+    // value kept with particle (like its color), when pool is full particle
+    // is dropped, so big bursts never cost more than pool capacity
+    bool Emit(float x, float y, float vx, float vy, float life, uint32_t tag)
+    {
+        if (p_count == p_capacity || life <= 0) {
+            return false;
+        }
+
+        size_t n = p_count++;
+        p_x[n] = x;
+        p_y[n] = y;
+        p_vx[n] = vx;
+        p_vy[n] = vy;
+        p_life[n] = life;
+        p_fade[n] = 1 / life;
+        p_tag[n] = tag;
+        return true;
+    }
+
+    // moves particles by their speed, gravity is added to vertical speed,
+    // particles which life is over are removed
+    void Update(float interval, float gravity)
+    {
+        if (p_count == 0) {
+            return;
+        }
+
+        // padding lanes past count are updated too, they're never read
+        size_t padded = Padded(p_count);
+
+#if defined(ENGINE_SSE2)
+        __m128 dt = _mm_set1_ps(interval);
+        __m128 dv = _mm_set1_ps(gravity * interval);
+        for (size_t n = 0; n < padded; n += 4) {
+            __m128 vy = _mm_add_ps(_mm_load_ps(p_vy + n), dv);
+            _mm_store_ps(p_x + n, _mm_add_ps(_mm_load_ps(p_x + n), _mm_mul_ps(_mm_load_ps(p_vx + n), dt)));
+            _mm_store_ps(p_y + n, _mm_add_ps(_mm_load_ps(p_y + n), _mm_mul_ps(vy, dt)));
+            _mm_store_ps(p_vy + n, vy);
+            _mm_store_ps(p_life + n, _mm_sub_ps(_mm_load_ps(p_life + n), dt));
+        }
+#else
+        for (size_t n = 0; n < padded; ++n) {
+            p_vy[n] += gravity * interval;
+            p_x[n] += p_vx[n] * interval;
+            p_y[n] += p_vy[n] * interval;
+            p_life[n] -= interval;
+        }
+#endif
+
+        // compact live particles to the front, without branches
+        size_t alive = 0;
+        for (size_t n = 0; n < p_count; ++n) {
+            size_t keep = p_life[n] > 0 ? 1 : 0;
+            p_x[alive] = p_x[n];
+            p_y[alive] = p_y[n];
+            p_vx[alive] = p_vx[n];
+            p_vy[alive] = p_vy[n];
+            p_life[alive] = p_life[n];
+            p_fade[alive] = p_fade[n];
+            p_tag[alive] = p_tag[n];
+            alive += keep;
+        }
+        p_count = alive;
+    }
+
+    size_t count() const { return p_count; }
+    size_t capacity() const { return p_capacity; }
+
+    float x(size_t n) const { return p_x[n]; }
+    float y(size_t n) const { return p_y[n]; }
+    uint32_t tag(size_t n) const { return p_tag[n]; }
+
+    // part of particle life left, 1 when emitted and 0 when it dies
+    float fade(size_t n) const { return p_life[n] * p_fade[n]; }
+
+private:
+    ParticlePool(const ParticlePool&);
+    ParticlePool &operator=(const ParticlePool&);
+
+    static size_t Padded(size_t capacity) { return (capacity + 3) & ~size_t(3); }
+
+private:
+    float    *p_x;
+    float    *p_y;
+    float    *p_vx;
+    float    *p_vy;
+    float    *p_life;  // time left in seconds
+    float    *p_fade;  // 1 / initial life
+    uint32_t *p_tag;
+    size_t    p_capacity;
+    size_t    p_count;
+};
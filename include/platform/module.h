@@ -0,0 +1,76 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// game module interface
+// game could be built as shared library (tetris.cpp compiled with
+// GAME_MODULE defined), then platform host loads it at runtime and reloads
+// it when it gets rebuilt
+// all game state lives in single memory block owned by host, so game
+// survives module reload as long as state layout stays the same
+//
+// this isn't plain C ABI: host services go through PlatformAPI, GraphicsAPI
+// and AudioAPI objects, so module depends on their vtable layout, and on
+// layout of Input and other structs passed by pointer, host and module
+// have to be built with the same compiler, and any change to these classes
+// and structs (even adding virtual function at the end) needs
+// GAME_MODULE_VERSION bump, host refuses module of other version
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "platform/platform.h"
+
+
+// 1 - first version
+// 2 - audio
+// 3 - pause and idle
+// 4 - GraphicsAPI::Rectangles() added before GetRenderTargetSize()
+// 5 - GraphicsAPI::Glyphs()
+enum GameModuleVersion
+{
+    GAME_MODULE_VERSION = 5 // changes when this interface changes
+};
+
+extern "C" {
+
+struct GameModule
+{
+    uint32_t version;      // GAME_MODULE_VERSION module was built with
+    uint64_t state_layout; // changes with game state layout, state is dropped then
+    size_t   state_size;   // size of game state memory block, block should be
+                           // 16 byte aligned
+
+    // starts new game in state memory block
+    void (*init)(void *state, uint64_t seed);
+
+    // called once for kept state after module is reloaded
+    void (*reload)(void *state);
+
+    void (*input)(void *state, PlatformAPI *api, const Input *input);
+    void (*update)(void *state, float interval);
+    void (*render)(void *state, GraphicsAPI *api, int width, int height);
+
+    // game sounds are loaded once after init, sounds already loaded by
+    // previous module stay as they are
+    void (*load_audio)(void *state, AudioAPI *api);
+    void (*audio)(void *state, AudioAPI *api);
+
+    // host pauses game when its window goes to background
+    void (*pause)(void *state);
+
+    // nonzero when game is paused and already rendered, so host could
+    // wait for input instead of running frames
+    int (*idle)(void *state);
+};
+
+// the only function module exports
+typedef const GameModule *(*GetGameModuleFunction)();
+
+}
+
+#define GAME_MODULE_ENTRY "GetGameModule"
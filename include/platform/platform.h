@@ -10,7 +10,9 @@
 #pragma once
 
 
+#include <cstddef>
 #include <cstdint>
+#include "platform/font.h"
 
 
 // input declarations
@@ -242,7 +244,9 @@ enum InputEventType
     INPUT_BUTTON_DOWN, // joystick/gamepad button down
     INPUT_BUTTON_UP,   // joystick/gamepad button up
     INPUT_AXIS,        // joystick/gamepad axis change
-    INPUT_POV          // joystick/gamepad POV change
+    INPUT_POV,         // joystick/gamepad POV change
+    INPUT_CONNECT,     // joystick/gamepad attached, joystick.number is its slot
+    INPUT_DISCONNECT   // joystick/gamepad removed, its state is reset
 };
 
 enum InputEventCount
@@ -308,6 +312,7 @@ struct InputEventJoystick
 struct InputEvent
 {
     InputEventType type;
+    uint32_t       time; // event timestamp, milliseconds of system tick counter
     union {
         InputEventMouse    mouse;
         InputEventKeyboard keyboard;
@@ -321,9 +326,60 @@ struct Input
     InputKeyboardState keyboard;
     InputJoystickState joystick[JOYSTICK_DEVICE_COUNT];
     size_t             event_count;
+    size_t             event_dropped; // events lost because events array was full
     InputEvent         events[INPUT_EVENT_COUNT];
 };
 
+// source of input frames for the game
+// platform loop asks selected source for new input every frame, so game
+// could be driven by real devices, recorded or scripted input or a bot
+class InputSource
+{
+public:
+    virtual ~InputSource() {}
+
+    // adds new events (and state changes) to input, event count is already
+    // reset by platform loop, time is current frame time in milliseconds,
+    // interval holds real time since last frame in seconds, sources which
+    // replay recorded frames replace it with recorded one
+    // returns false when source has no more input
+    virtual bool NextFrame(Input &input, uint32_t time, float &interval) = 0;
+};
+
+
+// versus mode declarations
+
+enum VersusMessageType
+{
+    VERSUS_GARBAGE,  // count garbage rows with hole column for receiver
+    VERSUS_GAME_OVER // sender's game is over
+};
+
+// messages are small and fixed size, so transports just copy them
+struct VersusMessage
+{
+    VersusMessageType type;
+    uint32_t          time;  // send time, milliseconds of sender's frame time
+    int32_t           count;
+    int32_t           hole;
+};
+
+// one end of a link between two versus boards
+// game only sends and receives whole messages, so in-process link could be
+// replaced by network one later without touching the game
+class MessageTransport
+{
+public:
+    virtual ~MessageTransport() {}
+
+    // false when message can't be sent, like when link is full
+    virtual bool Send(const VersusMessage &message) = 0;
+
+    // takes next message delivered by time (milliseconds, same clock as
+    // message time), false when there's none
+    virtual bool Receive(VersusMessage &message, uint32_t time) = 0;
+};
+
 
 // graphics declarations
 
@@ -344,6 +400,30 @@ struct Color
 };
 
 
+// rectangle with its color, for drawing many rectangles at once
+struct ColoredRectangle
+{
+    float left;
+    float top;
+    float width;
+    float height;
+    Color color;
+};
+
+// glyph of built-in font (see font.h) stretched over rectangle
+struct GlyphQuad
+{
+    float    left;
+    float    top;
+    float    width;
+    float    height;
+    Color    color;
+    uint32_t glyph;  // glyph index, FontGlyph() of character
+};
+
+
+// PlatformAPI, AudioAPI and GraphicsAPI cross game module boundary, any
+// change to them needs GAME_MODULE_VERSION bump, see platform/module.h
 class PlatformAPI
 {
 public:
@@ -353,6 +433,29 @@ public:
 };
 
 
+// audio format of all sounds and output
+enum AudioFormat
+{
+    AUDIO_SAMPLE_RATE = 48000
+};
+
+// sounds are loaded once and then played by id, playing is only a request
+// to mixer which runs on its own thread, so calls never wait for audio
+class AudioAPI
+{
+public:
+    // sound is mono PCM at AUDIO_SAMPLE_RATE, samples in -1..1 range are
+    // copied, sound with given id could be loaded only once
+    virtual bool LoadSound(uint32_t sound, const float *samples, size_t count) = 0;
+
+    // starts new voice of sound, pan goes from -1 (left) to 1 (right)
+    virtual void Play(uint32_t sound, float volume, float pan) = 0;
+
+    // stops all voices of sound
+    virtual void Stop(uint32_t sound) = 0;
+};
+
+
 class GraphicsAPI
 {
 public:
@@ -360,6 +463,301 @@ public:
     virtual void Viewport(int left, int top, int width, int height) = 0;
     virtual void Rectangle(float left, float top, float width, float height, const Color &color) = 0;
 
+    // draws all rectangles in given order with single submission
+    virtual void Rectangles(const ColoredRectangle *rectangles, size_t count) = 0;
+
+    // draws glyphs from font atlas in given order with single submission,
+    // glyph pixels are drawn with quad color, rest of quad is left as is
+    virtual void Glyphs(const GlyphQuad *glyphs, size_t count) = 0;
+
 protected:
     virtual void GetRenderTargetSize(int &width, int &height) = 0;
 };
+
+
+// collects rectangles into caller supplied storage and draws them all at once
+// with GraphicsAPI::Rectangles() on Flush() or when storage is full
+class RectangleBatch
+{
+public:
+    RectangleBatch(GraphicsAPI &api, ColoredRectangle *storage, size_t capacity) :
+        p_api(api),
+        p_rectangles(storage),
+        p_capacity(capacity),
+        p_count(0)
+    {}
+
+    ~RectangleBatch()
+    {
+        Flush();
+    }
+
+    // same as GraphicsAPI::Rectangle(), transparent rectangles are skipped
+    void Rectangle(float left, float top, float width, float height, const Color &color)
+    {
+        if (color.a == 0) {
+            return;
+        }
+
+        if (p_capacity == 0) {
+            p_api.Rectangle(left, top, width, height, color);
+            return;
+        }
+
+        if (p_count == p_capacity) {
+            Flush();
+        }
+
+        ColoredRectangle &rectangle = p_rectangles[p_count++];
+        rectangle.left = left;
+        rectangle.top = top;
+        rectangle.width = width;
+        rectangle.height = height;
+        rectangle.color = color;
+    }
+
+    void Flush()
+    {
+        if (p_count > 0) {
+            p_api.Rectangles(p_rectangles, p_count);
+            p_count = 0;
+        }
+    }
+
+private:
+    RectangleBatch(const RectangleBatch&);
+    RectangleBatch &operator=(const RectangleBatch&);
+
+    GraphicsAPI      &p_api;
+    ColoredRectangle *p_rectangles;
+    size_t            p_capacity;
+    size_t            p_count;
+};
+
+
+// line of text laid out into glyph quads
+// layout is kept between frames and done again only when text or placement
+// changes, numbers are formatted only when their value changes, so label
+// could be set every frame without any formatting or allocation cost
+class TextLabel
+{
+public:
+    enum { CAPACITY = 32 };
+
+    TextLabel() :
+        p_prefix(nullptr),
+        p_suffix(nullptr),
+        p_number(0),
+        p_decimals(0),
+        p_length(0),
+        p_count(0),
+        p_x(0),
+        p_y(0),
+        p_size(0),
+        p_dirty(true)
+    {
+        p_text[0] = 0;
+    }
+
+    // position of top left corner, size is font pixel size
+    void Place(float x, float y, float size, const Color &color)
+    {
+        if (x != p_x || y != p_y || size != p_size ||
+            color.r != p_color.r || color.g != p_color.g || color.b != p_color.b || color.a != p_color.a)
+        {
+            p_x = x;
+            p_y = y;
+            p_size = size;
+            p_color = color;
+            p_dirty = true;
+        }
+    }
+
+    void SetText(const char *text)
+    {
+        p_prefix = nullptr;
+
+        size_t length = 0;
+        while (length < CAPACITY && text[length] == p_text[length] && text[length]) {
+            ++length;
+        }
+        if (length < CAPACITY && text[length] == p_text[length]) {
+            return;
+        }
+
+        length = 0;
+        while (length < CAPACITY && text[length]) {
+            p_text[length] = text[length];
+            ++length;
+        }
+        p_text[length] = 0;
+        p_length = length;
+        p_dirty = true;
+    }
+
+    // prefix, value and suffix, value is fixed point number with given
+    // count of decimal digits, prefix and suffix are expected to be literals,
+    // only their pointers are compared
+    void SetNumber(const char *prefix, int value, int decimals = 0, const char *suffix = "")
+    {
+        if (p_prefix == prefix && p_suffix == suffix && p_number == value && p_decimals == decimals) {
+            return;
+        }
+
+        p_prefix = prefix;
+        p_suffix = suffix;
+        p_number = value;
+        p_decimals = decimals;
+
+        size_t length = 0;
+        for (const char *c = prefix; *c && length < CAPACITY; ++c) {
+            p_text[length++] = *c;
+        }
+
+        // digits come out in reverse order
+        char digits[16];
+        int count = 0;
+        unsigned int magnitude = value < 0 ? 0u - unsigned(value) : unsigned(value);
+        do {
+            if (count > 0 && count == decimals) {
+                digits[count++] = '.';
+            }
+            digits[count++] = char('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0 || count <= decimals);
+
+        if (value < 0 && length < CAPACITY) {
+            p_text[length++] = '-';
+        }
+        while (count > 0 && length < CAPACITY) {
+            p_text[length++] = digits[--count];
+        }
+
+        for (const char *c = suffix; *c && length < CAPACITY; ++c) {
+            p_text[length++] = *c;
+        }
+
+        p_text[length] = 0;
+        p_length = length;
+        p_dirty = true;
+    }
+
+    // laid out glyphs, spaces take no glyphs
+    const GlyphQuad *glyphs()
+    {
+        Layout();
+        return p_glyphs;
+    }
+
+    size_t count()
+    {
+        Layout();
+        return p_count;
+    }
+
+    float width() const { return p_length * FONT_ADVANCE * p_size; }
+    float height() const { return FONT_GLYPH_HEIGHT * p_size; }
+    const char *text() const { return p_text; }
+
+private:
+    TextLabel(const TextLabel&);
+    TextLabel &operator=(const TextLabel&);
+
+    void Layout()
+    {
+        if (!p_dirty) {
+            return;
+        }
+
+        p_count = 0;
+        for (size_t n = 0; n < p_length; ++n) {
+            if (p_text[n] == ' ') {
+                continue;
+            }
+
+            GlyphQuad &quad = p_glyphs[p_count++];
+            quad.left = p_x + n * FONT_ADVANCE * p_size;
+            quad.top = p_y;
+            quad.width = FONT_GLYPH_WIDTH * p_size;
+            quad.height = FONT_GLYPH_HEIGHT * p_size;
+            quad.color = p_color;
+            quad.glyph = uint32_t(FontGlyph(p_text[n]));
+        }
+
+        p_dirty = false;
+    }
+
+private:
+    // what number label shows, if any
+    const char *p_prefix;
+    const char *p_suffix;
+    int         p_number;
+    int         p_decimals;
+
+    char      p_text[CAPACITY + 1];
+    size_t    p_length;
+    GlyphQuad p_glyphs[CAPACITY];
+    size_t    p_count;
+
+    float     p_x;
+    float     p_y;
+    float     p_size;
+    Color     p_color;
+    bool      p_dirty;
+};
+
+
+// collects glyphs of labels into caller supplied storage and draws them
+// all at once with GraphicsAPI::Glyphs(), same way as RectangleBatch
+class GlyphBatch
+{
+public:
+    GlyphBatch(GraphicsAPI &api, GlyphQuad *storage, size_t capacity) :
+        p_api(api),
+        p_glyphs(storage),
+        p_capacity(capacity),
+        p_count(0)
+    {}
+
+    ~GlyphBatch()
+    {
+        Flush();
+    }
+
+    void Add(TextLabel &label)
+    {
+        const GlyphQuad *glyphs = label.glyphs();
+        size_t count = label.count();
+
+        if (p_count + count > p_capacity) {
+            Flush();
+        }
+
+        // label which doesn't fit at all is drawn by itself
+        if (count > p_capacity) {
+            p_api.Glyphs(glyphs, count);
+            return;
+        }
+
+        for (size_t n = 0; n < count; ++n) {
+            p_glyphs[p_count++] = glyphs[n];
+        }
+    }
+
+    void Flush()
+    {
+        if (p_count > 0) {
+            p_api.Glyphs(p_glyphs, p_count);
+            p_count = 0;
+        }
+    }
+
+private:
+    GlyphBatch(const GlyphBatch&);
+    GlyphBatch &operator=(const GlyphBatch&);
+
+    GraphicsAPI &p_api;
+    GlyphQuad   *p_glyphs;
+    size_t       p_capacity;
+    size_t       p_count;
+};
@@ -0,0 +1,706 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// seekable replay archive
+//     ArchiveRecorder - passes frames from other source through and records
+//                       them along with periodic game state keyframes
+//     ArchiveInput    - plays archive back, could seek to any tick
+//
+// archive file layout:
+//     ArchiveHeader
+//     blocks, one per keyframe: game state (Game::SaveState()) followed by
+//         encoded frames up to next keyframe
+//     index: ArchiveKeyframe for every block
+//
+// frames are delta encoded, every frame starts with varint of
+// event count << 1 | interval changed flag, new interval follows as float
+// if it changed, then events follow: type byte, varint of zigzag time delta
+// and event payload, mouse position as delta from previous mouse event
+// encoder state is reset at every keyframe, so blocks are independent
+// frame without events and with same interval takes single byte
+//
+// seeking restores nearest keyframe at or before target tick and simulates
+// only ticks left to the target, reader memory maps whole file, so nothing
+// is read besides what's used
+// same as replays, archive could be played back only by same build, and
+// same as replays, decoded events and intervals are checked, playback and
+// seek stop at bad frame
+
+#include <cstdio>
+#include <cstring>
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+struct ArchiveHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t seed;              // game seed
+    uint32_t keyframe_interval; // ticks between keyframes
+    uint32_t state_size;        // game state bytes in every keyframe
+    uint64_t ticks;             // recorded ticks
+    uint64_t keyframes;         // index entries
+    uint64_t index;             // file offset of index
+};
+
+struct ArchiveKeyframe
+{
+    uint64_t tick;   // first tick of block, state is taken before it
+    uint64_t offset; // file offset of block
+};
+
+static const char     ARCHIVE_MAGIC[4] = { 'T', 'F', 'S', 'A' };
+static const uint32_t ARCHIVE_VERSION = 1;
+
+
+// delta encoder and decoder of frames, same state on both sides
+class ArchiveCodec
+{
+public:
+    enum
+    {
+        // longest encoded event: type, time and 4 values
+        EVENT_BYTES = 1 + 5 * 5,
+        FRAME_BYTES = 5 + 4 + EVENT_BYTES * INPUT_EVENT_COUNT
+    };
+
+    ArchiveCodec()
+    {
+        Reset();
+    }
+
+    // called at every keyframe
+    void Reset()
+    {
+        p_interval = 0;
+        p_time = 0;
+        p_mouse_x = 0;
+        p_mouse_y = 0;
+    }
+
+    // out should have FRAME_BYTES, returns encoded size
+    size_t Encode(const Input &input, float interval, uint8_t *out)
+    {
+        uint8_t *start = out;
+
+        bool changed = interval != p_interval;
+        out = PutVarint(out, uint32_t(input.event_count) << 1 | (changed ? 1 : 0));
+        if (changed) {
+            memcpy(out, &interval, sizeof(interval));
+            out += sizeof(interval);
+            p_interval = interval;
+        }
+
+        for (size_t n = 0; n < input.event_count; ++n) {
+            const InputEvent &event = input.events[n];
+            *out++ = uint8_t(event.type);
+            out = PutVarint(out, Zigzag(int32_t(event.time - p_time)));
+            p_time = event.time;
+
+            switch (event.type) {
+                case INPUT_MOUSE_DOWN:
+                case INPUT_MOUSE_UP:
+                case INPUT_MOUSE_MOVE:
+                case INPUT_MOUSE_WHEEL:
+                    out = PutVarint(out, Zigzag(event.mouse.x - p_mouse_x));
+                    out = PutVarint(out, Zigzag(event.mouse.y - p_mouse_y));
+                    out = PutVarint(out, uint32_t(event.mouse.button));
+                    out = PutVarint(out, Zigzag(event.mouse.wheel));
+                    p_mouse_x = event.mouse.x;
+                    p_mouse_y = event.mouse.y;
+                    break;
+
+                case INPUT_KEY_DOWN:
+                case INPUT_KEY_UP:
+                case INPUT_CHAR:
+                    out = PutVarint(out, uint32_t(event.keyboard.key));
+                    break;
+
+                case INPUT_BUTTON_DOWN:
+                case INPUT_BUTTON_UP:
+                    out = PutVarint(out, event.joystick.number);
+                    out = PutVarint(out, uint32_t(event.joystick.button));
+                    break;
+
+                case INPUT_AXIS:
+                case INPUT_POV:
+                    // axis and pov events share layout
+                    out = PutVarint(out, event.joystick.number);
+                    out = PutVarint(out, uint32_t(event.joystick.axis.axis));
+                    out = PutVarint(out, Zigzag(event.joystick.axis.value));
+                    break;
+
+                case INPUT_CONNECT:
+                case INPUT_DISCONNECT:
+                    out = PutVarint(out, event.joystick.number);
+                    break;
+            }
+        }
+
+        return size_t(out - start);
+    }
+
+    // decodes frame at data, events are added to input, returns position
+    // after frame or nullptr if frame doesn't fit before end or has bad
+    // data, nothing is added to input then
+    const uint8_t *Decode(const uint8_t *data, const uint8_t *end, Input &input, float &interval)
+    {
+        uint32_t header;
+        if ((data = GetVarint(data, end, header)) == nullptr) {
+            return nullptr;
+        }
+
+        if (header & 1) {
+            if (end - data < ptrdiff_t(sizeof(p_interval))) {
+                return nullptr;
+            }
+            memcpy(&p_interval, data, sizeof(p_interval));
+            data += sizeof(p_interval);
+        }
+
+        uint32_t eventcount = header >> 1;
+        if (!ValidInterval(p_interval, REPLAY_MIN_INTERVAL, REPLAY_MAX_INTERVAL) || eventcount > INPUT_EVENT_COUNT) {
+            return nullptr;
+        }
+
+        InputEvent events[INPUT_EVENT_COUNT];
+        for (uint32_t n = 0; n < eventcount; ++n) {
+            if (data == end) {
+                return nullptr;
+            }
+
+            InputEvent &event = events[n];
+            memset(&event, 0, sizeof(event));
+            event.type = InputEventType(*data++);
+
+            uint32_t values[4] = {};
+            int count = 0;
+            switch (event.type) {
+                case INPUT_MOUSE_DOWN:
+                case INPUT_MOUSE_UP:
+                case INPUT_MOUSE_MOVE:
+                case INPUT_MOUSE_WHEEL:
+                    count = 4;
+                    break;
+
+                case INPUT_BUTTON_DOWN:
+                case INPUT_BUTTON_UP:
+                    count = 2;
+                    break;
+
+                case INPUT_AXIS:
+                case INPUT_POV:
+                    count = 3;
+                    break;
+
+                default:
+                    count = 1;
+                    break;
+            }
+
+            uint32_t time;
+            data = GetVarint(data, end, time);
+            for (int v = 0; v < count && data; ++v) {
+                data = GetVarint(data, end, values[v]);
+            }
+            if (data == nullptr) {
+                return nullptr;
+            }
+
+            p_time += uint32_t(Unzigzag(time));
+            event.time = p_time;
+
+            switch (event.type) {
+                case INPUT_MOUSE_DOWN:
+                case INPUT_MOUSE_UP:
+                case INPUT_MOUSE_MOVE:
+                case INPUT_MOUSE_WHEEL:
+                    p_mouse_x += Unzigzag(values[0]);
+                    p_mouse_y += Unzigzag(values[1]);
+                    event.mouse.x = p_mouse_x;
+                    event.mouse.y = p_mouse_y;
+                    event.mouse.button = InputMouseButton(values[2]);
+                    event.mouse.wheel = Unzigzag(values[3]);
+                    break;
+
+                case INPUT_KEY_DOWN:
+                case INPUT_KEY_UP:
+                case INPUT_CHAR:
+                    event.keyboard.key = InputKey(values[0]);
+                    break;
+
+                case INPUT_BUTTON_DOWN:
+                case INPUT_BUTTON_UP:
+                    event.joystick.number = values[0];
+                    event.joystick.button = InputJoystickButton(values[1]);
+                    break;
+
+                case INPUT_AXIS:
+                case INPUT_POV:
+                    event.joystick.number = values[0];
+                    event.joystick.axis.axis = InputJoystickAxis(values[1]);
+                    event.joystick.axis.value = Unzigzag(values[2]);
+                    break;
+
+                case INPUT_CONNECT:
+                case INPUT_DISCONNECT:
+                    event.joystick.number = values[0];
+                    break;
+            }
+
+            if (!ValidEvent(event)) {
+                return nullptr;
+            }
+        }
+
+        interval = p_interval;
+        for (uint32_t n = 0; n < eventcount; ++n) {
+            PushEvent(input, events[n]);
+        }
+
+        return data;
+    }
+
+private:
+    static uint32_t Zigzag(int32_t value)
+    {
+        return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    }
+
+    static int32_t Unzigzag(uint32_t value)
+    {
+        return int32_t(value >> 1) ^ -int32_t(value & 1);
+    }
+
+    static uint8_t *PutVarint(uint8_t *out, uint32_t value)
+    {
+        while (value >= 0x80) {
+            *out++ = uint8_t(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = uint8_t(value);
+        return out;
+    }
+
+    static const uint8_t *GetVarint(const uint8_t *data, const uint8_t *end, uint32_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (data == end) {
+                return nullptr;
+            }
+            uint8_t byte = *data++;
+            value |= uint32_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return data;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    float    p_interval;
+    uint32_t p_time;
+    int      p_mouse_x;
+    int      p_mouse_y;
+};
+
+
+class ArchiveRecorder : public InputSource
+{
+public:
+    // keyframes are taken from game, it should be the one driven by this
+    // source, source frames are asked before game processes them
+    ArchiveRecorder(InputSource &source, const Game &game) :
+        p_source(source),
+        p_game(game),
+        p_file(nullptr),
+        p_state(nullptr),
+        p_index(nullptr),
+        p_index_capacity(0)
+    {
+        memset(&p_header, 0, sizeof(p_header));
+    }
+
+    ~ArchiveRecorder()
+    {
+        Close();
+        delete[] p_index;
+    }
+
+    // seed is the one game was started with, interval is ticks between keyframes
+    bool Open(const char *filename, uint64_t seed, uint32_t interval = 600)
+    {
+        Close();
+
+        p_file = fopen(filename, "wb");
+        if (p_file == nullptr) {
+            fprintf(stderr, "Couldn't create archive \"%s\"\n", filename);
+            return false;
+        }
+
+        memcpy(p_header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        p_header.version = ARCHIVE_VERSION;
+        p_header.seed = seed;
+        p_header.keyframe_interval = interval > 0 ? interval : 1;
+        p_header.state_size = uint32_t(p_game.StateSize());
+        p_header.ticks = 0;
+        p_header.keyframes = 0;
+        p_header.index = 0;
+
+        // index for hours of play is allocated up front, it grows (rarely)
+        // only for longer games
+        if (p_index == nullptr) {
+            p_index_capacity = 1024;
+            p_index = new ArchiveKeyframe[p_index_capacity];
+        }
+        delete[] p_state;
+        p_state = new uint8_t[p_header.state_size];
+
+        // header is written again on close with sizes
+        fwrite(&p_header, sizeof(p_header), 1, p_file);
+        return true;
+    }
+
+    void Close()
+    {
+        if (p_file == nullptr) {
+            return;
+        }
+
+        // index is aligned, so reader could use it right from mapped file
+        while (ftell(p_file) % sizeof(uint64_t) != 0) {
+            fputc(0, p_file);
+        }
+
+        p_header.index = uint64_t(ftell(p_file));
+        fwrite(p_index, sizeof(ArchiveKeyframe), size_t(p_header.keyframes), p_file);
+        fseek(p_file, 0, SEEK_SET);
+        fwrite(&p_header, sizeof(p_header), 1, p_file);
+
+        fclose(p_file);
+        p_file = nullptr;
+
+        delete[] p_state;
+        p_state = nullptr;
+    }
+
+    bool NextFrame(Input &input, uint32_t time, float &interval) override
+    {
+        if (!p_source.NextFrame(input, time, interval)) {
+            return false;
+        }
+
+        if (p_file == nullptr) {
+            return true;
+        }
+
+        // game hasn't seen this frame yet, so its state is right before it
+        if (p_header.ticks % p_header.keyframe_interval == 0) {
+            WriteKeyframe();
+        }
+
+        size_t size = p_codec.Encode(input, interval, p_frame);
+        fwrite(p_frame, 1, size, p_file);
+        ++p_header.ticks;
+
+        return true;
+    }
+
+private:
+    ArchiveRecorder(const ArchiveRecorder&);
+    ArchiveRecorder &operator=(const ArchiveRecorder&);
+
+    void WriteKeyframe()
+    {
+        if (p_header.keyframes == p_index_capacity) {
+            ArchiveKeyframe *index = new ArchiveKeyframe[p_index_capacity * 2];
+            memcpy(index, p_index, sizeof(ArchiveKeyframe) * p_index_capacity);
+            delete[] p_index;
+            p_index = index;
+            p_index_capacity *= 2;
+        }
+
+        ArchiveKeyframe &keyframe = p_index[p_header.keyframes++];
+        keyframe.tick = p_header.ticks;
+        keyframe.offset = uint64_t(ftell(p_file));
+
+        p_game.SaveState(p_state);
+        fwrite(p_state, 1, p_header.state_size, p_file);
+        p_codec.Reset();
+    }
+
+private:
+    InputSource     &p_source;
+    const Game      &p_game;
+    FILE            *p_file;
+    ArchiveHeader    p_header;
+    uint8_t         *p_state;
+    ArchiveKeyframe *p_index;
+    size_t           p_index_capacity;
+    ArchiveCodec     p_codec;
+    uint8_t          p_frame[ArchiveCodec::FRAME_BYTES];
+};
+
+
+// whole file mapped into memory, read only
+class MappedFile
+{
+public:
+    MappedFile() :
+        p_data(nullptr),
+        p_size(0)
+#if defined(_WIN32)
+        , p_file(INVALID_HANDLE_VALUE),
+        p_mapping(0)
+#endif
+    {}
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    bool Open(const char *filename)
+    {
+        Close();
+
+#if defined(_WIN32)
+        p_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+        LARGE_INTEGER size;
+        if (p_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(p_file, &size) || size.QuadPart == 0) {
+            Close();
+            return false;
+        }
+
+        p_mapping = CreateFileMappingA(p_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (p_mapping) {
+            p_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(p_mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        p_size = size_t(size.QuadPart);
+#else
+        int file = open(filename, O_RDONLY);
+        struct stat info;
+        if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0) {
+            if (file >= 0) {
+                close(file);
+            }
+            return false;
+        }
+
+        // mapping stays valid after file is closed
+        void *data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+        close(file);
+        p_data = data != MAP_FAILED ? reinterpret_cast<const uint8_t*>(data) : nullptr;
+        p_size = size_t(info.st_size);
+#endif
+
+        if (p_data == nullptr) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#if defined(_WIN32)
+        if (p_data) {
+            UnmapViewOfFile(p_data);
+        }
+        if (p_mapping) {
+            CloseHandle(p_mapping);
+            p_mapping = 0;
+        }
+        if (p_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(p_file);
+            p_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (p_data) {
+            munmap(const_cast<uint8_t*>(p_data), p_size);
+        }
+#endif
+        p_data = nullptr;
+        p_size = 0;
+    }
+
+    const uint8_t *data() const { return p_data; }
+    size_t size() const { return p_size; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile &operator=(const MappedFile&);
+
+    const uint8_t *p_data;
+    size_t         p_size;
+#if defined(_WIN32)
+    HANDLE         p_file;
+    HANDLE         p_mapping;
+#endif
+};
+
+
+class ArchiveInput : public InputSource
+{
+public:
+    ArchiveInput() :
+        p_index(nullptr),
+        p_keyframe(0),
+        p_tick(0),
+        p_position(nullptr),
+        p_end(nullptr)
+    {
+        memset(&p_header, 0, sizeof(p_header));
+    }
+
+    bool Open(const char *filename)
+    {
+        if (!p_file.Open(filename)) {
+            fprintf(stderr, "Couldn't open archive \"%s\"\n", filename);
+            return false;
+        }
+
+        const uint8_t *data = p_file.data();
+        size_t size = p_file.size();
+        bool valid = size >= sizeof(p_header);
+        if (valid) {
+            memcpy(&p_header, data, sizeof(p_header));
+            valid =
+                memcmp(p_header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0 &&
+                p_header.version == ARCHIVE_VERSION &&
+                p_header.keyframe_interval > 0 &&
+                p_header.index <= size &&
+                p_header.keyframes <= (size - p_header.index) / sizeof(ArchiveKeyframe) &&
+                (p_header.keyframes > 0 || p_header.ticks == 0);
+        }
+
+        if (!valid) {
+            fprintf(stderr, "\"%s\" isn't an archive file\n", filename);
+            p_file.Close();
+            return false;
+        }
+
+        // index entries are 8 byte aligned in file and mapping is page aligned
+        p_index = reinterpret_cast<const ArchiveKeyframe*>(data + p_header.index);
+        p_tick = p_header.ticks;
+        p_position = nullptr;
+        p_end = nullptr;
+
+        // ready to play from the start, game started with archive seed
+        // is at first keyframe
+        if (p_header.keyframes > 0 && !EnterBlock(0)) {
+            fprintf(stderr, "\"%s\" is damaged\n", filename);
+            p_file.Close();
+            return false;
+        }
+        return true;
+    }
+
+    // restores game state at given tick (start of the tick, before its
+    // input), ticks past the end go to the end, returns false if game
+    // doesn't fit archive
+    bool Seek(Game &game, PlatformAPI &api, uint64_t tick)
+    {
+        if (p_header.keyframes == 0 || game.StateSize() != p_header.state_size) {
+            return false;
+        }
+
+        tick = tick < p_header.ticks ? tick : p_header.ticks;
+
+        // keyframes are regular, so nearest one is found right away
+        uint64_t keyframe = tick / p_header.keyframe_interval;
+        keyframe = keyframe < p_header.keyframes ? keyframe : p_header.keyframes - 1;
+        if (!EnterBlock(size_t(keyframe)) || !game.LoadState(p_file.data() + p_index[keyframe].offset)) {
+            return false;
+        }
+
+        Input input = {};
+        while (p_tick < tick) {
+            input.event_count = 0;
+            input.event_dropped = 0;
+            float interval = 0;
+            if (!NextFrame(input, 0, interval)) {
+                return false;
+            }
+            game.ProcessInput(api, input);
+            game.Update(interval);
+        }
+
+        return true;
+    }
+
+    // events keep their recorded time
+    bool NextFrame(Input &input, uint32_t, float &interval) override
+    {
+        if (p_tick >= p_header.ticks || p_position == nullptr) {
+            return false;
+        }
+
+        // next block starts with keyframe, which isn't needed when
+        // playing through
+        if (p_keyframe + 1 < p_header.keyframes && p_tick == p_index[p_keyframe + 1].tick) {
+            if (!EnterBlock(p_keyframe + 1)) {
+                return false;
+            }
+        }
+
+        p_position = p_codec.Decode(p_position, p_end, input, interval);
+        if (p_position == nullptr) {
+            return false;
+        }
+
+        ++p_tick;
+        return true;
+    }
+
+    uint64_t seed() const { return p_header.seed; }
+    uint64_t ticks() const { return p_header.ticks; }
+    uint64_t tick() const { return p_tick; }
+
+private:
+    ArchiveInput(const ArchiveInput&);
+    ArchiveInput &operator=(const ArchiveInput&);
+
+    // positions reader at frames of given block
+    bool EnterBlock(size_t keyframe)
+    {
+        uint64_t start = p_index[keyframe].offset + p_header.state_size;
+        uint64_t end = keyframe + 1 < p_header.keyframes ? p_index[keyframe + 1].offset : p_header.index;
+        if (start > end || end > p_header.index) {
+            p_position = nullptr;
+            return false;
+        }
+
+        p_keyframe = keyframe;
+        p_tick = p_index[keyframe].tick;
+        p_position = p_file.data() + start;
+        p_end = p_file.data() + end;
+        p_codec.Reset();
+        return true;
+    }
+
+private:
+    MappedFile             p_file;
+    ArchiveHeader          p_header;
+    const ArchiveKeyframe *p_index;
+    size_t                 p_keyframe;
+    uint64_t               p_tick;
+    const uint8_t         *p_position;
+    const uint8_t         *p_end;
+    ArchiveCodec           p_codec;
+};
@@ -0,0 +1,580 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// platform independent audio mixer
+// game thread calls AudioAPI, which only puts commands into lock-free
+// single producer single consumer queue, audio thread takes commands and
+// mixes active voices of preloaded sounds into output blocks
+// mixer thread never allocates, locks or waits for game thread: all memory
+// is allocated in constructor and by LoadSound() on game thread
+//
+// outputs:
+//     NullAudioOutput    - mixed blocks are dropped, paced in real time
+//     WavFileAudioOutput - mixed blocks are written into .wav file, paced
+//                          in real time or not paced at all (offline render)
+// platform specific outputs (like waveOut) live in platform layer
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+
+enum AudioMixerLimits
+{
+    AUDIO_SOUND_COUNT   = 32,   // sound ids are 0..AUDIO_SOUND_COUNT-1
+    AUDIO_VOICE_COUNT   = 32,   // sounds playing at once
+    AUDIO_COMMAND_COUNT = 256,  // queue size, power of two
+    AUDIO_MAX_BLOCK     = 1024  // max frames mixed at once
+};
+
+// output block size of real time outputs, 5 ms
+static const size_t AUDIO_BLOCK_FRAMES = AUDIO_SAMPLE_RATE / 200;
+
+// microseconds of steady clock, same clock on game and audio thread
+static uint64_t AudioClock()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+
+enum AudioCommandType
+{
+    AUDIO_PLAY,
+    AUDIO_STOP
+};
+
+struct AudioCommand
+{
+    uint32_t type;
+    uint32_t sound;
+    float    volume;
+    float    pan;
+    uint64_t time;   // AudioClock() when command was sent
+};
+
+// single producer single consumer ring buffer, producer only writes tail
+// and consumer only writes head, so no locks are needed
+class AudioCommandQueue
+{
+public:
+    AudioCommandQueue() :
+        p_head(0),
+        p_tail(0)
+    {}
+
+    // false when queue is full, command is dropped then
+    bool Push(const AudioCommand &command)
+    {
+        uint32_t tail = p_tail.load(std::memory_order_relaxed);
+        if (tail - p_head.load(std::memory_order_acquire) == AUDIO_COMMAND_COUNT) {
+            return false;
+        }
+
+        p_commands[tail & (AUDIO_COMMAND_COUNT - 1)] = command;
+        p_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(AudioCommand &command)
+    {
+        uint32_t head = p_head.load(std::memory_order_relaxed);
+        if (head == p_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        command = p_commands[head & (AUDIO_COMMAND_COUNT - 1)];
+        p_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // head and tail are written by different threads, keep them on
+    // different cache lines
+    std::atomic<uint32_t> p_head;
+    uint8_t               p_head_padding[64 - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> p_tail;
+    uint8_t               p_tail_padding[64 - sizeof(std::atomic<uint32_t>)];
+
+    AudioCommand p_commands[AUDIO_COMMAND_COUNT];
+};
+
+
+// mixer statistics, could be read from any thread
+struct AudioStats
+{
+    uint64_t played;       // voices started
+    uint64_t dropped;      // commands dropped because of full queue or unknown sound
+    uint64_t latency_avg;  // command to mix start, microseconds
+    uint64_t latency_max;
+};
+
+
+class AudioMixer : public AudioAPI
+{
+public:
+    AudioMixer() :
+        p_played(0),
+        p_dropped(0),
+        p_latency_sum(0),
+        p_latency_max(0)
+    {
+        for (int n = 0; n < AUDIO_SOUND_COUNT; ++n) {
+            p_sounds[n].samples.store(nullptr, std::memory_order_relaxed);
+            p_sounds[n].length = 0;
+        }
+        for (int n = 0; n < AUDIO_VOICE_COUNT; ++n) {
+            p_voices[n].sound = AUDIO_SOUND_COUNT;
+            p_voices[n].active = false;
+        }
+
+        // stereo mix buffer, with room for rounding frames up to 4
+        p_mix = new float[(AUDIO_MAX_BLOCK + 4) * 2];
+    }
+
+    ~AudioMixer()
+    {
+        for (int n = 0; n < AUDIO_SOUND_COUNT; ++n) {
+            delete[] p_sounds[n].samples.load(std::memory_order_relaxed);
+        }
+        delete[] p_mix;
+    }
+
+    bool LoadSound(uint32_t sound, const float *samples, size_t count) override
+    {
+        if (sound >= AUDIO_SOUND_COUNT || count == 0 ||
+            p_sounds[sound].samples.load(std::memory_order_relaxed) != nullptr)
+        {
+            return false;
+        }
+
+        // sound is padded with silence to whole 4 samples, so mixer always
+        // reads whole blocks
+        size_t padded = (count + 3) & ~size_t(3);
+        float *copy = new float[padded + 4];
+        for (size_t n = 0; n < padded + 4; ++n) {
+            copy[n] = n < count ? samples[n] : 0.0f;
+        }
+
+        // mixer sees sound only after its samples are in place
+        p_sounds[sound].length = uint32_t(count);
+        p_sounds[sound].samples.store(copy, std::memory_order_release);
+        return true;
+    }
+
+    void Play(uint32_t sound, float volume, float pan) override
+    {
+        AudioCommand command = { AUDIO_PLAY, sound, volume, pan, AudioClock() };
+        if (!p_commands.Push(command)) {
+            p_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void Stop(uint32_t sound) override
+    {
+        AudioCommand command = { AUDIO_STOP, sound, 0, 0, AudioClock() };
+        if (!p_commands.Push(command)) {
+            p_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // mixes next frames of interleaved stereo 16 bit output, called only
+    // from audio thread (or from game thread when rendering offline)
+    void Mix(int16_t *output, size_t frames)
+    {
+        while (frames > 0) {
+            size_t block = frames < size_t(AUDIO_MAX_BLOCK) ? frames : size_t(AUDIO_MAX_BLOCK);
+            MixBlock(output, block);
+            output += block * 2;
+            frames -= block;
+        }
+    }
+
+    AudioStats stats() const
+    {
+        AudioStats result;
+        result.played = p_played.load(std::memory_order_relaxed);
+        result.dropped = p_dropped.load(std::memory_order_relaxed);
+        result.latency_avg = result.played ? p_latency_sum.load(std::memory_order_relaxed) / result.played : 0;
+        result.latency_max = p_latency_max.load(std::memory_order_relaxed);
+        return result;
+    }
+
+private:
+    AudioMixer(const AudioMixer&);
+    AudioMixer &operator=(const AudioMixer&);
+
+    struct Sound
+    {
+        std::atomic<const float*> samples;
+        uint32_t                  length;
+    };
+
+    struct Voice
+    {
+        const float *samples;
+        uint32_t     sound;
+        uint32_t     length;
+        uint32_t     position;
+        float        left;
+        float        right;
+        bool         active;
+    };
+
+    void ProcessCommands()
+    {
+        uint64_t now = AudioClock();
+
+        AudioCommand command;
+        while (p_commands.Pop(command)) {
+            if (command.type == AUDIO_STOP) {
+                for (int n = 0; n < AUDIO_VOICE_COUNT; ++n) {
+                    if (p_voices[n].sound == command.sound) {
+                        p_voices[n].active = false;
+                    }
+                }
+                continue;
+            }
+
+            const float *samples = command.sound < AUDIO_SOUND_COUNT ?
+                p_sounds[command.sound].samples.load(std::memory_order_acquire) : nullptr;
+            if (samples == nullptr) {
+                p_dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            // free voice or the one which played longest
+            int slot = 0;
+            for (int n = 0; n < AUDIO_VOICE_COUNT; ++n) {
+                if (!p_voices[n].active) {
+                    slot = n;
+                    break;
+                }
+                if (p_voices[n].position > p_voices[slot].position) {
+                    slot = n;
+                }
+            }
+
+            // simple linear panning, center plays at full volume on both sides
+            float pan = command.pan < -1 ? -1 : (command.pan > 1 ? 1 : command.pan);
+            Voice &voice = p_voices[slot];
+            voice.samples = samples;
+            voice.sound = command.sound;
+            voice.length = p_sounds[command.sound].length;
+            voice.position = 0;
+            voice.left = command.volume * MASTER_VOLUME * (pan > 0 ? 1 - pan : 1);
+            voice.right = command.volume * MASTER_VOLUME * (pan < 0 ? 1 + pan : 1);
+            voice.active = true;
+
+            uint64_t latency = now > command.time ? now - command.time : 0;
+            p_played.fetch_add(1, std::memory_order_relaxed);
+            p_latency_sum.fetch_add(latency, std::memory_order_relaxed);
+            if (latency > p_latency_max.load(std::memory_order_relaxed)) {
+                p_latency_max.store(latency, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void MixBlock(int16_t *output, size_t frames)
+    {
+        ProcessCommands();
+
+        // whole 4 frame blocks are mixed, extra frames are never output
+        size_t rounded = (frames + 3) & ~size_t(3);
+        for (size_t n = 0; n < rounded * 2; ++n) {
+            p_mix[n] = 0;
+        }
+
+        for (int n = 0; n < AUDIO_VOICE_COUNT; ++n) {
+            Voice &voice = p_voices[n];
+            if (!voice.active) {
+                continue;
+            }
+
+            // sound is padded with silence, so reading past its end is fine
+            uint32_t left = voice.length - voice.position;
+            size_t count = left < frames ? ((left + 3) & ~3u) : rounded;
+            MixVoice(voice.samples + voice.position, count, voice.left, voice.right);
+
+            voice.position += uint32_t(frames < left ? frames : left);
+            voice.active = voice.position < voice.length;
+        }
+
+        Convert(output, frames);
+    }
+
+    // adds mono samples into stereo mix, count is multiple of 4
+    void MixVoice(const float *samples, size_t count, float left, float right)
+    {
+        float *mix = p_mix;
+
+#if defined(ENGINE_SSE2)
+        __m128 volume = _mm_setr_ps(left, right, left, right);
+        for (size_t n = 0; n < count; n += 4, mix += 8) {
+            __m128 mono = _mm_loadu_ps(samples + n);
+            __m128 first = _mm_unpacklo_ps(mono, mono);
+            __m128 second = _mm_unpackhi_ps(mono, mono);
+            _mm_storeu_ps(mix, _mm_add_ps(_mm_loadu_ps(mix), _mm_mul_ps(first, volume)));
+            _mm_storeu_ps(mix + 4, _mm_add_ps(_mm_loadu_ps(mix + 4), _mm_mul_ps(second, volume)));
+        }
+#else
+        for (size_t n = 0; n < count; ++n, mix += 2) {
+            mix[0] += samples[n] * left;
+            mix[1] += samples[n] * right;
+        }
+#endif
+    }
+
+    // mix to 16 bit samples with saturation
+    void Convert(int16_t *output, size_t frames)
+    {
+        size_t samples = frames * 2;
+        size_t n = 0;
+
+#if defined(ENGINE_SSE2)
+        __m128 scale = _mm_set1_ps(32767.0f);
+        for (; n + 8 <= samples; n += 8) {
+            __m128i low = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(p_mix + n), scale));
+            __m128i high = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(p_mix + n + 4), scale));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + n), _mm_packs_epi32(low, high));
+        }
+#endif
+
+        for (; n < samples; ++n) {
+            float value = p_mix[n] * 32767.0f;
+            value = value > 32767.0f ? 32767.0f : (value < -32768.0f ? -32768.0f : value);
+            output[n] = int16_t(value + (value < 0 ? -0.5f : 0.5f));
+        }
+    }
+
+private:
+    // headroom for several loud voices at once
+    static const float MASTER_VOLUME;
+
+    AudioCommandQueue p_commands;
+    Sound             p_sounds[AUDIO_SOUND_COUNT];
+    Voice             p_voices[AUDIO_VOICE_COUNT];
+    float            *p_mix;
+
+    std::atomic<uint64_t> p_played;
+    std::atomic<uint64_t> p_dropped;
+    std::atomic<uint64_t> p_latency_sum;
+    std::atomic<uint64_t> p_latency_max;
+};
+
+const float AudioMixer::MASTER_VOLUME = 0.5f;
+
+
+// where mixed audio goes, Write() blocks until output takes next block
+class AudioOutput
+{
+public:
+    virtual ~AudioOutput() {}
+
+    // interleaved stereo 16 bit samples at AUDIO_SAMPLE_RATE
+    virtual bool Write(const int16_t *samples, size_t frames) = 0;
+};
+
+// sleeps until time of next block, so outputs without device consume
+// audio at the rate real device would
+class AudioPacer
+{
+public:
+    AudioPacer() :
+        p_start(0),
+        p_frames(0)
+    {}
+
+    void Wait(size_t frames)
+    {
+        if (p_start == 0) {
+            p_start = AudioClock();
+        }
+
+        p_frames += frames;
+        uint64_t deadline = p_start + p_frames * 1000000 / AUDIO_SAMPLE_RATE;
+        uint64_t now = AudioClock();
+        if (deadline > now) {
+            std::this_thread::sleep_for(std::chrono::microseconds(deadline - now));
+        }
+    }
+
+private:
+    uint64_t p_start;
+    uint64_t p_frames;
+};
+
+class NullAudioOutput : public AudioOutput
+{
+public:
+    bool Write(const int16_t *, size_t frames) override
+    {
+        p_pacer.Wait(frames);
+        return true;
+    }
+
+private:
+    AudioPacer p_pacer;
+};
+
+class WavFileAudioOutput : public AudioOutput
+{
+public:
+    // offline output isn't paced and takes blocks as fast as they come
+    WavFileAudioOutput(bool realtime) :
+        p_file(nullptr),
+        p_frames(0),
+        p_realtime(realtime)
+    {}
+
+    ~WavFileAudioOutput()
+    {
+        Close();
+    }
+
+    bool Open(const char *filename)
+    {
+        Close();
+
+        p_file = fopen(filename, "wb");
+        if (p_file == nullptr) {
+            fprintf(stderr, "Couldn't create audio output \"%s\"\n", filename);
+            return false;
+        }
+
+        // sizes are written on close
+        p_frames = 0;
+        WriteHeader();
+        return true;
+    }
+
+    void Close()
+    {
+        if (p_file) {
+            fseek(p_file, 0, SEEK_SET);
+            WriteHeader();
+            fclose(p_file);
+            p_file = nullptr;
+        }
+    }
+
+    bool Write(const int16_t *samples, size_t frames) override
+    {
+        if (p_file) {
+            fwrite(samples, sizeof(int16_t) * 2, frames, p_file);
+            p_frames += frames;
+        }
+
+        if (p_realtime) {
+            p_pacer.Wait(frames);
+        }
+        return p_file != nullptr;
+    }
+
+private:
+    WavFileAudioOutput(const WavFileAudioOutput&);
+    WavFileAudioOutput &operator=(const WavFileAudioOutput&);
+
+    static void Put32(uint8_t *at, uint32_t value)
+    {
+        at[0] = uint8_t(value);
+        at[1] = uint8_t(value >> 8);
+        at[2] = uint8_t(value >> 16);
+        at[3] = uint8_t(value >> 24);
+    }
+
+    void WriteHeader()
+    {
+        uint32_t datasize = uint32_t(p_frames * 4);
+
+        uint8_t header[44] = {
+            'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+            'f', 'm', 't', ' ', 16, 0, 0, 0,
+            1, 0,         // PCM
+            2, 0,         // channels
+            0, 0, 0, 0,   // sample rate
+            0, 0, 0, 0,   // byte rate
+            4, 0,         // block align
+            16, 0,        // bits per sample
+            'd', 'a', 't', 'a', 0, 0, 0, 0
+        };
+        Put32(header + 4, 36 + datasize);
+        Put32(header + 24, AUDIO_SAMPLE_RATE);
+        Put32(header + 28, AUDIO_SAMPLE_RATE * 4);
+        Put32(header + 40, datasize);
+
+        fwrite(header, sizeof(header), 1, p_file);
+    }
+
+private:
+    FILE       *p_file;
+    uint64_t    p_frames;
+    bool        p_realtime;
+    AudioPacer  p_pacer;
+};
+
+
+// audio thread, mixes block by block into output until stopped
+class AudioThread
+{
+public:
+    AudioThread(AudioMixer &mixer, AudioOutput &output, size_t frames = AUDIO_BLOCK_FRAMES) :
+        p_mixer(mixer),
+        p_output(output),
+        p_frames(frames < size_t(AUDIO_MAX_BLOCK) ? frames : size_t(AUDIO_MAX_BLOCK)),
+        p_running(false)
+    {
+        p_block = new int16_t[p_frames * 2];
+    }
+
+    ~AudioThread()
+    {
+        Stop();
+        delete[] p_block;
+    }
+
+    void Start()
+    {
+        if (!p_running.exchange(true)) {
+            p_thread = std::thread(&AudioThread::Run, this);
+        }
+    }
+
+    void Stop()
+    {
+        if (p_running.exchange(false)) {
+            p_thread.join();
+        }
+    }
+
+private:
+    AudioThread(const AudioThread&);
+    AudioThread &operator=(const AudioThread&);
+
+    void Run()
+    {
+        while (p_running.load(std::memory_order_relaxed)) {
+            p_mixer.Mix(p_block, p_frames);
+            if (!p_output.Write(p_block, p_frames)) {
+                break;
+            }
+        }
+    }
+
+private:
+    AudioMixer        &p_mixer;
+    AudioOutput       &p_output;
+    int16_t           *p_block;
+    size_t             p_frames;
+    std::atomic<bool>  p_running;
+    std::thread        p_thread;
+};
@@ -0,0 +1,312 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// batch of games for mass simulation
+// follows same rules as Game (falling, placing, clearing rows, game over,
+// figure sequence from seed), but keeps only what simulation needs and
+// keeps it in structure of arrays layout, so every step runs same simple
+// loop over all games instead of calling Game methods one by one
+// headless -batch-benchmark compares its speed against Game, selftest checks
+// that both play the same games
+
+#include "engine/engine.h"
+
+
+class GameBatch
+{
+public:
+    enum
+    {
+        FIELD_WIDTH  = Game::FIELD_WIDTH,
+        FIELD_HEIGHT = Game::FIELD_HEIGHT,
+
+        // every field has 4 empty rows above it (figure could be there) and
+        // 4 solid rows below, columns outside field are solid as well (field
+        // starts at bit FIELD_LEFT), so collision check is just and-ing
+        // figure rows with field rows
+        FIELD_TOP    = 4,
+        FIELD_LEFT   = 1,
+        FIELD_STRIDE = FIELD_TOP + FIELD_HEIGHT + 4
+    };
+
+    GameBatch(size_t count) :
+        p_count(count)
+    {
+        p_memory = new uint8_t[MemorySize(count)];
+        Arena arena(p_memory, MemorySize(count));
+
+        p_rows = arena.New<uint32_t>(count * FIELD_STRIDE);
+        p_type = arena.New<uint8_t>(count);
+        p_x = arena.New<int32_t>(count);
+        p_y = arena.New<int32_t>(count);
+        p_fall_timer = arena.New<float>(count);
+        p_fall_speed = arena.New<float>(count);
+        p_lines = arena.New<int32_t>(count);
+        p_random = arena.New<Random>(count);
+        p_collide = arena.New<uint8_t>(count);
+        p_due = arena.New<uint32_t>(count);
+
+        // figure rows are kept as masks, one per figure row, in spawn rotation
+        const FigureShapes &shapes = AllFigureShapes();
+        for (int type = None; type < FigureTypeCount; ++type) {
+            const Figure &figure = shapes.figures[type][0];
+            p_shape_height[type] = figure.height();
+            for (int y = 0; y < 4; ++y) {
+                p_shape[type][y] = y < figure.height() ? figure.row(y) : 0;
+            }
+        }
+
+        for (size_t game = 0; game < count; ++game) {
+            Reset(game, game);
+        }
+    }
+
+    ~GameBatch()
+    {
+        delete[] p_memory;
+    }
+
+    static size_t MemorySize(size_t count)
+    {
+        return
+            Arena::Align(sizeof(uint32_t) * count * FIELD_STRIDE) +
+            Arena::Align(sizeof(uint8_t) * count) * 2 +
+            Arena::Align(sizeof(int32_t) * count) * 3 +
+            Arena::Align(sizeof(float) * count) * 2 +
+            Arena::Align(sizeof(Random) * count) +
+            Arena::Align(sizeof(uint32_t) * count);
+    }
+
+    // starts new game in given slot, same seed as Game gets gives same game
+    void Reset(size_t game, uint64_t seed)
+    {
+        uint32_t *rows = p_rows + game * FIELD_STRIDE;
+        for (int y = 0; y < FIELD_STRIDE; ++y) {
+            rows[y] = y < FIELD_TOP + FIELD_HEIGHT ? WALLS : SOLID;
+        }
+
+        p_fall_timer[game] = 0;
+        p_fall_speed[game] = 1;
+        p_lines[game] = 0;
+        p_random[game].Seed(seed);
+
+        // Game fills its figure queue first, but figures still come out of
+        // generator in the same order, so next roll is next figure here
+        Spawn(game);
+    }
+
+    // advances all games by time interval, same as Game::Update
+    void Update(float interval)
+    {
+        // advance fall timers of all games and collect games which figure
+        // should fall, no branches here
+        size_t duecount = 0;
+        for (size_t game = 0; game < p_count; ++game) {
+            float timer = p_fall_timer[game] + p_fall_speed[game] * interval;
+            uint32_t due = timer >= 1 ? 1 : 0;
+            p_fall_timer[game] = due ? timer - 1 : timer;
+
+            p_due[duecount] = uint32_t(game);
+            duecount += due;
+        }
+
+        Step(duecount);
+    }
+
+    // moves figures of all games one row down, same as Game::MoveDown
+    void MoveDown()
+    {
+        for (size_t game = 0; game < p_count; ++game) {
+            p_due[game] = uint32_t(game);
+        }
+
+        Step(p_count);
+    }
+
+    // moves figure of every game by dx (-1, 0 or 1) columns if it fits,
+    // same as Game::MoveLeft/MoveRight
+    void Move(const int8_t *dx)
+    {
+        for (size_t game = 0; game < p_count; ++game) {
+            p_x[game] += CollideGame(game, dx[game], 0) ? 0 : dx[game];
+        }
+    }
+
+    // checks figure of every game for collision at its position moved by
+    // dx and dy, result is 1 for colliding figures
+    void Collide(int dx, int dy, uint8_t *result) const
+    {
+        for (size_t game = 0; game < p_count; ++game) {
+            result[game] = CollideGame(game, dx, dy);
+        }
+    }
+
+    size_t count() const { return p_count; }
+    int lines(size_t game) const { return p_lines[game]; }
+
+    // field row without walls, same as Game::field_rows()
+    uint32_t row(size_t game, int y) const
+    {
+        return (p_rows[game * FIELD_STRIDE + FIELD_TOP + y] & ~WALLS) >> FIELD_LEFT;
+    }
+
+    // checks that game in given slot is where Game is, when both started
+    // with the same seed and got the same moves and intervals, see
+    // MoveLikeBatch()
+    bool Matches(size_t game, const Game &other) const
+    {
+        if (p_type[game] != other.figure().type() || p_x[game] != other.figure_x() ||
+            p_y[game] != other.figure_y() || p_lines[game] != other.lines()) {
+            return false;
+        }
+
+        for (int y = 0; y < FIELD_HEIGHT; ++y) {
+            if (row(game, y) != other.field_rows()[y]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // moves figure of Game the way Move() does: direction key pressed and
+    // released at once moves figure by single column, input is only used to
+    // pass events to game, so it doesn't have to be cleared for every call
+    static void MoveLikeBatch(Game &game, PlatformAPI &platform, Input &input, int dx, uint32_t time)
+    {
+        input.event_count = 0;
+        if (dx != 0) {
+            InputEvent &down = input.events[input.event_count++];
+            down.type = INPUT_KEY_DOWN;
+            down.time = time;
+            down.keyboard.key = dx < 0 ? KEY_LEFT : KEY_RIGHT;
+
+            InputEvent &up = input.events[input.event_count++];
+            up = down;
+            up.type = INPUT_KEY_UP;
+        }
+        game.ProcessInput(platform, input);
+    }
+
+private:
+    GameBatch(const GameBatch&);
+    GameBatch &operator=(const GameBatch&);
+
+    // row bits outside of field are always set
+    static const uint32_t WALLS = ~(((1u << FIELD_WIDTH) - 1) << FIELD_LEFT);
+    static const uint32_t SOLID = ~0u;
+
+    uint8_t CollideGame(size_t game, int dx, int dy) const
+    {
+        // field is padded, so any figure position which could happen maps
+        // into field rows and bits, no bounds checks are needed
+        const uint32_t *rows = p_rows + game * FIELD_STRIDE + FIELD_TOP + p_y[game] + dy;
+        const uint32_t *shape = p_shape[p_type[game]];
+        int x = p_x[game] + dx + FIELD_LEFT;
+
+        uint32_t hit =
+            (rows[0] & (shape[0] << x)) |
+            (rows[1] & (shape[1] << x)) |
+            (rows[2] & (shape[2] << x)) |
+            (rows[3] & (shape[3] << x));
+
+        return hit != 0 ? 1 : 0;
+    }
+
+    // moves down figures of first duecount games listed in p_due, figures
+    // which can't move are put into the wall
+    void Step(size_t duecount)
+    {
+        // collision pass over all due games at once
+        for (size_t n = 0; n < duecount; ++n) {
+            p_collide[n] = CollideGame(p_due[n], 0, 1);
+        }
+
+        // move figures down and compact list to games which figure should be
+        // put into the wall, those are rare (once per figure)
+        size_t lockcount = 0;
+        for (size_t n = 0; n < duecount; ++n) {
+            uint32_t game = p_due[n];
+            p_y[game] += p_collide[n] ^ 1;
+
+            p_due[lockcount] = game;
+            lockcount += p_collide[n];
+        }
+
+        for (size_t n = 0; n < lockcount; ++n) {
+            PutFigureInTheWall(p_due[n]);
+        }
+    }
+
+    // same as Game::PutFigureInTheWall
+    void PutFigureInTheWall(size_t game)
+    {
+        uint32_t *rows = p_rows + game * FIELD_STRIDE + FIELD_TOP;
+        int figurey = p_y[game];
+        int height = p_shape_height[p_type[game]];
+
+        // if figure put outside field top - this is game over
+        if (figurey < 0) {
+            for (int y = 0; y < FIELD_HEIGHT; ++y) {
+                rows[y] = WALLS;
+            }
+
+            p_fall_speed[game] = 1;
+            p_fall_timer[game] = 0;
+            p_lines[game] = 0;
+        } else {
+            const uint32_t *shape = p_shape[p_type[game]];
+            for (int y = 0; y < height; ++y) {
+                rows[figurey + y] |= shape[y] << (p_x[game] + FIELD_LEFT);
+            }
+
+            // only rows touched by figure could become full
+            for (int y = figurey; y < figurey + height; ++y) {
+                if (rows[y] == SOLID) {
+                    for (int yy = y; yy > 0; --yy) {
+                        rows[yy] = rows[yy - 1];
+                    }
+                    rows[0] = WALLS;
+
+                    ++p_lines[game];
+                    p_fall_speed[game] += 0.1f;
+                }
+            }
+        }
+
+        Spawn(game);
+    }
+
+    void Spawn(size_t game)
+    {
+        uint8_t type = uint8_t(p_random[game].Next(FigureTypeCount - 1) + 1);
+        p_type[game] = type;
+        p_x[game] = 4;
+        p_y[game] = -p_shape_height[type];
+    }
+
+private:
+    uint8_t  *p_memory;
+    size_t    p_count;
+
+    // per game data, every array has one entry per game
+    uint32_t *p_rows;       // FIELD_STRIDE padded rows per game
+    uint8_t  *p_type;       // current figure
+    int32_t  *p_x;          // and its position x
+    int32_t  *p_y;          // and y in cells
+    float    *p_fall_timer;
+    float    *p_fall_speed;
+    int32_t  *p_lines;
+    Random   *p_random;
+
+    // step temporaries
+    uint32_t *p_due;        // games which figure falls this step
+    uint8_t  *p_collide;    // and which of them can't fall
+
+    uint32_t  p_shape[FigureTypeCount][4];
+    int       p_shape_height[FigureTypeCount];
+};
+
@@ -0,0 +1,198 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// bot which plays the game through input, like a player would
+// for current figure it tries every rotation and column, evaluates field
+// after figure lands there and then presses keys to get figure to the best
+// place: flip until rotation matches, move to the column, drop
+// bot looks at the game every frame and presses one key per frame, so
+// whole input handling of the game is exercised
+
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+
+// weights of evaluated field features, field score is a weighted sum
+struct BotWeights
+{
+    float lines;     // rows removed by placement
+    float holes;
+    float height;
+    float bumpiness;
+    float top;
+};
+
+static const BotWeights BOT_DEFAULT_WEIGHTS = { 0.76f, -0.36f, -0.51f, -0.18f, 0.0f };
+
+
+class BotInput : public InputSource
+{
+public:
+    // game is the one being played, cache (if any) keeps features of
+    // already evaluated fields
+    BotInput(const Game &game, const BotWeights &weights = BOT_DEFAULT_WEIGHTS, HashCache *cache = nullptr) :
+        p_game(game),
+        p_weights(weights),
+        p_cache(cache)
+    {}
+
+    bool NextFrame(Input &input, uint32_t time, float &) override
+    {
+        int rotation = 0, x = 0;
+        if (!Plan(rotation, x)) {
+            return true;
+        }
+
+        const Figure &figure = p_game.figure();
+        int rotations = AllFigureShapes().rotations[figure.type()];
+
+        if (figure.rotation() % rotations != rotation) {
+            PressKey(input, KEY_UP, time);
+        } else if (p_game.figure_x() < x) {
+            PressKey(input, KEY_RIGHT, time);
+        } else if (p_game.figure_x() > x) {
+            PressKey(input, KEY_LEFT, time);
+        } else {
+            PressKey(input, KEY_SPACE, time);
+        }
+
+        return true;
+    }
+
+    void SetWeights(const BotWeights &weights) { p_weights = weights; }
+
+    // best placement of current figure, false if there's no figure
+    bool Plan(int &bestrotation, int &bestx)
+    {
+        const Figure &figure = p_game.figure();
+        FigureType type = figure.type();
+        if (type == None) {
+            return false;
+        }
+
+        p_game.GetPlacements(type, p_placements);
+
+        float bestscore = 0;
+        bool found = false;
+        for (int rotation = 0; rotation < p_placements.rotations; ++rotation) {
+            for (int x = 0; x < p_game.field_width(); ++x) {
+                int row = p_placements.rows[rotation][x];
+
+                // figure which is already below landing row can't get there
+                if (row == PLACEMENT_INVALID || row < p_game.figure_y()) {
+                    continue;
+                }
+
+                float score = Evaluate(type, rotation, x, row);
+                if (!found || score > bestscore) {
+                    bestscore = score;
+                    bestrotation = rotation;
+                    bestx = x;
+                    found = true;
+                }
+            }
+        }
+
+        return found;
+    }
+
+private:
+    BotInput(const BotInput&);
+    BotInput &operator=(const BotInput&);
+
+    // score of field after figure lands at given place
+    float Evaluate(FigureType type, int rotation, int x, int row)
+    {
+        // figure sticking out of the field top ends the game
+        if (row < 0) {
+            return -1e9f;
+        }
+
+        const Figure &figure = FigureShape(type, rotation);
+        int width = p_game.field_width();
+        int height = p_game.field_height();
+        const uint32_t *field = p_game.field_rows();
+
+        uint32_t rows[Game::FIELD_HEIGHT];
+        for (int y = 0; y < height; ++y) {
+            rows[y] = field[y];
+        }
+
+        // field hash follows placed figure rows, if rows are removed
+        // it's simpler to compute it again
+        uint64_t hash = p_game.field_hash();
+        for (int y = 0; y < figure.height(); ++y) {
+            uint32_t newrow = rows[row + y] | figure.row(y) << x;
+            hash ^= Game::RowKey(row + y, rows[row + y]) ^ Game::RowKey(row + y, newrow);
+            rows[row + y] = newrow;
+        }
+
+        uint32_t fullrow = (width < 32 ? 1u << width : 0u) - 1;
+        int lines = 0;
+        for (int y = row; y < row + figure.height(); ++y) {
+            lines += rows[y] == fullrow ? 1 : 0;
+        }
+
+        if (lines > 0) {
+            int target = height - 1;
+            for (int y = height - 1; y >= 0; --y) {
+                if (rows[y] != fullrow) {
+                    rows[target--] = rows[y];
+                }
+            }
+            while (target >= 0) {
+                rows[target--] = 0;
+            }
+
+            hash = 0;
+            for (int y = 0; y < height; ++y) {
+                hash ^= Game::RowKey(y, rows[y]);
+            }
+        }
+
+        FieldFeatures features;
+        uint64_t packed;
+        if (p_cache && p_cache->Lookup(hash, packed)) {
+            features = FieldFeatures::Unpack(packed);
+        } else {
+            features = AnalyzeField(rows, width, height);
+            if (p_cache) {
+                p_cache->Store(hash, features.Pack());
+            }
+        }
+
+        return
+            p_weights.lines * lines +
+            p_weights.holes * features.holes +
+            p_weights.height * features.height +
+            p_weights.bumpiness * features.bumpiness +
+            p_weights.top * features.top;
+    }
+
+    // key is pressed and released in the same frame, so only events
+    // are generated and key state stays as it is
+    static void PressKey(Input &input, InputKey key, uint32_t time)
+    {
+        for (int down = 1; down >= 0; --down) {
+            if (input.event_count == INPUT_EVENT_COUNT) {
+                ++input.event_dropped;
+                continue;
+            }
+
+            InputEvent &event = input.events[input.event_count++];
+            event.type = down ? INPUT_KEY_DOWN : INPUT_KEY_UP;
+            event.time = time;
+            event.keyboard.key = key;
+        }
+    }
+
+private:
+    const Game &p_game;
+    BotWeights  p_weights;
+    HashCache  *p_cache;
+    Placements  p_placements;
+};
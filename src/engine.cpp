@@ -7,67 +7,97 @@
 
 // platform independend engine functions
 
-#include <gl/GL.h>
+#include "engine/engine.h"
 #include "platform/platform.h"
 
 
-static InputEvent *new_event(Input &input)
+static InputEvent *new_event(Input &input, uint32_t time)
 {
     if (input.event_count == INPUT_EVENT_COUNT) {
+        ++input.event_dropped;
         return nullptr;
     } else {
-        return input.events + input.event_count++;
+        InputEvent *event = input.events + input.event_count++;
+        event->time = time;
+        return event;
     }
 }
 
 
-// since OpenGL is cross-platform by itself - most of GraphicsAPI implemented here
-class OpenGLAPI : public GraphicsAPI
+// Histogram implementation
+
+void Histogram::Reset()
 {
-public:
-    OpenGLAPI()
-    {
-        // basic OpenGL set-up
-        glFrontFace(GL_CW);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    p_count = 0;
+    p_sum = 0;
+    p_min = 0;
+    p_max = 0;
+    for (int n = 0; n < HISTOGRAM_BUCKET_COUNT; ++n) {
+        p_buckets[n] = 0;
     }
+}
 
-    ~OpenGLAPI()
-    {}
-
-    void Clear(const Color &color) override
-    {
-        const float k = 1.0f / 255.0f;
-        glClearColor(color.r * k, color.g * k, color.b * k, color.a * k);
-        glClear(GL_COLOR_BUFFER_BIT);
+void Histogram::Record(uint64_t value)
+{
+    if (value > 0xFFFFFFFFu) {
+        value = 0xFFFFFFFFu;
     }
 
-    void Viewport(int left, int top, int width, int height) override
-    {
-        int rt_width, rt_height;
-        GetRenderTargetSize(rt_width, rt_height);
+    p_min = p_count == 0 || value < p_min ? value : p_min;
+    p_max = value > p_max ? value : p_max;
+    p_sum += value;
+    ++p_count;
 
-        // OpenGL's viewport origin is located at bottom left
-        glViewport(left, rt_height - top, width, height);
+    ++p_buckets[BucketIndex(uint32_t(value))];
+}
+
+uint64_t Histogram::Percentile(double fraction) const
+{
+    if (p_count == 0) {
+        return 0;
     }
 
-    void Rectangle(float left, float top, float width, float height, const Color &color) override
-    {
-        // just for test - render with glBegin/glEnd, later this will be changed
-        // to more practical solution
-        glBegin(GL_TRIANGLES);
+    uint64_t target = uint64_t(fraction * double(p_count) + 0.5);
+    target = target < 1 ? 1 : (target > p_count ? p_count : target);
+
+    uint64_t counted = 0;
+    for (int n = 0; n < HISTOGRAM_BUCKET_COUNT; ++n) {
+        counted += p_buckets[n];
+        if (counted >= target) {
+            // bucket top could be above real maximum, don't report that
+            uint64_t value = BucketTop(n);
+            return value < p_max ? value : p_max;
+        }
+    }
 
-        glColor4ub(color.r, color.g, color.b, color.a);
+    return p_max;
+}
 
-        glVertex2f(left, top);
-        glVertex2f(left + width, top);
-        glVertex2f(left, top + height);
+// small values go to exact buckets, for larger values each power of two range
+// is split into HISTOGRAM_HALF_COUNT buckets
+int Histogram::BucketIndex(uint32_t value)
+{
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return int(value);
+    }
+
+    int msb = 0;
+    while ((value >> msb) > 1) {
+        ++msb;
+    }
 
-        glVertex2f(left + width, top);
-        glVertex2f(left + width, top + height);
-        glVertex2f(left, top + height);
+    int shift = msb - HISTOGRAM_SUB_BITS + 1;
+    return shift * HISTOGRAM_HALF_COUNT + int(value >> shift);
+}
 
-        glEnd();
+// largest value which falls into given bucket
+uint64_t Histogram::BucketTop(int index)
+{
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return uint64_t(index);
     }
-};
+
+    int shift = index / HISTOGRAM_HALF_COUNT - 1;
+    uint64_t top = uint64_t(index - shift * HISTOGRAM_HALF_COUNT);
+    return ((top + 1) << shift) - 1;
+}
@@ -0,0 +1,1167 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// headless platform entry point
+// runs game without window, GPU or real input devices: input is taken from
+// script file, frames are rendered with software renderer and can be saved
+// as PPM images and compared against golden images
+// this is used to check that renderer changes don't break visuals
+//
+// build same way as windows version, just point platform include to this folder:
+//     c++ -O2 -Iinclude -Isrc -Isrc/headless src/tetris.cpp -o tetris_headless
+//
+// usage:
+//     tetris_headless [options]
+//         -seed N        game seed (default 1)
+//         -ticks N       number of game ticks to run (default 600)
+//         -rate N        game ticks per second (default 60)
+//         -size W H      render target size (default 640 480)
+//         -input FILE    input script
+//         -replay FILE   play recorded replay (game seed and tick intervals come from it)
+//         -record FILE   record input into replay file
+//         -archive FILE  play seekable replay archive (game seed comes from it)
+//         -seek N        start archive playback at tick N
+//         -archive-record FILE
+//                        record input with game keyframes into seekable archive
+//         -keyframe N    ticks between archive keyframes (default 600)
+//         -bot           let bot play the game
+//         -spectate N    N games played by bots shown at once in spectator view
+//         -versus        two bots play versus match, shown in spectator view
+//         -latency N     versus link latency in milliseconds (default 0)
+//         -jitter N      max extra versus link latency in milliseconds (default 0)
+//         -capture LIST  comma separated list of ticks to render, like 1,60,600
+//         -every N       render every N-th tick
+//         -out DIR       save rendered frames into DIR
+//         -golden DIR    compare rendered frames with images in DIR
+//         -tolerance N   max per channel difference for pixels to be equal (default 0)
+//         -update        write rendered frames into golden DIR instead of comparing
+//         -telemetry T   write frame timing telemetry to file or unix:socket T
+//         -telemetry-interval N
+//                        telemetry report interval in seconds (default 1)
+//         -check-alloc   fail if anything is allocated with new while game runs
+//         -benchmark     render every tick as fast as possible, report frame times
+//         -fps N         pace ticks to N per second in real time, report frame intervals
+//         -audio FILE    write game audio into .wav file, audio is mixed tick by tick,
+//                        with -fps it's mixed on audio thread in real time
+//         -verify LIST   re-simulate replays from LIST and check claimed results,
+//                        see verifier.cpp for list format
+//         -threads N     worker threads for -verify and -tune (default all cores)
+//         -tune N        evolve bot weights for N generations, -seed seeds
+//                        first population
+//         -population N  weight vectors in tuner population (default 64)
+//         -games N       games played by every vector in generation (default 16)
+//         -game-ticks N  tick limit of tuner game (default 72000)
+//         -checkpoint FILE
+//                        save tuner population to FILE after every generation,
+//                        continue from FILE if it exists
+//         -board-benchmark
+//                        compare game logic speed of fixed size and run time
+//                        sized boards, bot input for -ticks ticks is recorded
+//                        and then played on both, then -ticks figures are
+//                        placed where bot puts them to time collision, lock
+//                        and landing rows alone
+//         -batch-benchmark N
+//                        compare N games in GameBatch against N Game objects
+//                        making the same random moves for -ticks ticks
+//         -selftest DIR  run self checks (see selftest.cpp), their files go
+//                        into DIR
+//
+// input script format is described in inputsource.cpp, frame numbers there
+// are ticks, run stops early when replay ends
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <new>
+#include "platform/platform.h"
+
+
+// common engine functions and implementation
+#include "engine.cpp"
+#include "software.cpp"
+#include "telemetry.cpp"
+#include "inputsource.cpp"
+#include "archive.cpp"
+#include "verifier.cpp"
+#include "tuner.cpp"
+#include "selftest.cpp"
+#include "audio.cpp"
+
+
+// allocation counting hook, all allocations done with new go through here,
+// so game loop could be checked for allocations
+static std::atomic<size_t> allocation_count(0);
+
+static void *CountedAllocate(size_t size)
+{
+    ++allocation_count;
+    if (void *memory = malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size)
+{
+    return CountedAllocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return CountedAllocate(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+
+// platform API implementation
+class HeadlessPlatform : public PlatformAPI
+{
+public:
+    HeadlessPlatform() :
+        p_quit(false)
+    {}
+
+    void Quit() override
+    {
+        p_quit = true;
+    }
+
+    void DEBUGPrint(const char *format, ...) override
+    {
+        va_list va;
+        va_start(va, format);
+        vfprintf(stderr, format, va);
+        va_end(va);
+    }
+
+    bool quit() const { return p_quit; }
+
+private:
+    bool p_quit;
+};
+
+
+// frame images
+
+static bool WritePPM(const char *filename, const SoftwareAPI &api)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Couldn't write image \"%s\"\n", filename);
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", api.width(), api.height());
+    const Color *pixel = api.pixels();
+    for (int n = 0; n < api.width() * api.height(); ++n, ++pixel) {
+        uint8_t rgb[3] = { pixel->r, pixel->g, pixel->b };
+        fwrite(rgb, 1, 3, file);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// compares rendered frame with PPM image, returns number of differing
+// pixels or -1 if image couldn't be loaded or has different size
+static int ComparePPM(const char *filename, const SoftwareAPI &api, int tolerance)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "Couldn't open golden image \"%s\"\n", filename);
+        return -1;
+    }
+
+    int width, height, maxvalue;
+    if (fscanf(file, "P6 %d %d %d", &width, &height, &maxvalue) != 3 ||
+        width != api.width() || height != api.height() || maxvalue != 255)
+    {
+        fprintf(stderr, "Golden image \"%s\" has wrong format or size\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    // single whitespace separates header from pixel data
+    fgetc(file);
+
+    int different = 0;
+    const Color *pixel = api.pixels();
+    for (int n = 0; n < width * height; ++n, ++pixel) {
+        uint8_t rgb[3];
+        if (fread(rgb, 1, 3, file) != 3) {
+            fprintf(stderr, "Golden image \"%s\" is truncated\n", filename);
+            fclose(file);
+            return -1;
+        }
+
+        if (abs(rgb[0] - pixel->r) > tolerance ||
+            abs(rgb[1] - pixel->g) > tolerance ||
+            abs(rgb[2] - pixel->b) > tolerance)
+        {
+            ++different;
+        }
+    }
+
+    fclose(file);
+    return different;
+}
+
+
+// command line options
+struct HeadlessOptions
+{
+    uint64_t    seed;
+    int         ticks;
+    int         rate;
+    int         width;
+    int         height;
+    const char *input;
+    const char *replay;
+    const char *record;
+    const char *archive;
+    int         seek;
+    const char *archive_record;
+    int         keyframe;
+    bool        bot;
+    int         spectate;
+    bool        versus;
+    int         latency;
+    int         jitter;
+    const char *capture;
+    int         every;
+    const char *out;
+    const char *golden;
+    int         tolerance;
+    bool        update;
+    const char *telemetry;
+    double      telemetry_interval;
+    bool        check_alloc;
+    bool        benchmark;
+    int         fps;
+    const char *audio;
+    bool        board_benchmark;
+    int         batch_benchmark;
+    const char *verify;
+    int         threads;
+    int         tune;
+    int         population;
+    int         games;
+    int         game_ticks;
+    const char *checkpoint;
+    const char *selftest;
+};
+
+static bool ParseOptions(int argc, char **argv, HeadlessOptions &options)
+{
+    options.seed = 1;
+    options.ticks = 600;
+    options.rate = 60;
+    options.width = 640;
+    options.height = 480;
+    options.input = nullptr;
+    options.replay = nullptr;
+    options.record = nullptr;
+    options.archive = nullptr;
+    options.seek = 0;
+    options.archive_record = nullptr;
+    options.keyframe = 600;
+    options.bot = false;
+    options.spectate = 0;
+    options.versus = false;
+    options.latency = 0;
+    options.jitter = 0;
+    options.capture = nullptr;
+    options.every = 0;
+    options.out = nullptr;
+    options.golden = nullptr;
+    options.tolerance = 0;
+    options.update = false;
+    options.telemetry = nullptr;
+    options.telemetry_interval = 1;
+    options.check_alloc = false;
+    options.benchmark = false;
+    options.fps = 0;
+    options.audio = nullptr;
+    options.board_benchmark = false;
+    options.batch_benchmark = 0;
+    options.verify = nullptr;
+    options.threads = 0;
+    options.tune = 0;
+    options.population = TUNER_DEFAULT_SETTINGS.population;
+    options.games = TUNER_DEFAULT_SETTINGS.games;
+    options.game_ticks = TUNER_DEFAULT_SETTINGS.ticks;
+    options.checkpoint = nullptr;
+    options.selftest = nullptr;
+
+    for (int arg = 1; arg < argc; ++arg) {
+        const char *name = argv[arg];
+        bool hasvalue = arg + 1 < argc;
+
+        if (strcmp(name, "-seed") == 0 && hasvalue) {
+            options.seed = strtoull(argv[++arg], nullptr, 0);
+        } else if (strcmp(name, "-ticks") == 0 && hasvalue) {
+            options.ticks = atoi(argv[++arg]);
+        } else if (strcmp(name, "-rate") == 0 && hasvalue) {
+            options.rate = atoi(argv[++arg]);
+        } else if (strcmp(name, "-size") == 0 && arg + 2 < argc) {
+            options.width = atoi(argv[++arg]);
+            options.height = atoi(argv[++arg]);
+        } else if (strcmp(name, "-input") == 0 && hasvalue) {
+            options.input = argv[++arg];
+        } else if (strcmp(name, "-replay") == 0 && hasvalue) {
+            options.replay = argv[++arg];
+        } else if (strcmp(name, "-record") == 0 && hasvalue) {
+            options.record = argv[++arg];
+        } else if (strcmp(name, "-archive") == 0 && hasvalue) {
+            options.archive = argv[++arg];
+        } else if (strcmp(name, "-seek") == 0 && hasvalue) {
+            options.seek = atoi(argv[++arg]);
+        } else if (strcmp(name, "-archive-record") == 0 && hasvalue) {
+            options.archive_record = argv[++arg];
+        } else if (strcmp(name, "-keyframe") == 0 && hasvalue) {
+            options.keyframe = atoi(argv[++arg]);
+        } else if (strcmp(name, "-bot") == 0) {
+            options.bot = true;
+        } else if (strcmp(name, "-spectate") == 0 && hasvalue) {
+            options.spectate = atoi(argv[++arg]);
+        } else if (strcmp(name, "-versus") == 0) {
+            options.versus = true;
+        } else if (strcmp(name, "-latency") == 0 && hasvalue) {
+            options.latency = atoi(argv[++arg]);
+        } else if (strcmp(name, "-jitter") == 0 && hasvalue) {
+            options.jitter = atoi(argv[++arg]);
+        } else if (strcmp(name, "-capture") == 0 && hasvalue) {
+            options.capture = argv[++arg];
+        } else if (strcmp(name, "-every") == 0 && hasvalue) {
+            options.every = atoi(argv[++arg]);
+        } else if (strcmp(name, "-out") == 0 && hasvalue) {
+            options.out = argv[++arg];
+        } else if (strcmp(name, "-golden") == 0 && hasvalue) {
+            options.golden = argv[++arg];
+        } else if (strcmp(name, "-tolerance") == 0 && hasvalue) {
+            options.tolerance = atoi(argv[++arg]);
+        } else if (strcmp(name, "-update") == 0) {
+            options.update = true;
+        } else if (strcmp(name, "-telemetry") == 0 && hasvalue) {
+            options.telemetry = argv[++arg];
+        } else if (strcmp(name, "-telemetry-interval") == 0 && hasvalue) {
+            options.telemetry_interval = atof(argv[++arg]);
+        } else if (strcmp(name, "-check-alloc") == 0) {
+            options.check_alloc = true;
+        } else if (strcmp(name, "-benchmark") == 0) {
+            options.benchmark = true;
+        } else if (strcmp(name, "-fps") == 0 && hasvalue) {
+            options.fps = atoi(argv[++arg]);
+        } else if (strcmp(name, "-audio") == 0 && hasvalue) {
+            options.audio = argv[++arg];
+        } else if (strcmp(name, "-board-benchmark") == 0) {
+            options.board_benchmark = true;
+        } else if (strcmp(name, "-batch-benchmark") == 0 && hasvalue) {
+            options.batch_benchmark = atoi(argv[++arg]);
+        } else if (strcmp(name, "-verify") == 0 && hasvalue) {
+            options.verify = argv[++arg];
+        } else if (strcmp(name, "-threads") == 0 && hasvalue) {
+            options.threads = atoi(argv[++arg]);
+        } else if (strcmp(name, "-tune") == 0 && hasvalue) {
+            options.tune = atoi(argv[++arg]);
+        } else if (strcmp(name, "-population") == 0 && hasvalue) {
+            options.population = atoi(argv[++arg]);
+        } else if (strcmp(name, "-games") == 0 && hasvalue) {
+            options.games = atoi(argv[++arg]);
+        } else if (strcmp(name, "-game-ticks") == 0 && hasvalue) {
+            options.game_ticks = atoi(argv[++arg]);
+        } else if (strcmp(name, "-checkpoint") == 0 && hasvalue) {
+            options.checkpoint = argv[++arg];
+        } else if (strcmp(name, "-selftest") == 0 && hasvalue) {
+            options.selftest = argv[++arg];
+        } else {
+            fprintf(stderr, "Unknown or incomplete option \"%s\"\n", name);
+            return false;
+        }
+    }
+
+    if (options.ticks <= 0 || options.rate <= 0 || options.width <= 0 || options.height <= 0) {
+        fprintf(stderr, "Invalid ticks, rate or size\n");
+        return false;
+    }
+
+    if ((options.input != nullptr) + (options.replay != nullptr) + (options.archive != nullptr) + options.bot > 1) {
+        fprintf(stderr, "Only one of -input, -replay, -archive and -bot could be used\n");
+        return false;
+    }
+
+    if (options.seek < 0 || options.keyframe <= 0) {
+        fprintf(stderr, "Invalid seek or keyframe interval\n");
+        return false;
+    }
+
+    if (options.update && options.golden == nullptr) {
+        fprintf(stderr, "-update requires -golden\n");
+        return false;
+    }
+
+    return true;
+}
+
+// checks if given tick should be rendered
+static bool IsCaptureTick(const HeadlessOptions &options, int tick)
+{
+    if (options.every > 0 && tick % options.every == 0) {
+        return true;
+    }
+
+    // capture list is short, just scan it
+    for (const char *item = options.capture; item && *item; ) {
+        char *end = nullptr;
+        long value = strtol(item, &end, 10);
+        if (end == item) {
+            break;
+        }
+        if (value == tick) {
+            return true;
+        }
+        item = *end == ',' ? end + 1 : end;
+    }
+
+    return false;
+}
+
+
+static uint64_t Microseconds(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+}
+
+// waits for next frame time of pacer, times are microseconds since start
+static void WaitForFrame(FramePacer &pacer, std::chrono::steady_clock::time_point start)
+{
+    for (;;) {
+        uint64_t now = Microseconds(start, std::chrono::steady_clock::now());
+        if (pacer.Ready(now)) {
+            return;
+        }
+
+        if (uint64_t sleep = pacer.SleepTime(now)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(sleep));
+            pacer.Slept(sleep, Microseconds(start, std::chrono::steady_clock::now()) - now);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+// bot input recorded for board benchmark, every tick has its own events
+// with their times, so games get exactly what bot gave
+struct BoardBenchmarkInput
+{
+    enum { TICK_EVENTS = 4 }; // bot gives press and release of one key per tick
+
+    InputEvent *events; // TICK_EVENTS per tick
+    uint8_t    *counts; // events of every tick
+};
+
+// plays recorded input on a game, returns time taken in seconds
+// only game logic is timed: input, collision checks, locking, row removal
+template <typename GameType>
+static double PlayBoardBenchmark(GameType &game, PlatformAPI &platform, const BoardBenchmarkInput &recorded, int ticks, float interval)
+{
+    Input input = {};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int tick = 0; tick < ticks; ++tick) {
+        input.event_count = recorded.counts[tick];
+        for (size_t ev = 0; ev < input.event_count; ++ev) {
+            input.events[ev] = recorded.events[tick * BoardBenchmarkInput::TICK_EVENTS + ev];
+        }
+
+        game.ProcessInput(platform, input);
+        game.Update(interval);
+    }
+
+    return Microseconds(start, std::chrono::steady_clock::now()) / 1e6;
+}
+
+// figure placement of bot game, same placements are played on both boards
+struct BoardPlacement
+{
+    int8_t rotation;
+    int8_t x;
+};
+
+// places recorded figures on a game with effects off, only collision checks
+// down to landing row and locking with row removal are timed, with landing
+// rows on landing rows of every figure are computed before it's placed, the
+// way bot does, returns time taken in seconds
+template <typename GameType>
+static double PlayBoardPlacements(GameType &game, uint64_t seed, const BoardPlacement *placements, int count, bool landing, int &checksum)
+{
+    game.Reset(seed);
+    game.SetEffects(false);
+    Placements rows;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int n = 0; n < count; ++n) {
+        if (landing) {
+            game.GetPlacements(game.figure().type(), rows);
+            checksum += rows.rows[0][placements[n].x];
+        }
+        game.Place(placements[n].rotation, placements[n].x);
+    }
+
+    return Microseconds(start, std::chrono::steady_clock::now()) / 1e6;
+}
+
+// fixed 10x20 board against same board sized at run time
+static int RunBoardBenchmark(const HeadlessOptions &options)
+{
+    HeadlessPlatform platform;
+    float interval = 1.0f / float(options.rate);
+
+    // bot is slow compared to the game, so its input is recorded first
+    BoardBenchmarkInput recorded;
+    recorded.events = new InputEvent[size_t(options.ticks) * BoardBenchmarkInput::TICK_EVENTS];
+    recorded.counts = new uint8_t[options.ticks];
+    Game botgame(options.seed);
+    bool fits = true;
+    {
+        HashCache cache(1 << 16);
+        BotInput bot(botgame, BOT_DEFAULT_WEIGHTS, &cache);
+        Input input = {};
+
+        for (int tick = 0; tick < options.ticks; ++tick) {
+            input.event_count = 0;
+            input.event_dropped = 0;
+            float botinterval = interval;
+            bot.NextFrame(input, uint32_t(uint64_t(tick) * 1000 / options.rate), botinterval);
+
+            fits = fits && input.event_count <= BoardBenchmarkInput::TICK_EVENTS && input.event_dropped == 0;
+            recorded.counts[tick] = uint8_t(fits ? input.event_count : 0);
+            for (size_t ev = 0; ev < recorded.counts[tick]; ++ev) {
+                recorded.events[tick * BoardBenchmarkInput::TICK_EVENTS + ev] = input.events[ev];
+            }
+
+            botgame.ProcessInput(platform, input);
+            botgame.Update(interval);
+        }
+    }
+
+    // boards take turns, best of several runs is taken to filter out noise
+    Game fixed(options.seed);
+    CustomGame custom(options.seed, Game::FIELD_WIDTH, Game::FIELD_HEIGHT);
+    double fixedtime = 0;
+    double customtime = 0;
+    for (int run = 0; run < 5; ++run) {
+        fixed.Reset(options.seed);
+        double time = PlayBoardBenchmark(fixed, platform, recorded, options.ticks, interval);
+        fixedtime = run == 0 || time < fixedtime ? time : fixedtime;
+
+        custom.Reset(options.seed);
+        time = PlayBoardBenchmark(custom, platform, recorded, options.ticks, interval);
+        customtime = run == 0 || time < customtime ? time : customtime;
+    }
+    delete[] recorded.events;
+    delete[] recorded.counts;
+
+    printf(
+        "bot: %d lines, score %d\n"
+        "fixed %dx%d: %.3f ms, %d lines\n"
+        "run time %dx%d: %.3f ms, %d lines\n"
+        "fixed board speedup %.2fx\n",
+        botgame.lines(), botgame.score(),
+        fixed.field_width(), fixed.field_height(), fixedtime * 1000, fixed.lines(),
+        custom.field_width(), custom.field_height(), customtime * 1000, custom.lines(),
+        fixedtime > 0 ? customtime / fixedtime : 0.0
+    );
+
+    // both boards should play exactly the game bot played, otherwise they
+    // weren't timed on the real game
+    bool same =
+        fits &&
+        fixed.lines() == botgame.lines() && fixed.score() == botgame.score() &&
+        fixed.game_overs() == botgame.game_overs() &&
+        custom.lines() == botgame.lines() && custom.score() == botgame.score() &&
+        custom.game_overs() == botgame.game_overs();
+    if (!same) {
+        fprintf(stderr, "Boards didn't play the game bot played\n");
+    }
+
+    // whole ticks are mostly effects and input, so collision, lock and
+    // landing rows are timed on their own too, on -ticks figures placed
+    // where bot puts them
+    BoardPlacement *placements = new BoardPlacement[options.ticks];
+    Game placed(options.seed);
+    placed.SetEffects(false);
+    int placecount = 0;
+    {
+        HashCache cache(1 << 16);
+        BotInput planner(placed, BOT_DEFAULT_WEIGHTS, &cache);
+        int rotation = 0, x = 0;
+        while (placecount < options.ticks && planner.Plan(rotation, x) && placed.Place(rotation, x)) {
+            placements[placecount].rotation = int8_t(rotation);
+            placements[placecount].x = int8_t(x);
+            ++placecount;
+        }
+    }
+
+    double fixedlock = 0, customlock = 0;
+    double fixedlanding = 0, customlanding = 0;
+    int checksum = 0;
+    for (int run = 0; run < 5; ++run) {
+        double time = PlayBoardPlacements(fixed, options.seed, placements, placecount, false, checksum);
+        fixedlock = run == 0 || time < fixedlock ? time : fixedlock;
+        time = PlayBoardPlacements(custom, options.seed, placements, placecount, false, checksum);
+        customlock = run == 0 || time < customlock ? time : customlock;
+
+        // landing rows time is what they add to placing
+        time = PlayBoardPlacements(fixed, options.seed, placements, placecount, true, checksum);
+        fixedlanding = run == 0 || time < fixedlanding ? time : fixedlanding;
+        time = PlayBoardPlacements(custom, options.seed, placements, placecount, true, checksum);
+        customlanding = run == 0 || time < customlanding ? time : customlanding;
+    }
+    delete[] placements;
+    fixedlanding -= fixedlock;
+    customlanding -= customlock;
+
+    double nanoseconds = placecount > 0 ? 1e9 / placecount : 0;
+    printf(
+        "%d figures placed, %d lines (checksum %d)\n"
+        "collision and lock: fixed %.1f ns, run time %.1f ns per figure, fixed board speedup %.2fx\n"
+        "landing rows: fixed %.1f ns, run time %.1f ns per figure, fixed board speedup %.2fx\n",
+        placecount, placed.lines(), checksum,
+        fixedlock * nanoseconds, customlock * nanoseconds, fixedlock > 0 ? customlock / fixedlock : 0.0,
+        fixedlanding * nanoseconds, customlanding * nanoseconds, fixedlanding > 0 ? customlanding / fixedlanding : 0.0
+    );
+
+    // placed figures should give same game on all boards
+    bool sameplaced =
+        fixed.lines() == placed.lines() && fixed.score() == placed.score() &&
+        fixed.field_hash() == placed.field_hash() &&
+        custom.lines() == placed.lines() && custom.score() == placed.score() &&
+        custom.field_hash() == placed.field_hash();
+    if (!sameplaced) {
+        fprintf(stderr, "Boards didn't place figures the way bot did\n");
+    }
+
+    return same && sameplaced ? 0 : 1;
+}
+
+
+// same games played by GameBatch and by pool of Game objects, every tick
+// advances all games, so both are timed the way mass simulation runs
+static int RunBatchBenchmark(const HeadlessOptions &options)
+{
+    HeadlessPlatform platform;
+    float interval = 1.0f / float(options.rate);
+    size_t count = size_t(options.batch_benchmark);
+
+    // moves of all games are made up front, so both sides only play them
+    int8_t *moves = new int8_t[count * options.ticks];
+    Random random(options.seed);
+    for (size_t move = 0; move < count * options.ticks; ++move) {
+        moves[move] = int8_t(int(random.Next(3)) - 1);
+    }
+
+    GamePool pool(count);
+    for (size_t game = 0; game < count; ++game) {
+        pool.Create(game);
+    }
+
+    Input input = {};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < options.ticks; ++tick) {
+        const int8_t *dx = moves + tick * count;
+        uint32_t time = uint32_t(uint64_t(tick) * 1000 / options.rate);
+        for (size_t game = 0; game < count; ++game) {
+            GameBatch::MoveLikeBatch(*pool.game(game), platform, input, dx[game], time);
+            pool.game(game)->Update(interval);
+        }
+    }
+    double gametime = Microseconds(start, std::chrono::steady_clock::now()) / 1e6;
+
+    GameBatch batch(count);
+    start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < options.ticks; ++tick) {
+        batch.Move(moves + tick * count);
+        batch.Update(interval);
+    }
+    double batchtime = Microseconds(start, std::chrono::steady_clock::now()) / 1e6;
+    delete[] moves;
+
+    size_t matching = 0;
+    int lines = 0;
+    for (size_t game = 0; game < count; ++game) {
+        matching += batch.Matches(game, *pool.game(game)) ? 1 : 0;
+        lines += pool.game(game)->lines();
+    }
+
+    double steps = double(count) * options.ticks;
+    printf(
+        "Game: %.3f ms, %.0f game ticks/s, %.1f ns per game tick\n"
+        "GameBatch: %.3f ms, %.0f game ticks/s, %.1f ns per game tick\n"
+        "batch speedup %.2fx\n"
+        "%zu of %zu games match, %d lines on boards\n",
+        gametime * 1000, gametime > 0 ? steps / gametime : 0.0, gametime * 1e9 / steps,
+        batchtime * 1000, batchtime > 0 ? steps / batchtime : 0.0, batchtime * 1e9 / steps,
+        batchtime > 0 ? gametime / batchtime : 0.0,
+        matching, count, lines
+    );
+
+    return matching == count ? 0 : 1;
+}
+
+
+// checks all replays from list, fails if any of them doesn't match its claim
+static int RunVerifier(const HeadlessOptions &options)
+{
+    ReplayVerifier verifier;
+    if (!verifier.Load(options.verify)) {
+        return 2;
+    }
+
+    double seconds = verifier.Run(options.threads > 0 ? unsigned(options.threads) : 0);
+
+    size_t counts[VERIFY_BROKEN + 1] = {};
+    double gametime = 0;
+    for (size_t n = 0; n < verifier.count(); ++n) {
+        const VerifyEntry &entry = verifier.entry(n);
+        ++counts[entry.status];
+        gametime += entry.time;
+
+        if (entry.status == VERIFY_MISMATCH) {
+            printf(
+                "%s: MISMATCH, claimed %d lines, score %d, replay gives %d lines, score %d\n",
+                entry.path, entry.claimed_lines, entry.claimed_score, entry.lines, entry.score
+            );
+        } else if (entry.status == VERIFY_BROKEN) {
+            printf("%s: BROKEN\n", entry.path);
+        }
+    }
+
+    printf(
+        "%llu replays: %llu ok, %llu mismatched, %llu broken\n",
+        (unsigned long long)verifier.count(), (unsigned long long)counts[VERIFY_OK],
+        (unsigned long long)counts[VERIFY_MISMATCH], (unsigned long long)counts[VERIFY_BROKEN]
+    );
+    printf(
+        "%.3f s, %.1f games/s, %.0f ticks/s, %.0fx real time\n",
+        seconds, seconds > 0 ? verifier.count() / seconds : 0.0,
+        seconds > 0 ? verifier.ticks() / seconds : 0.0,
+        seconds > 0 ? gametime / seconds : 0.0
+    );
+
+    return counts[VERIFY_OK] == verifier.count() ? 0 : 1;
+}
+
+
+static int RunTuner(const HeadlessOptions &options)
+{
+    TunerSettings settings = TUNER_DEFAULT_SETTINGS;
+    settings.population = options.population;
+    settings.games = options.games;
+    settings.ticks = options.game_ticks;
+    settings.rate = float(options.rate);
+
+    BotTuner tuner(settings);
+    if (options.checkpoint && tuner.LoadCheckpoint(options.checkpoint)) {
+        printf("continuing from generation %llu\n", (unsigned long long)tuner.generation());
+    } else {
+        tuner.Start(options.seed);
+    }
+
+    unsigned threads = options.threads > 0 ? unsigned(options.threads) : 0;
+    while (tuner.generation() < uint64_t(options.tune)) {
+        double seconds = tuner.Step(threads);
+
+        const TunerIndividual &best = tuner.best();
+        printf(
+            "generation %llu: best %.1f lines, weights %.4f %.4f %.4f %.4f %.4f\n",
+            (unsigned long long)tuner.generation(), best.fitness,
+            best.weights.lines, best.weights.holes, best.weights.height,
+            best.weights.bumpiness, best.weights.top
+        );
+
+        int games = tuner.population() * tuner.games();
+        printf(
+            "    %.3f s, %.1f games/s, %.0f ticks/s\n",
+            seconds, seconds > 0 ? games / seconds : 0.0,
+            seconds > 0 ? tuner.ticks() / seconds : 0.0
+        );
+        fflush(stdout);
+
+        if (options.checkpoint && !tuner.SaveCheckpoint(options.checkpoint)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+// main entry point function, program execution starts here
+int main(int argc, char **argv)
+{
+    HeadlessOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    if (options.board_benchmark) {
+        return RunBoardBenchmark(options);
+    }
+
+    if (options.batch_benchmark > 0) {
+        return RunBatchBenchmark(options);
+    }
+
+    if (options.verify) {
+        return RunVerifier(options);
+    }
+
+    if (options.selftest) {
+        return RunSelfTest(options.selftest);
+    }
+
+    if (options.tune > 0) {
+        return RunTuner(options);
+    }
+
+    // script without events is used when there's no other input
+    ScriptInput script;
+    if (options.input && !script.Load(options.input)) {
+        return 2;
+    }
+
+    ReplayInput replay;
+    if (options.replay) {
+        if (!replay.Open(options.replay)) {
+            return 2;
+        }
+        options.seed = replay.seed();
+    }
+
+    ArchiveInput archive;
+    if (options.archive) {
+        if (!archive.Open(options.archive)) {
+            return 2;
+        }
+        options.seed = archive.seed();
+    }
+
+    HeadlessPlatform platform;
+    SoftwareAPI graphics(options.width, options.height);
+
+    // all game memory is allocated once before game starts
+    uint8_t *gamememory = new uint8_t[Game::MemorySize()];
+    Arena gamearena(gamememory, Game::MemorySize());
+    Game game(gamearena, options.seed);
+
+    HashCache botcache(1 << 16);
+    BotInput bot(game, BOT_DEFAULT_WEIGHTS, &botcache);
+
+    InputSource *source = &script;
+    if (options.replay) {
+        source = &replay;
+    } else if (options.archive) {
+        source = &archive;
+    } else if (options.bot) {
+        source = &bot;
+    }
+
+    // spectator games are created up front, same as the game
+    BotGames *spectate = options.spectate > 0 ? new BotGames(options.spectate, options.seed) : nullptr;
+    VersusMatch *versus = options.versus ?
+        new VersusMatch(options.seed, uint32_t(options.latency), uint32_t(options.jitter)) : nullptr;
+    Spectator spectator(options.spectate > 0 ? options.spectate : (versus ? 2 : 0));
+
+    RecordingInput recording(*source);
+    if (options.record) {
+        if (!recording.Open(options.record, options.seed)) {
+            delete spectate;
+            delete versus;
+            delete[] gamememory;
+            return 2;
+        }
+        source = &recording;
+    }
+
+    ArchiveRecorder archiverecording(*source, game);
+    if (options.archive_record) {
+        if (!archiverecording.Open(options.archive_record, options.seed, uint32_t(options.keyframe))) {
+            delete spectate;
+            delete versus;
+            delete[] gamememory;
+            return 2;
+        }
+        source = &archiverecording;
+    }
+
+    if (options.archive && options.seek > 0) {
+        std::chrono::steady_clock::time_point seekstart = std::chrono::steady_clock::now();
+        if (!archive.Seek(game, platform, uint64_t(options.seek))) {
+            fprintf(stderr, "Couldn't seek archive to tick %d\n", options.seek);
+            delete spectate;
+            delete versus;
+            delete[] gamememory;
+            return 2;
+        }
+        printf(
+            "seek to tick %llu of %llu: %.3f ms\n",
+            (unsigned long long)archive.tick(), (unsigned long long)archive.ticks(),
+            Microseconds(seekstart, std::chrono::steady_clock::now()) / 1000.0
+        );
+    }
+
+    Telemetry telemetry;
+    if (options.telemetry && !telemetry.Open(options.telemetry, options.telemetry_interval)) {
+        fprintf(stderr, "Couldn't open telemetry output \"%s\"\n", options.telemetry);
+    }
+
+    // real time audio runs on its own thread, offline audio is mixed right
+    // after every tick for exactly tick interval
+    AudioMixer mixer;
+    WavFileAudioOutput audiofile(options.fps > 0);
+    AudioThread audiothread(mixer, audiofile);
+    int16_t *audioblock = nullptr;
+    double audiotime = 0;
+    uint64_t audioframes = 0;
+    if (options.audio) {
+        if (audiofile.Open(options.audio)) {
+            game.LoadAudio(mixer);
+            if (options.fps > 0) {
+                audiothread.Start();
+            } else {
+                audioblock = new int16_t[AUDIO_MAX_BLOCK * 2];
+            }
+        } else {
+            options.audio = nullptr;
+        }
+    }
+
+    Input input = {};
+    std::chrono::steady_clock::time_point runstart = std::chrono::steady_clock::now();
+    size_t allocations = allocation_count;
+
+    float interval = 1.0f / float(options.rate);
+    int frames = 0;
+    int failures = 0;
+    double rendertotal = 0;
+    double rendermin = 0;
+    double rendermax = 0;
+
+    // frame time when benchmarking, frame interval when pacing
+    Histogram frametimes;
+    FramePacer pacer;
+    pacer.Start(0, options.fps > 0 ? 1000000 / options.fps : 0);
+    uint64_t lastframe = 0;
+
+    int ticks = 0;
+    for (int tick = 1; tick <= options.ticks && !platform.quit(); ++tick) {
+        // input time runs in milliseconds as on real platforms
+        uint32_t time = uint32_t(int64_t(tick) * 1000 / options.rate);
+
+        std::chrono::steady_clock::time_point tickstart = std::chrono::steady_clock::now();
+
+        // gather input for this tick
+        input.event_count = 0;
+        input.event_dropped = 0;
+        float tickinterval = interval;
+        if (!source->NextFrame(input, time, tickinterval)) {
+            break;
+        }
+        ticks = tick;
+
+        std::chrono::steady_clock::time_point inputend = std::chrono::steady_clock::now();
+        if (spectate == nullptr && versus == nullptr) {
+            game.ProcessInput(platform, input);
+        }
+        std::chrono::steady_clock::time_point processend = std::chrono::steady_clock::now();
+        if (spectate) {
+            spectate->Update(platform, time, tickinterval);
+        } else if (versus) {
+            versus->Update(platform, time, tickinterval);
+        } else {
+            game.Update(tickinterval);
+        }
+
+        if (options.audio) {
+            game.RenderAudio(mixer);
+
+            audiotime += tickinterval;
+            uint64_t target = uint64_t(audiotime * AUDIO_SAMPLE_RATE);
+            while (audioblock && audioframes < target) {
+                uint64_t left = target - audioframes;
+                size_t count = size_t(left < AUDIO_MAX_BLOCK ? left : uint64_t(AUDIO_MAX_BLOCK));
+                mixer.Mix(audioblock, count);
+                audiofile.Write(audioblock, count);
+                audioframes += count;
+            }
+        }
+        std::chrono::steady_clock::time_point updateend = std::chrono::steady_clock::now();
+
+        bool capture = IsCaptureTick(options, tick);
+        if (capture || options.benchmark) {
+            if (spectate) {
+                spectator.Render(graphics, spectate->pool(), options.width, options.height);
+            } else if (versus) {
+                spectator.Render(graphics, versus->pool(), options.width, options.height);
+            } else {
+                game.RenderGraphics(graphics, options.width, options.height);
+            }
+        }
+        std::chrono::steady_clock::time_point renderend = std::chrono::steady_clock::now();
+
+        if (telemetry.active()) {
+            uint64_t phases[TELEMETRY_PHASE_COUNT] = {
+                Microseconds(tickstart, inputend),
+                Microseconds(inputend, processend),
+                Microseconds(processend, updateend),
+                Microseconds(updateend, renderend)
+            };
+            telemetry.RecordFrame(Microseconds(tickstart, renderend), phases, input);
+            telemetry.Flush(std::chrono::duration<double>(renderend - runstart).count());
+        }
+
+        if (options.benchmark) {
+            frametimes.Record(Microseconds(tickstart, renderend));
+        }
+
+        if (options.fps > 0) {
+            pacer.NextFrame(Microseconds(runstart, std::chrono::steady_clock::now()));
+            WaitForFrame(pacer, runstart);
+
+            uint64_t now = Microseconds(runstart, std::chrono::steady_clock::now());
+            if (tick > 1) {
+                frametimes.Record(now - lastframe);
+            }
+            lastframe = now;
+        }
+
+        if (!capture) {
+            continue;
+        }
+
+        double rendertime = std::chrono::duration<double, std::milli>(renderend - updateend).count();
+        rendertotal += rendertime;
+        rendermin = frames == 0 || rendertime < rendermin ? rendertime : rendermin;
+        rendermax = frames == 0 || rendertime > rendermax ? rendertime : rendermax;
+        ++frames;
+
+        char filename[1024];
+        printf("frame %6d: render %8.3f ms", tick, rendertime);
+
+        if (options.out) {
+            snprintf(filename, sizeof(filename), "%s/frame_%06d.ppm", options.out, tick);
+            if (!WritePPM(filename, graphics)) {
+                ++failures;
+            }
+        }
+
+        if (options.golden) {
+            snprintf(filename, sizeof(filename), "%s/frame_%06d.ppm", options.golden, tick);
+            if (options.update) {
+                if (!WritePPM(filename, graphics)) {
+                    ++failures;
+                }
+            } else {
+                int different = ComparePPM(filename, graphics, options.tolerance);
+                if (different != 0) {
+                    ++failures;
+                }
+                if (different >= 0) {
+                    printf(", %d pixels differ", different);
+                }
+            }
+        }
+
+        printf("\n");
+    }
+
+    allocations = allocation_count - allocations;
+    if (options.check_alloc) {
+        printf("%llu allocations while game was running\n", (unsigned long long)allocations);
+        if (allocations > 0) {
+            ++failures;
+        }
+    }
+
+    printf("%d ticks run, %d lines\n", ticks, game.lines());
+    if (options.archive || options.archive_record) {
+        printf("score %d, field hash %016llx\n", game.score(), (unsigned long long)game.field_hash());
+    }
+    if (versus) {
+        const VersusBoard &a = versus->board_a();
+        const VersusBoard &b = versus->board_b();
+        printf(
+            "versus: wins %d:%d, garbage sent %d:%d, received %d:%d, lines %d:%d\n",
+            a.wins(), b.wins(), a.sent(), b.sent(), a.received(), b.received(),
+            versus->pool().game(0)->lines(), versus->pool().game(1)->lines()
+        );
+    }
+
+    if (frames > 0) {
+        printf(
+            "%d frames rendered, render time min %.3f ms, avg %.3f ms, max %.3f ms\n",
+            frames, rendermin, rendertotal / frames, rendermax
+        );
+    }
+
+    if (frametimes.count() > 0) {
+        printf(
+            "%s min %.3f ms, avg %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            options.fps > 0 ? "frame interval" : "frame time",
+            frametimes.min() / 1000.0, frametimes.mean() / 1000.0,
+            frametimes.Percentile(0.99) / 1000.0, frametimes.max() / 1000.0
+        );
+    }
+
+    if (options.audio) {
+        audiothread.Stop();
+        audiofile.Close();
+
+        AudioStats stats = mixer.stats();
+        printf(
+            "%llu sounds played, %llu dropped, latency avg %.3f ms, max %.3f ms\n",
+            (unsigned long long)stats.played, (unsigned long long)stats.dropped,
+            stats.latency_avg / 1000.0, stats.latency_max / 1000.0
+        );
+    }
+
+    if (failures > 0) {
+        printf("%d frames FAILED\n", failures);
+    }
+
+    delete[] audioblock;
+    delete spectate;
+    delete versus;
+    delete[] gamememory;
+
+    return failures > 0 ? 1 : 0;
+}
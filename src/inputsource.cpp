@@ -0,0 +1,492 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// platform independent input sources
+//     ScriptInput    - key events from text script, bound to frame numbers
+//     ReplayInput    - frames recorded by RecordingInput
+//     RecordingInput - passes frames from other source through and records them
+//
+// script is a text file, one key event per line:
+//     <frame> <down|up> <key>
+// key is either name (LEFT, RIGHT, UP, DOWN, SPACE, ESCAPE, ENTER, C) or key code,
+// lines should go in frame order, lines starting with # are comments
+//
+// replay file is binary: ReplayHeader followed by frames, every frame is
+// ReplayFrame followed by its events as is, so replay could be played back
+// only by same build on same kind of machine
+// replays could come from anywhere (see verifier.cpp), so events and
+// intervals are checked before use, bad or cut off replay is broken
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "platform/platform.h"
+
+
+// true if event fields, which are used as indices and bit numbers, are in
+// range, events read from files should be checked before they're applied
+static bool ValidEvent(const InputEvent &event)
+{
+    switch (event.type) {
+        case INPUT_MOUSE_MOVE:
+        case INPUT_MOUSE_WHEEL:
+        case INPUT_CHAR:
+            return true;
+
+        case INPUT_MOUSE_DOWN:
+        case INPUT_MOUSE_UP:
+            return uint32_t(event.mouse.button) < MOUSE_BUTTON_COUNT;
+
+        case INPUT_KEY_DOWN:
+        case INPUT_KEY_UP:
+            return uint32_t(event.keyboard.key) < KEY_COUNT;
+
+        case INPUT_BUTTON_DOWN:
+        case INPUT_BUTTON_UP:
+            return
+                event.joystick.number < JOYSTICK_DEVICE_COUNT &&
+                uint32_t(event.joystick.button) < JOY_BUTTON_COUNT;
+
+        case INPUT_AXIS:
+            return
+                event.joystick.number < JOYSTICK_DEVICE_COUNT &&
+                uint32_t(event.joystick.axis.axis) < JOY_AXIS_COUNT;
+
+        case INPUT_POV:
+            return
+                event.joystick.number < JOYSTICK_DEVICE_COUNT &&
+                uint32_t(event.joystick.pov.pov) < JOY_POV_COUNT;
+
+        case INPUT_CONNECT:
+        case INPUT_DISCONNECT:
+            return event.joystick.number < JOYSTICK_DEVICE_COUNT;
+    }
+
+    return false;
+}
+
+// true if frame interval could be used by game, game clocks can't take
+// huge or negative time steps
+static bool ValidInterval(float interval, float min, float max)
+{
+    return std::isfinite(interval) && interval >= min && interval <= max;
+}
+
+
+// applies state change carried by event to input state, used by sources
+// which produce events without real devices
+static void ApplyEvent(Input &input, const InputEvent &event)
+{
+    switch (event.type) {
+        case INPUT_MOUSE_MOVE:
+            input.mouse.x = event.mouse.x;
+            input.mouse.y = event.mouse.y;
+            break;
+
+        case INPUT_MOUSE_DOWN:
+            input.mouse.buttons |= 1 << event.mouse.button;
+            break;
+
+        case INPUT_MOUSE_UP:
+            input.mouse.buttons &= ~(1 << event.mouse.button);
+            break;
+
+        case INPUT_KEY_DOWN:
+            input.keyboard.keys[event.keyboard.key] = 1;
+            break;
+
+        case INPUT_KEY_UP:
+            input.keyboard.keys[event.keyboard.key] = 0;
+            break;
+
+        case INPUT_BUTTON_DOWN:
+            input.joystick[event.joystick.number].buttons |= 1 << event.joystick.button;
+            break;
+
+        case INPUT_BUTTON_UP:
+            input.joystick[event.joystick.number].buttons &= ~(1 << event.joystick.button);
+            break;
+
+        case INPUT_AXIS:
+            input.joystick[event.joystick.number].axes[event.joystick.axis.axis] = event.joystick.axis.value;
+            break;
+
+        case INPUT_POV:
+            input.joystick[event.joystick.number].povs[event.joystick.pov.pov] = event.joystick.pov.value;
+            break;
+
+        case INPUT_DISCONNECT: {
+            InputJoystickState empty = {};
+            input.joystick[event.joystick.number] = empty;
+            break;
+        }
+    }
+}
+
+// adds event to input and applies it to input state
+static void PushEvent(Input &input, const InputEvent &event)
+{
+    if (InputEvent *newevent = new_event(input, event.time)) {
+        *newevent = event;
+    }
+
+    ApplyEvent(input, event);
+}
+
+
+// scripted key events
+
+struct ScriptEvent
+{
+    int      frame;
+    bool     down;
+    InputKey key;
+};
+
+struct ScriptKeyName
+{
+    const char *name;
+    InputKey    key;
+};
+
+static const ScriptKeyName SCRIPT_KEYS[] = {
+    { "LEFT",   KEY_LEFT },
+    { "RIGHT",  KEY_RIGHT },
+    { "UP",     KEY_UP },
+    { "DOWN",   KEY_DOWN },
+    { "SPACE",  KEY_SPACE },
+    { "ESCAPE", KEY_ESCAPE },
+    { "ENTER",  KEY_RETURN },
+    { "C",      KEY_C },
+    { "P",      KEY_P }
+};
+
+class ScriptInput : public InputSource
+{
+public:
+    ScriptInput() :
+        p_events(nullptr),
+        p_count(0),
+        p_next(0),
+        p_frame(0)
+    {}
+
+    ~ScriptInput()
+    {
+        delete[] p_events;
+    }
+
+    // loads whole script, script is small, so just read it twice:
+    // count lines and parse them
+    bool Load(const char *filename)
+    {
+        delete[] p_events;
+        p_events = nullptr;
+        p_count = 0;
+        p_next = 0;
+        p_frame = 0;
+
+        FILE *file = fopen(filename, "r");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't open input script \"%s\"\n", filename);
+            return false;
+        }
+
+        int capacity = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            ++capacity;
+        }
+
+        p_events = new ScriptEvent[capacity > 0 ? capacity : 1];
+        int linenumber = 0;
+
+        rewind(file);
+        while (fgets(line, sizeof(line), file)) {
+            ++linenumber;
+
+            int frame;
+            char action[16];
+            char keyname[32];
+            if (line[0] == '#' || sscanf(line, "%d %15s %31s", &frame, action, keyname) != 3) {
+                continue;
+            }
+
+            ScriptEvent &event = p_events[p_count];
+            event.frame = frame;
+            event.down = strcmp(action, "down") == 0;
+
+            bool valid =
+                (event.down || strcmp(action, "up") == 0) &&
+                ParseKey(keyname, event.key) &&
+                (p_count == 0 || p_events[p_count - 1].frame <= frame);
+
+            if (!valid) {
+                fprintf(stderr, "%s:%d: invalid script line\n", filename, linenumber);
+                fclose(file);
+                p_count = 0;
+                return false;
+            }
+
+            ++p_count;
+        }
+
+        fclose(file);
+        return true;
+    }
+
+    // script just ends, game goes on without input
+    bool NextFrame(Input &input, uint32_t time, float &) override
+    {
+        ++p_frame;
+        while (p_next < p_count && p_events[p_next].frame <= p_frame) {
+            const ScriptEvent &scripted = p_events[p_next++];
+
+            InputEvent event = {};
+            event.type = scripted.down ? INPUT_KEY_DOWN : INPUT_KEY_UP;
+            event.time = time;
+            event.keyboard.key = scripted.key;
+            PushEvent(input, event);
+        }
+
+        return true;
+    }
+
+private:
+    ScriptInput(const ScriptInput&);
+    ScriptInput &operator=(const ScriptInput&);
+
+    static bool ParseKey(const char *name, InputKey &key)
+    {
+        for (size_t n = 0; n < sizeof(SCRIPT_KEYS) / sizeof(SCRIPT_KEYS[0]); ++n) {
+            if (strcmp(SCRIPT_KEYS[n].name, name) == 0) {
+                key = SCRIPT_KEYS[n].key;
+                return true;
+            }
+        }
+
+        char *end = nullptr;
+        long code = strtol(name, &end, 0);
+        if (end != name && *end == 0 && code > 0 && code < KEY_COUNT) {
+            key = InputKey(code);
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    ScriptEvent *p_events;
+    int          p_count;
+    int          p_next;
+    int          p_frame;
+};
+
+
+// recorded input
+
+struct ReplayHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t seed;     // game seed
+};
+
+struct ReplayFrame
+{
+    float    interval; // frame time interval in seconds
+    uint32_t count;    // number of events following frame
+};
+
+static const char     REPLAY_MAGIC[4] = { 'T', 'F', 'S', 'R' };
+static const uint32_t REPLAY_VERSION = 1;
+
+// frame intervals are fine for any real platform by default, the longest
+// is what game could take after long stall
+static const float REPLAY_MIN_INTERVAL = 0;
+static const float REPLAY_MAX_INTERVAL = 60;
+
+class ReplayInput : public InputSource
+{
+public:
+    ReplayInput() :
+        p_file(nullptr),
+        p_seed(0),
+        p_min_interval(REPLAY_MIN_INTERVAL),
+        p_max_interval(REPLAY_MAX_INTERVAL),
+        p_broken(false)
+    {}
+
+    ~ReplayInput()
+    {
+        Close();
+    }
+
+    bool Open(const char *filename)
+    {
+        Close();
+        p_broken = false;
+
+        p_file = fopen(filename, "rb");
+        if (p_file == nullptr) {
+            fprintf(stderr, "Couldn't open replay \"%s\"\n", filename);
+            return false;
+        }
+
+        ReplayHeader header;
+        if (fread(&header, sizeof(header), 1, p_file) != 1 ||
+            memcmp(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 ||
+            header.version != REPLAY_VERSION)
+        {
+            fprintf(stderr, "\"%s\" isn't a replay file\n", filename);
+            Close();
+            return false;
+        }
+
+        p_seed = header.seed;
+        return true;
+    }
+
+    void Close()
+    {
+        if (p_file) {
+            fclose(p_file);
+            p_file = nullptr;
+        }
+    }
+
+    // frames with intervals outside of given range make replay broken
+    void LimitIntervals(float min, float max)
+    {
+        p_min_interval = min;
+        p_max_interval = max;
+    }
+
+    // events keep their recorded time
+    // replay ends at end of file, or at first bad or cut off frame, whole
+    // frame is checked before anything goes to input
+    bool NextFrame(Input &input, uint32_t, float &interval) override
+    {
+        if (p_file == nullptr || p_broken) {
+            return false;
+        }
+
+        ReplayFrame frame;
+        size_t read = fread(&frame, 1, sizeof(frame), p_file);
+        if (read != sizeof(frame)) {
+            p_broken = read != 0;
+            return false;
+        }
+
+        if (!ValidInterval(frame.interval, p_min_interval, p_max_interval) || frame.count > INPUT_EVENT_COUNT) {
+            p_broken = true;
+            return false;
+        }
+
+        InputEvent events[INPUT_EVENT_COUNT];
+        if (frame.count > 0 && fread(events, sizeof(InputEvent), frame.count, p_file) != frame.count) {
+            p_broken = true;
+            return false;
+        }
+        for (uint32_t n = 0; n < frame.count; ++n) {
+            if (!ValidEvent(events[n])) {
+                p_broken = true;
+                return false;
+            }
+        }
+
+        interval = frame.interval;
+        for (uint32_t n = 0; n < frame.count; ++n) {
+            PushEvent(input, events[n]);
+        }
+
+        return true;
+    }
+
+    // seed of recorded game, game should be started with it
+    uint64_t seed() const { return p_seed; }
+
+    // replay ended on bad or cut off frame
+    bool broken() const { return p_broken; }
+
+private:
+    ReplayInput(const ReplayInput&);
+    ReplayInput &operator=(const ReplayInput&);
+
+    FILE     *p_file;
+    uint64_t  p_seed;
+    float     p_min_interval;
+    float     p_max_interval;
+    bool      p_broken;
+};
+
+class RecordingInput : public InputSource
+{
+public:
+    RecordingInput(InputSource &source) :
+        p_source(source),
+        p_file(nullptr)
+    {}
+
+    ~RecordingInput()
+    {
+        Close();
+    }
+
+    // seed is the one game was started with
+    bool Open(const char *filename, uint64_t seed)
+    {
+        Close();
+
+        p_file = fopen(filename, "wb");
+        if (p_file == nullptr) {
+            fprintf(stderr, "Couldn't create replay \"%s\"\n", filename);
+            return false;
+        }
+
+        ReplayHeader header = {};
+        memcpy(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+        header.version = REPLAY_VERSION;
+        header.seed = seed;
+        fwrite(&header, sizeof(header), 1, p_file);
+
+        return true;
+    }
+
+    void Close()
+    {
+        if (p_file) {
+            fclose(p_file);
+            p_file = nullptr;
+        }
+    }
+
+    bool NextFrame(Input &input, uint32_t time, float &interval) override
+    {
+        if (!p_source.NextFrame(input, time, interval)) {
+            return false;
+        }
+
+        // events dropped because of full events array aren't seen by game
+        // either, so they're not recorded
+        if (p_file) {
+            ReplayFrame frame = { interval, uint32_t(input.event_count) };
+            fwrite(&frame, sizeof(frame), 1, p_file);
+            fwrite(input.events, sizeof(InputEvent), input.event_count, p_file);
+        }
+
+        return true;
+    }
+
+private:
+    RecordingInput(const RecordingInput&);
+    RecordingInput &operator=(const RecordingInput&);
+
+    InputSource &p_source;
+    FILE        *p_file;
+};
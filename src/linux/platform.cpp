@@ -0,0 +1,920 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// linux platform host
+// window and OpenGL context are made with X11/GLX, game itself is loaded
+// from shared library (see module.cpp) and is reloaded every time library
+// file changes, game state memory is kept across reloads, so game goes on
+// with new code right away
+//
+// unlike other platforms host is built on its own, without game code:
+//     c++ -O2 -Iinclude -Isrc src/linux/platform.cpp -o tetris -ldl -lX11 -lGL -lpthread
+//     c++ -O2 -shared -fPIC -DGAME_MODULE -Iinclude -Isrc src/tetris.cpp -o tetris_game.so
+//
+// usage:
+//     tetris [options]
+//         -module FILE   game module (default ./tetris_game.so)
+//         -seed N        game seed (default is current time)
+//         -fps N         frame rate (default 60)
+//         -script FILE   scripted key events
+//         -replay FILE   recorded input, game is started with recorded seed
+//         -record FILE   record input into replay file
+//         -audio FILE    write audio into .wav file, by default audio is mixed
+//                        and dropped (there's no sound device output yet)
+//         -renderer NAME legacy (default) or core, core profile renderer
+//                        falls back to legacy one if context can't do it
+//         -frames N      quit after N rendered frames
+//         -screenshot FILE
+//                        with -frames, write last frame into .ppm file, so
+//                        renderer can be checked without anyone watching, e.g.
+//                        -script run under Xvfb with Mesa's software rasterizer
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <climits>
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <GL/gl.h>
+#include <GL/glx.h>
+#include "platform/platform.h"
+#include "platform/module.h"
+
+
+// common engine functions and implementation
+#include "engine.cpp"
+#include "opengl.cpp"
+#include "openglcore.cpp"
+#include "inputsource.cpp"
+#include "audio.cpp"
+
+
+// monotonic time in microseconds
+static uint64_t Microseconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000 + uint64_t(now.tv_nsec) / 1000;
+}
+
+
+// platform API implementation
+class LinuxPlatform : public PlatformAPI
+{
+public:
+    LinuxPlatform() :
+        p_quit(false)
+    {}
+
+    void Quit() override
+    {
+        p_quit = true;
+    }
+
+    void DEBUGPrint(const char *format, ...) override
+    {
+        va_list va;
+        va_start(va, format);
+        vfprintf(stderr, format, va);
+        va_end(va);
+    }
+
+    bool quit() const { return p_quit; }
+
+private:
+    bool p_quit;
+};
+
+
+// game module loading
+
+class ModuleLoader
+{
+public:
+    ModuleLoader() :
+        p_handle(nullptr),
+        p_module(nullptr),
+        p_stamp(0),
+        p_pending(0),
+        p_copies(0)
+    {}
+
+    ~ModuleLoader()
+    {
+        Unload();
+    }
+
+    // loads module, previous module stays loaded if new one couldn't be loaded
+    bool Load(const char *path)
+    {
+        // same file isn't tried again until it changes
+        p_stamp = FileStamp(path);
+        p_pending = 0;
+
+        // library is loaded from a copy: build could overwrite original file
+        // any moment and dlopen() of the same path would just return library
+        // which is already loaded
+        char copy[PATH_MAX];
+        snprintf(copy, sizeof(copy), "/tmp/tetris_game_%d_%u.so", int(getpid()), p_copies++);
+        if (!CopyFile(path, copy)) {
+            fprintf(stderr, "Couldn't copy game module \"%s\"\n", path);
+            return false;
+        }
+
+        void *handle = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+        unlink(copy);
+        if (handle == nullptr) {
+            fprintf(stderr, "Couldn't load game module: %s\n", dlerror());
+            return false;
+        }
+
+        GetGameModuleFunction getmodule = reinterpret_cast<GetGameModuleFunction>(
+            dlsym(handle, GAME_MODULE_ENTRY)
+        );
+        const GameModule *module = getmodule ? getmodule() : nullptr;
+        if (module == nullptr || module->version != GAME_MODULE_VERSION) {
+            fprintf(stderr, "\"%s\" isn't compatible game module\n", path);
+            dlclose(handle);
+            return false;
+        }
+
+        Unload();
+        p_handle = handle;
+        p_module = module;
+        return true;
+    }
+
+    void Unload()
+    {
+        if (p_handle) {
+            dlclose(p_handle);
+            p_handle = nullptr;
+            p_module = nullptr;
+        }
+    }
+
+    // checks if module file was rebuilt, file should stay the same for two
+    // checks in a row, so library which is being written isn't loaded
+    bool Changed(const char *path)
+    {
+        uint64_t stamp = FileStamp(path);
+        if (stamp == 0 || stamp == p_stamp) {
+            p_pending = 0;
+            return false;
+        }
+
+        bool stable = stamp == p_pending;
+        p_pending = stamp;
+        return stable;
+    }
+
+    const GameModule *module() const { return p_module; }
+
+private:
+    ModuleLoader(const ModuleLoader&);
+    ModuleLoader &operator=(const ModuleLoader&);
+
+    // modification time and size of file mixed together, 0 if there's no file
+    static uint64_t FileStamp(const char *path)
+    {
+        struct stat info;
+        if (stat(path, &info) != 0) {
+            return 0;
+        }
+
+        uint64_t time = uint64_t(info.st_mtim.tv_sec) * 1000000000 + uint64_t(info.st_mtim.tv_nsec);
+        return (time ^ uint64_t(info.st_size) << 40) | 1;
+    }
+
+    static bool CopyFile(const char *from, const char *to)
+    {
+        FILE *source = fopen(from, "rb");
+        if (source == nullptr) {
+            return false;
+        }
+
+        FILE *target = fopen(to, "wb");
+        if (target == nullptr) {
+            fclose(source);
+            return false;
+        }
+
+        bool result = true;
+        char buffer[65536];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+            result = result && fwrite(buffer, 1, size, target) == size;
+        }
+
+        fclose(source);
+        result = fclose(target) == 0 && result;
+        return result;
+    }
+
+private:
+    void             *p_handle;
+    const GameModule *p_module;
+    uint64_t          p_stamp;   // file stamp of last load attempt
+    uint64_t          p_pending; // file stamp of changed file seen last check
+    unsigned          p_copies;
+};
+
+
+// input from X11 window: keyboard and mouse
+
+struct KeySymMapping
+{
+    KeySym   sym;
+    InputKey key;
+};
+
+static const KeySymMapping KEY_SYMS[] = {
+    { XK_BackSpace, KEY_BACK },
+    { XK_Tab,       KEY_TAB },
+    { XK_Return,    KEY_RETURN },
+    { XK_Pause,     KEY_PAUSE },
+    { XK_Escape,    KEY_ESCAPE },
+    { XK_space,     KEY_SPACE },
+    { XK_Prior,     KEY_PRIOR },
+    { XK_Next,      KEY_NEXT },
+    { XK_End,       KEY_END },
+    { XK_Home,      KEY_HOME },
+    { XK_Left,      KEY_LEFT },
+    { XK_Up,        KEY_UP },
+    { XK_Right,     KEY_RIGHT },
+    { XK_Down,      KEY_DOWN },
+    { XK_Insert,    KEY_INSERT },
+    { XK_Delete,    KEY_DELETE },
+    { XK_Shift_L,   KEY_LSHIFT },
+    { XK_Shift_R,   KEY_RSHIFT },
+    { XK_Control_L, KEY_LCONTROL },
+    { XK_Control_R, KEY_RCONTROL },
+    { XK_Alt_L,     KEY_LALT },
+    { XK_Alt_R,     KEY_RALT }
+};
+
+static InputKey TranslateKey(KeySym sym)
+{
+    if (sym >= XK_a && sym <= XK_z) {
+        return InputKey(KEY_A + (sym - XK_a));
+    }
+    if (sym >= XK_0 && sym <= XK_9) {
+        return InputKey(KEY_0 + (sym - XK_0));
+    }
+    if (sym >= XK_F1 && sym <= XK_F12) {
+        return InputKey(KEY_F1 + (sym - XK_F1));
+    }
+
+    for (size_t n = 0; n < sizeof(KEY_SYMS) / sizeof(KEY_SYMS[0]); ++n) {
+        if (KEY_SYMS[n].sym == sym) {
+            return KEY_SYMS[n].key;
+        }
+    }
+
+    return InputKey(0);
+}
+
+class X11Input : public InputSource
+{
+public:
+    X11Input(Display *display, Window window) :
+        p_display(display),
+        p_window(window),
+        p_width(0),
+        p_height(0),
+        p_mapped(true),
+        p_focused(true),
+        p_exposed(false)
+    {
+        p_delete = XInternAtom(display, "WM_DELETE_WINDOW", False);
+        XSetWMProtocols(display, window, &p_delete, 1);
+
+        // held key gives only repeated presses, without release before each
+        // one, game does its own repeat and ignores them
+        XkbSetDetectableAutoRepeat(display, True, nullptr);
+
+        XWindowAttributes attributes;
+        if (XGetWindowAttributes(display, window, &attributes)) {
+            p_width = attributes.width;
+            p_height = attributes.height;
+        }
+    }
+
+    // returns false when window is closed
+    bool NextFrame(Input &input, uint32_t, float &) override
+    {
+        bool running = true;
+
+        while (XPending(p_display)) {
+            XEvent xevent;
+            XNextEvent(p_display, &xevent);
+
+            switch (xevent.type) {
+                case ClientMessage:
+                    if (Atom(xevent.xclient.data.l[0]) == p_delete) {
+                        running = false;
+                    }
+                    break;
+
+                case ConfigureNotify:
+                    p_width = xevent.xconfigure.width;
+                    p_height = xevent.xconfigure.height;
+                    break;
+
+                // window is unmapped when minimized
+                case MapNotify:
+                    p_mapped = true;
+                    p_exposed = true;
+                    break;
+
+                case UnmapNotify:
+                    p_mapped = false;
+                    break;
+
+                case FocusIn:
+                case FocusOut:
+                    p_focused = xevent.type == FocusIn;
+                    break;
+
+                case Expose:
+                    p_exposed = true;
+                    break;
+
+                case KeyPress:
+                case KeyRelease: {
+                    InputKey key = TranslateKey(XLookupKeysym(&xevent.xkey, 0));
+                    if (key != 0) {
+                        InputEvent event = {};
+                        event.type = xevent.type == KeyPress ? INPUT_KEY_DOWN : INPUT_KEY_UP;
+                        event.time = uint32_t(xevent.xkey.time);
+                        event.keyboard.key = key;
+                        PushEvent(input, event);
+                    }
+                    break;
+                }
+
+                case ButtonPress:
+                case ButtonRelease: {
+                    InputEvent event = {};
+                    event.time = uint32_t(xevent.xbutton.time);
+                    event.mouse.x = xevent.xbutton.x;
+                    event.mouse.y = xevent.xbutton.y;
+                    event.mouse.button = MOUSE_BUTTON_COUNT;
+
+                    // buttons 4 and 5 are wheel
+                    if (xevent.xbutton.button == Button4 || xevent.xbutton.button == Button5) {
+                        if (xevent.type == ButtonPress) {
+                            event.type = INPUT_MOUSE_WHEEL;
+                            event.mouse.wheel = xevent.xbutton.button == Button4 ? 1 : -1;
+                            PushEvent(input, event);
+                        }
+                        break;
+                    }
+
+                    if (xevent.xbutton.button == Button1) {
+                        event.mouse.button = MOUSE_BUTTON_LEFT;
+                    } else if (xevent.xbutton.button == Button3) {
+                        event.mouse.button = MOUSE_BUTTON_RIGHT;
+                    } else {
+                        break;
+                    }
+
+                    event.type = xevent.type == ButtonPress ? INPUT_MOUSE_DOWN : INPUT_MOUSE_UP;
+                    PushEvent(input, event);
+                    break;
+                }
+
+                case MotionNotify: {
+                    InputEvent event = {};
+                    event.type = INPUT_MOUSE_MOVE;
+                    event.time = uint32_t(xevent.xmotion.time);
+                    event.mouse.x = xevent.xmotion.x;
+                    event.mouse.y = xevent.xmotion.y;
+                    event.mouse.button = MOUSE_BUTTON_COUNT;
+                    PushEvent(input, event);
+                    break;
+                }
+            }
+        }
+
+        return running;
+    }
+
+    int width() const { return p_width; }
+    int height() const { return p_height; }
+    bool mapped() const { return p_mapped; }
+    bool focused() const { return p_focused; }
+
+    // window contents were lost since last call and should be rendered
+    // even if nothing changed
+    bool TakeExposed()
+    {
+        bool exposed = p_exposed;
+        p_exposed = false;
+        return exposed;
+    }
+
+private:
+    X11Input(const X11Input&);
+    X11Input &operator=(const X11Input&);
+
+    Display *p_display;
+    Window   p_window;
+    Atom     p_delete;
+    int      p_width;
+    int      p_height;
+    bool     p_mapped;
+    bool     p_focused;
+    bool     p_exposed;
+};
+
+
+// looks for "-name value" option in command line, returns nullptr if
+// there's no such option
+static const char *CommandLineOption(int argc, char **argv, const char *name)
+{
+    for (int arg = 1; arg + 1 < argc; ++arg) {
+        if (strcmp(argv[arg], name) == 0) {
+            return argv[arg + 1];
+        }
+    }
+    return nullptr;
+}
+
+// blocks main loop until X server sends something or timeout (in
+// milliseconds) passes, used when there's nothing to update and render
+// events already read by Xlib are never in the socket, so they're checked first
+static void WaitForInput(Display *display, int timeout)
+{
+    XFlush(display);
+    if (XPending(display)) {
+        return;
+    }
+
+    pollfd connection = {};
+    connection.fd = ConnectionNumber(display);
+    connection.events = POLLIN;
+    poll(&connection, 1, timeout);
+}
+
+static int IgnoreXError(Display*, XErrorEvent*)
+{
+    return 0;
+}
+
+// back buffer into binary .ppm, rows are flipped since OpenGL's origin is
+// at bottom left
+static void WriteScreenshot(const char *filename, int width, int height)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Couldn't write screenshot \"%s\"\n", filename);
+        return;
+    }
+
+    size_t pitch = size_t(width) * 3;
+    uint8_t *pixels = new uint8_t[pitch * height];
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; --y) {
+        fwrite(pixels + pitch * y, 1, pitch, file);
+    }
+
+    delete[] pixels;
+    fclose(file);
+}
+
+// complete game frame render, screenshot is taken before swap if asked
+static void RenderGameFrame(OpenGLRenderer &graphics, Display *display, Window window, int width, int height, const GameModule *module, void *state, const char *screenshot)
+{
+    graphics.BeginFrame(width, height);
+
+    if (width && height) {
+        module->render(state, &graphics, width, height);
+        graphics.EndFrame();
+
+        if (screenshot) {
+            WriteScreenshot(screenshot, width, height);
+        }
+
+        glXSwapBuffers(display, window);
+    }
+}
+
+
+// OpenGL functions for core profile renderer
+static void *GLXProcAddress(const char *name)
+{
+    return reinterpret_cast<void*>(glXGetProcAddressARB(reinterpret_cast<const GLubyte*>(name)));
+}
+
+// core profile context through GLX_ARB_create_context, returns nullptr if
+// there's no such extension or context can't be made
+static GLXContext CreateCoreContext(Display *display, GLXFBConfig config)
+{
+    typedef GLXContext (*CreateContextAttribsFunction)(Display*, GLXFBConfig, GLXContext, Bool, const int*);
+    CreateContextAttribsFunction createcontext = reinterpret_cast<CreateContextAttribsFunction>(
+        GLXProcAddress("glXCreateContextAttribsARB")
+    );
+    if (createcontext == nullptr) {
+        return nullptr;
+    }
+
+    int attributes[] = {
+        GLX_CONTEXT_MAJOR_VERSION_ARB, 3,
+        GLX_CONTEXT_MINOR_VERSION_ARB, 3,
+        GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+        None
+    };
+
+    // failed context creation is reported through X error, which would
+    // end the program with default handler
+    XErrorHandler handler = XSetErrorHandler(IgnoreXError);
+    GLXContext context = createcontext(display, config, nullptr, True, attributes);
+    XSync(display, False);
+    XSetErrorHandler(handler);
+
+    return context;
+}
+
+
+// checks for whole name in space separated extension list
+static bool HasExtension(const char *extensions, const char *name)
+{
+    size_t length = strlen(name);
+    for (const char *found = extensions; found && (found = strstr(found, name)); found += length) {
+        bool start = found == extensions || found[-1] == ' ';
+        bool end = found[length] == ' ' || found[length] == 0;
+        if (start && end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// frames are paced by FramePacer, so driver vsync, which is usually on by
+// default, would only make glXSwapBuffers() wait on top of that, it's
+// turned off through GLX_EXT_swap_control or GLX_MESA_swap_control,
+// glXGetProcAddressARB() gives something for any name, so extension list is
+// checked first, returns false if there's no way to turn vsync off,
+// context should be current
+static bool DisableVSync(Display *display, Window window)
+{
+    const char *extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+
+    if (HasExtension(extensions, "GLX_EXT_swap_control")) {
+        typedef void (*SwapIntervalFunction)(Display*, GLXDrawable, int);
+        SwapIntervalFunction swapinterval = reinterpret_cast<SwapIntervalFunction>(
+            GLXProcAddress("glXSwapIntervalEXT")
+        );
+        if (swapinterval) {
+            swapinterval(display, window, 0);
+            return true;
+        }
+    }
+
+    if (HasExtension(extensions, "GLX_MESA_swap_control")) {
+        typedef int (*SwapIntervalFunction)(unsigned int);
+        SwapIntervalFunction swapinterval = reinterpret_cast<SwapIntervalFunction>(
+            GLXProcAddress("glXSwapIntervalMESA")
+        );
+        return swapinterval && swapinterval(0) == 0;
+    }
+
+    return false;
+}
+
+
+// main entry point function, program execution starts here
+int main(int argc, char **argv)
+{
+    // initialization error flag
+    bool initerror = false;
+
+    const char *modulepath = CommandLineOption(argc, argv, "-module");
+    if (modulepath == nullptr) {
+        modulepath = "./tetris_game.so";
+    }
+
+    ModuleLoader loader;
+    Display *display = nullptr;
+    Window window = 0;
+    Colormap colormap = 0;
+    GLXContext glrc = nullptr;
+    OpenGLCoreAPI coregl;
+    const char *renderer = CommandLineOption(argc, argv, "-renderer");
+    bool corerenderer = renderer && strcmp(renderer, "core") == 0;
+
+    // this is "loop trick"
+    // if some initialization step failed - just break to skip other parts
+    for (;;) {
+        if (!loader.Load(modulepath)) {
+            initerror = true;
+            break;
+        }
+
+        display = XOpenDisplay(nullptr);
+        if (display == nullptr) {
+            fprintf(stderr, "Couldn't open X display!\n");
+            initerror = true;
+            break;
+        }
+
+        // core profile context is made from framebuffer config, same double
+        // buffered RGBA as legacy one
+        GLXFBConfig *configs = nullptr;
+        XVisualInfo *visual = nullptr;
+        if (corerenderer) {
+            int configattributes[] = {
+                GLX_X_RENDERABLE, True, GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
+                GLX_RENDER_TYPE, GLX_RGBA_BIT, GLX_DOUBLEBUFFER, True,
+                GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None
+            };
+            int count = 0;
+            configs = glXChooseFBConfig(display, DefaultScreen(display), configattributes, &count);
+            if (configs && count > 0) {
+                visual = glXGetVisualFromFBConfig(display, configs[0]);
+            }
+        }
+
+        // use plain double buffered RGBA visual, same as on windows
+        if (visual == nullptr) {
+            int attributes[] = { GLX_RGBA, GLX_DOUBLEBUFFER, GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None };
+            visual = glXChooseVisual(display, DefaultScreen(display), attributes);
+        }
+        if (visual == nullptr) {
+            fprintf(stderr, "Couldn't obtain OpenGL visual!\n");
+            initerror = true;
+            break;
+        }
+
+        Window root = RootWindow(display, visual->screen);
+        colormap = XCreateColormap(display, root, visual->visual, AllocNone);
+
+        XSetWindowAttributes windowattributes = {};
+        windowattributes.colormap = colormap;
+        windowattributes.event_mask =
+            KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask |
+            PointerMotionMask | StructureNotifyMask | ExposureMask | FocusChangeMask;
+
+        window = XCreateWindow(
+            display, root, 0, 0, 800, 600, 0, visual->depth, InputOutput,
+            visual->visual, CWColormap | CWEventMask, &windowattributes
+        );
+        XStoreName(display, window, "Tetris from scratch");
+
+        if (configs && visual) {
+            glrc = CreateCoreContext(display, configs[0]);
+            if (glrc) {
+                glXMakeCurrent(display, window, glrc);
+                if (!coregl.Initialize(GLXProcAddress)) {
+                    fprintf(stderr, "Couldn't set up core profile renderer (%s)\n", coregl.log());
+                    glXMakeCurrent(display, None, nullptr);
+                    glXDestroyContext(display, glrc);
+                    glrc = nullptr;
+                }
+            }
+        }
+        if (configs) {
+            XFree(configs);
+        }
+
+        // legacy renderer works with any context
+        if (glrc == nullptr) {
+            if (corerenderer) {
+                fprintf(stderr, "Core profile renderer isn't available, using legacy one\n");
+                corerenderer = false;
+            }
+            glrc = glXCreateContext(display, visual, nullptr, True);
+        }
+        XFree(visual);
+        if (glrc == nullptr) {
+            fprintf(stderr, "Couldn't create OpenGL context!\n");
+            initerror = true;
+            break;
+        }
+        glXMakeCurrent(display, window, glrc);
+
+        if (!DisableVSync(display, window)) {
+            fprintf(stderr, "Couldn't turn off vsync, frames are limited to display refresh rate\n");
+        }
+
+        // not to repeat forever loop
+        break;
+    }
+
+    if (!initerror) {
+        XMapWindow(display, window);
+
+        LinuxPlatform api;
+        OpenGLAPI legacygl;
+        OpenGLRenderer *graphics = corerenderer ? static_cast<OpenGLRenderer*>(&coregl) : &legacygl;
+        X11Input hardware(display, window);
+        ScriptInput script;
+        ReplayInput replay;
+
+        InputSource *source = &hardware;
+        uint64_t seed = uint64_t(time(nullptr));
+        if (const char *option = CommandLineOption(argc, argv, "-seed")) {
+            seed = strtoull(option, nullptr, 0);
+        }
+        if (const char *option = CommandLineOption(argc, argv, "-script")) {
+            if (script.Load(option)) {
+                source = &script;
+            }
+        } else if (const char *option = CommandLineOption(argc, argv, "-replay")) {
+            if (replay.Open(option)) {
+                seed = replay.seed();
+                source = &replay;
+            }
+        }
+        bool synthetic = source != &hardware;
+
+        RecordingInput recording(*source);
+        if (const char *option = CommandLineOption(argc, argv, "-record")) {
+            if (recording.Open(option, seed)) {
+                source = &recording;
+            }
+        }
+
+        // game state block is kept for whole run, module only works with it
+        const GameModule *module = loader.module();
+        size_t statesize = module->state_size;
+        uint8_t *state = new uint8_t[statesize];
+        module->init(state, seed);
+
+        // audio is mixed on its own thread, without device it goes to file
+        // or nowhere, but still in real time
+        AudioMixer mixer;
+        NullAudioOutput nullaudio;
+        WavFileAudioOutput fileaudio(true);
+        AudioOutput *audiooutput = &nullaudio;
+        if (const char *option = CommandLineOption(argc, argv, "-audio")) {
+            if (fileaudio.Open(option)) {
+                audiooutput = &fileaudio;
+            }
+        }
+        AudioThread audiothread(mixer, *audiooutput);
+        module->load_audio(state, &mixer);
+        audiothread.Start();
+
+        int framerate = 60;
+        if (const char *option = CommandLineOption(argc, argv, "-fps")) {
+            framerate = atoi(option) > 0 ? atoi(option) : framerate;
+        }
+
+        uint64_t framelimit = 0;
+        if (const char *option = CommandLineOption(argc, argv, "-frames")) {
+            framelimit = strtoull(option, nullptr, 10);
+        }
+        uint64_t frames = 0;
+        const char *screenshot = CommandLineOption(argc, argv, "-screenshot");
+
+        Input input = {};
+        Input hardwareinput = {};
+
+        uint64_t starttime = Microseconds();
+        uint64_t lasttime = starttime;
+        uint64_t lastcheck = starttime;
+        FramePacer pacer;
+        pacer.Start(0, 1000000 / framerate);
+
+        // game is paused once when window goes to background, player resumes it
+        bool background = false;
+
+        bool running = true;
+        while (running && !api.quit()) {
+            uint64_t currenttime = Microseconds();
+            float interval = float(currenttime - lasttime) / 1000000.0f;
+            uint32_t time = uint32_t(currenttime / 1000);
+            lasttime = currenttime;
+
+            // check for new game module few times a second
+            if (currenttime - lastcheck > 250000) {
+                lastcheck = currenttime;
+
+                uint64_t layout = module->state_layout;
+                if (loader.Changed(modulepath) && loader.Load(modulepath)) {
+                    module = loader.module();
+
+                    if (module->state_layout == layout) {
+                        module->reload(state);
+                        fprintf(stderr, "Game module reloaded, game state kept\n");
+                    } else {
+                        // state of old game can't be used, start over
+                        if (module->state_size > statesize) {
+                            delete[] state;
+                            statesize = module->state_size;
+                            state = new uint8_t[statesize];
+                        }
+                        module->init(state, seed);
+                        module->load_audio(state, &mixer);
+                        fprintf(stderr, "Game module reloaded, game state layout changed, game restarted\n");
+                    }
+                }
+            }
+
+            // reset event count, events passed by frame basis
+            input.event_count = 0;
+            input.event_dropped = 0;
+
+            // other input source gets only ESC from real devices to be able to quit
+            if (synthetic) {
+                hardwareinput.event_count = 0;
+                hardwareinput.event_dropped = 0;
+                running = hardware.NextFrame(hardwareinput, time, interval);
+                if (hardwareinput.keyboard.keys[KEY_ESCAPE]) {
+                    api.Quit();
+                }
+            }
+            if (!source->NextFrame(input, time, interval)) {
+                running = false;
+            }
+
+            // scripted and recorded input should play same way regardless of
+            // window state, so only real player's game is paused
+            bool minimized = !hardware.mapped();
+            bool wasbackground = background;
+            background = minimized || !hardware.focused();
+            if (background && !wasbackground && !synthetic) {
+                module->pause(state);
+            }
+
+            module->input(state, &api, &input);
+            module->update(state, interval);
+            module->audio(state, &mixer);
+
+            // paused game is rendered only when something changed
+            bool exposed = hardware.TakeExposed();
+            if (!minimized && (exposed || !module->idle(state))) {
+                bool last = framelimit && ++frames >= framelimit;
+                RenderGameFrame(*graphics, display, window, hardware.width(), hardware.height(), module, state, last ? screenshot : nullptr);
+                running = running && !last;
+            }
+
+            // nothing goes on until player does something, frame schedule
+            // and interval start over after wait, module is still checked
+            // for changes between waits
+            if (!synthetic && (minimized || module->idle(state))) {
+                WaitForInput(display, 250);
+
+                lasttime = Microseconds();
+                pacer.Start(lasttime - starttime, 1000000 / framerate);
+                continue;
+            }
+
+            // wait for next frame time
+            uint64_t frameend = Microseconds();
+            pacer.NextFrame(frameend - starttime);
+            for (;;) {
+                uint64_t now = Microseconds() - starttime;
+                if (pacer.Ready(now)) {
+                    break;
+                }
+
+                if (uint64_t sleep = pacer.SleepTime(now)) {
+                    usleep(useconds_t(sleep));
+                    pacer.Slept(sleep, Microseconds() - starttime - now);
+                }
+            }
+        }
+
+        audiothread.Stop();
+        delete[] state;
+    }
+
+    // clean up OpenGL
+    if (glrc) {
+        glXMakeCurrent(display, None, nullptr);
+        glXDestroyContext(display, glrc);
+    }
+
+    // destroy main window
+    if (window) {
+        XDestroyWindow(display, window);
+    }
+    if (colormap) {
+        XFreeColormap(display, colormap);
+    }
+    if (display) {
+        XCloseDisplay(display);
+    }
+
+    return initerror ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// game module entry point, used instead of platform.cpp when game is built
+// as shared library for a host which loads it at runtime:
+//     c++ -O2 -shared -fPIC -DGAME_MODULE -Iinclude -Isrc src/tetris.cpp -o tetris_game.so
+//
+// state memory block holds Game object first and then all its data
+
+#include <new>
+#include "engine/engine.h"
+#include "platform/module.h"
+
+#if defined(_WIN32)
+#define GAME_MODULE_EXPORT extern "C" __declspec(dllexport)
+#else
+#define GAME_MODULE_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+
+// bump when Game members change without changing its size
+static const uint64_t GAME_STATE_VERSION = 5;
+
+static size_t GameStateSize()
+{
+    return Arena::Align(sizeof(Game)) + Game::MemorySize();
+}
+
+// host supplies aligned block, so Game object is right at its start
+static Game *StateGame(void *state)
+{
+    return reinterpret_cast<Game*>(state);
+}
+
+static void ModuleInit(void *state, uint64_t seed)
+{
+    Arena arena(state, GameStateSize());
+    new (arena.Allocate(sizeof(Game))) Game(arena, seed);
+}
+
+static void ModuleReload(void *state)
+{
+    StateGame(state)->Reloaded();
+}
+
+static void ModuleInput(void *state, PlatformAPI *api, const Input *input)
+{
+    StateGame(state)->ProcessInput(*api, *input);
+}
+
+static void ModuleUpdate(void *state, float interval)
+{
+    StateGame(state)->Update(interval);
+}
+
+static void ModuleRender(void *state, GraphicsAPI *api, int width, int height)
+{
+    StateGame(state)->RenderGraphics(*api, width, height);
+}
+
+static void ModuleLoadAudio(void *state, AudioAPI *api)
+{
+    StateGame(state)->LoadAudio(*api);
+}
+
+static void ModuleAudio(void *state, AudioAPI *api)
+{
+    StateGame(state)->RenderAudio(*api);
+}
+
+static void ModulePause(void *state)
+{
+    StateGame(state)->SetPaused(true);
+}
+
+static int ModuleIdle(void *state)
+{
+    return StateGame(state)->idle() ? 1 : 0;
+}
+
+GAME_MODULE_EXPORT const GameModule *GetGameModule()
+{
+    static const GameModule module = {
+        GAME_MODULE_VERSION,
+        GAME_STATE_VERSION << 48 ^ uint64_t(sizeof(Game)) << 24 ^ uint64_t(Game::MemorySize()),
+        GameStateSize(),
+        ModuleInit,
+        ModuleReload,
+        ModuleInput,
+        ModuleUpdate,
+        ModuleRender,
+        ModuleLoadAudio,
+        ModuleAudio,
+        ModulePause,
+        ModuleIdle
+    };
+    return &module;
+}
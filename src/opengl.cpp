@@ -0,0 +1,300 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// OpenGL implementation of graphics API
+// legacy backend works with any context through fixed function pipeline,
+// core profile backend is in openglcore.cpp
+
+#if defined(_WIN32)
+#include <gl/GL.h>
+#else
+#include <GL/gl.h>
+#endif
+#include "platform/platform.h"
+
+
+// common part of OpenGL backends
+// platform makes context current and then renders every frame between
+// BeginFrame() and EndFrame(), right before swapping buffers
+class OpenGLRenderer : public GraphicsAPI
+{
+public:
+    OpenGLRenderer() :
+        p_rt_width(0),
+        p_rt_height(0)
+    {}
+
+    // sets full window viewport and 2D projection with origin at top left
+    virtual void BeginFrame(int width, int height) = 0;
+
+    // everything rendered is submitted by now
+    virtual void EndFrame() = 0;
+
+    void Viewport(int left, int top, int width, int height) override
+    {
+        // OpenGL's viewport origin is located at bottom left
+        glViewport(left, p_rt_height - top, width, height);
+    }
+
+protected:
+    void GetRenderTargetSize(int &width, int &height) override
+    {
+        width = p_rt_width;
+        height = p_rt_height;
+    }
+
+    void SetRenderTargetSize(int width, int height)
+    {
+        p_rt_width = width;
+        p_rt_height = height;
+        glViewport(0, 0, width, height);
+    }
+
+    // pixel to clip space, column major
+    static void Projection(int width, int height, float *matrix)
+    {
+        for (int n = 0; n < 16; ++n) {
+            matrix[n] = 0;
+        }
+        matrix[0] = 2 / float(width);
+        matrix[5] = -2 / float(height);
+        matrix[10] = 1;
+        matrix[12] = -1;
+        matrix[13] = 1;
+        matrix[15] = 1;
+    }
+
+private:
+    int p_rt_width;
+    int p_rt_height;
+};
+
+
+// since OpenGL is cross-platform by itself - most of GraphicsAPI implemented here
+class OpenGLAPI : public OpenGLRenderer
+{
+public:
+    OpenGLAPI() :
+        p_vertices(nullptr),
+        p_vertex_capacity(0),
+        p_glyph_vertices(nullptr),
+        p_glyph_vertex_capacity(0),
+        p_font_texture(0)
+    {
+        // basic OpenGL set-up
+        glFrontFace(GL_CW);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    ~OpenGLAPI()
+    {
+        delete[] p_vertices;
+        delete[] p_glyph_vertices;
+    }
+
+    void BeginFrame(int width, int height) override
+    {
+        SetRenderTargetSize(width, height);
+        if (width == 0 || height == 0) {
+            return;
+        }
+
+        // set default ortho projection matrix for 2D rendering
+        GLfloat projection[16];
+        Projection(width, height, projection);
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(projection);
+    }
+
+    // every call is drawn right away
+    void EndFrame() override {}
+
+    void Clear(const Color &color) override
+    {
+        const float k = 1.0f / 255.0f;
+        glClearColor(color.r * k, color.g * k, color.b * k, color.a * k);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    void Rectangle(float left, float top, float width, float height, const Color &color) override
+    {
+        // just for test - render with glBegin/glEnd, later this will be changed
+        // to more practical solution
+        glBegin(GL_TRIANGLES);
+
+        glColor4ub(color.r, color.g, color.b, color.a);
+
+        glVertex2f(left, top);
+        glVertex2f(left + width, top);
+        glVertex2f(left, top + height);
+
+        glVertex2f(left + width, top);
+        glVertex2f(left + width, top + height);
+        glVertex2f(left, top + height);
+
+        glEnd();
+    }
+
+    void Rectangles(const ColoredRectangle *rectangles, size_t count) override
+    {
+        // vertex arrays are part of OpenGL 1.1, so this works with any context
+        // vertex storage only grows, so it's allocated just few times at start
+        if (count * 6 > p_vertex_capacity) {
+            delete[] p_vertices;
+            p_vertex_capacity = count * 6;
+            p_vertices = new Vertex[p_vertex_capacity];
+        }
+
+        Vertex *vertex = p_vertices;
+        for (size_t n = 0; n < count; ++n) {
+            const ColoredRectangle &rectangle = rectangles[n];
+            float left = rectangle.left;
+            float top = rectangle.top;
+            float right = left + rectangle.width;
+            float bottom = top + rectangle.height;
+
+            // same triangles as Rectangle() draws
+            vertex[0].x = left;  vertex[0].y = top;
+            vertex[1].x = right; vertex[1].y = top;
+            vertex[2].x = left;  vertex[2].y = bottom;
+            vertex[3].x = right; vertex[3].y = top;
+            vertex[4].x = right; vertex[4].y = bottom;
+            vertex[5].x = left;  vertex[5].y = bottom;
+            for (int v = 0; v < 6; ++v) {
+                vertex[v].color = rectangle.color;
+            }
+            vertex += 6;
+        }
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &p_vertices[0].x);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), &p_vertices[0].color);
+
+        glDrawArrays(GL_TRIANGLES, 0, GLsizei(count * 6));
+
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+
+    void Glyphs(const GlyphQuad *glyphs, size_t count) override
+    {
+        // font atlas is made on first use, when context is surely there
+        if (p_font_texture == 0) {
+            CreateFontTexture();
+        }
+
+        if (count * 6 > p_glyph_vertex_capacity) {
+            delete[] p_glyph_vertices;
+            p_glyph_vertex_capacity = count * 6;
+            p_glyph_vertices = new GlyphVertex[p_glyph_vertex_capacity];
+        }
+
+        const float ku = 1.0f / FONT_ATLAS_WIDTH;
+        const float kv = 1.0f / FONT_ATLAS_HEIGHT;
+
+        GlyphVertex *vertex = p_glyph_vertices;
+        for (size_t n = 0; n < count; ++n) {
+            const GlyphQuad &quad = glyphs[n];
+            float left = quad.left;
+            float top = quad.top;
+            float right = left + quad.width;
+            float bottom = top + quad.height;
+
+            float u0 = (quad.glyph % FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL * ku;
+            float v0 = (quad.glyph / FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL * kv;
+            float u1 = u0 + FONT_GLYPH_WIDTH * ku;
+            float v1 = v0 + FONT_GLYPH_HEIGHT * kv;
+
+            vertex[0].x = left;  vertex[0].y = top;    vertex[0].u = u0; vertex[0].v = v0;
+            vertex[1].x = right; vertex[1].y = top;    vertex[1].u = u1; vertex[1].v = v0;
+            vertex[2].x = left;  vertex[2].y = bottom; vertex[2].u = u0; vertex[2].v = v1;
+            vertex[3].x = right; vertex[3].y = top;    vertex[3].u = u1; vertex[3].v = v0;
+            vertex[4].x = right; vertex[4].y = bottom; vertex[4].u = u1; vertex[4].v = v1;
+            vertex[5].x = left;  vertex[5].y = bottom; vertex[5].u = u0; vertex[5].v = v1;
+            for (int v = 0; v < 6; ++v) {
+                vertex[v].color = quad.color;
+            }
+            vertex += 6;
+        }
+
+        // alpha texture modulated by vertex color gives colored glyph pixels
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, p_font_texture);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(GlyphVertex), &p_glyph_vertices[0].x);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(GlyphVertex), &p_glyph_vertices[0].u);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(GlyphVertex), &p_glyph_vertices[0].color);
+
+        glDrawArrays(GL_TRIANGLES, 0, GLsizei(count * 6));
+
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisable(GL_TEXTURE_2D);
+    }
+
+private:
+    struct Vertex
+    {
+        float x;
+        float y;
+        Color color;
+    };
+
+    struct GlyphVertex
+    {
+        float x;
+        float y;
+        float u;
+        float v;
+        Color color;
+    };
+
+    // font atlas as alpha texture, glyph pixels are opaque
+    void CreateFontTexture()
+    {
+        static uint8_t atlas[FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT];
+        for (int n = 0; n < FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT; ++n) {
+            atlas[n] = 0;
+        }
+
+        for (int glyph = 0; glyph < FONT_GLYPH_COUNT; ++glyph) {
+            int cellx = (glyph % FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL;
+            int celly = (glyph / FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL;
+            for (int y = 0; y < FONT_GLYPH_HEIGHT; ++y) {
+                for (int x = 0; x < FONT_GLYPH_WIDTH; ++x) {
+                    bool set = (FONT_GLYPHS[glyph][y] >> (FONT_GLYPH_WIDTH - 1 - x)) & 1;
+                    atlas[cellx + x + (celly + y) * FONT_ATLAS_WIDTH] = set ? 255 : 0;
+                }
+            }
+        }
+
+        glGenTextures(1, &p_font_texture);
+        glBindTexture(GL_TEXTURE_2D, p_font_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, GL_ALPHA, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 0,
+            GL_ALPHA, GL_UNSIGNED_BYTE, atlas
+        );
+    }
+
+private:
+    Vertex *p_vertices;
+    size_t  p_vertex_capacity;
+
+    GlyphVertex *p_glyph_vertices;
+    size_t       p_glyph_vertex_capacity;
+    GLuint       p_font_texture;
+};
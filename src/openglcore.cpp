@@ -0,0 +1,582 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// core profile OpenGL implementation of graphics API
+// needs 3.3 core context with buffer storage (4.4 or ARB_buffer_storage)
+//
+// rectangles and glyphs go through one tiny shader, glyph vertices have
+// font atlas coordinates, rectangle ones have negative u, so whole frame
+// is one vertex stream
+// vertices are written right into persistently mapped ring buffer, which
+// is split into regions, one region per frame, every region is guarded by
+// fence, so CPU never writes what GPU still reads and there's no map/unmap
+// or buffer upload call during frame at all
+// everything between BeginFrame() and EndFrame() is drawn with single
+// draw call, unless Clear() or Viewport() come in between or region is full
+// projection lives in uniform block, which is changed only on resize
+//
+// functions past OpenGL 1.1 are loaded through platform supplied loader
+// (wglGetProcAddress() or glXGetProcAddress()), context should be current
+// when Initialize() is called
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include "platform/platform.h"
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER                0x8892
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER              0x8A11
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT               0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT          0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT            0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT         0x0100
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER             0x8B30
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER               0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS              0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS                 0x8B82
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE  0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT     0x0001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED             0x911B
+#endif
+#ifndef GL_R8
+#define GL_R8                          0x8229
+#endif
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0                    0x84C0
+#endif
+#ifndef GL_MAJOR_VERSION
+#define GL_MAJOR_VERSION               0x821B
+#endif
+#ifndef GL_MINOR_VERSION
+#define GL_MINOR_VERSION               0x821C
+#endif
+#ifndef GL_NUM_EXTENSIONS
+#define GL_NUM_EXTENSIONS              0x821D
+#endif
+
+// returns address of OpenGL function or nullptr if there's no such function
+typedef void *(*GLProcLoader)(const char *name);
+
+
+class OpenGLCoreAPI : public OpenGLRenderer
+{
+public:
+    enum
+    {
+        RING_REGIONS = 3,             // frames CPU can be ahead of GPU
+        REGION_VERTICES = 1 << 15     // 5461 quads per frame before extra draw
+    };
+
+    OpenGLCoreAPI() :
+        p_program(0),
+        p_vertex_array(0),
+        p_ring(0),
+        p_uniforms(0),
+        p_font_texture(0),
+        p_vertices(nullptr),
+        p_region(0),
+        p_first(0),
+        p_count(0),
+        p_projection_width(0),
+        p_projection_height(0),
+        p_draws(0),
+        p_frame_draws(0)
+    {
+        memset(&p_gl, 0, sizeof(p_gl));
+        memset(p_fences, 0, sizeof(p_fences));
+        p_log[0] = 0;
+    }
+
+    // loads functions and makes all objects, returns false if context
+    // can't do core profile rendering, nothing should be rendered then
+    // objects aren't deleted, they go away with context
+    bool Initialize(GLProcLoader loader)
+    {
+        if (!LoadFunctions(loader)) {
+            return false;
+        }
+
+        if (!HasBufferStorage()) {
+            strcpy(p_log, "no buffer storage support");
+            return false;
+        }
+
+        p_program = CreateProgram();
+        if (p_program == 0) {
+            return false;
+        }
+
+        // vertex ring, written by CPU for the whole run
+        p_gl.GenBuffers(1, &p_ring);
+        p_gl.BindBuffer(GL_ARRAY_BUFFER, p_ring);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const ptrdiff_t size = ptrdiff_t(sizeof(Vertex)) * RING_REGIONS * REGION_VERTICES;
+        p_gl.BufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        p_vertices = static_cast<Vertex*>(p_gl.MapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+        if (p_vertices == nullptr) {
+            strcpy(p_log, "couldn't map vertex buffer");
+            return false;
+        }
+
+        p_gl.GenVertexArrays(1, &p_vertex_array);
+        p_gl.BindVertexArray(p_vertex_array);
+        p_gl.EnableVertexAttribArray(0);
+        p_gl.EnableVertexAttribArray(1);
+        p_gl.EnableVertexAttribArray(2);
+        p_gl.VertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, x)));
+        p_gl.VertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, u)));
+        p_gl.VertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, color)));
+
+        // projection block, binding point 0
+        p_gl.GenBuffers(1, &p_uniforms);
+        p_gl.BindBuffer(GL_UNIFORM_BUFFER, p_uniforms);
+        p_gl.BufferStorage(GL_UNIFORM_BUFFER, sizeof(float) * 16, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        p_gl.BindBufferBase(GL_UNIFORM_BUFFER, 0, p_uniforms);
+        p_gl.UniformBlockBinding(p_program, p_gl.GetUniformBlockIndex(p_program, "Frame"), 0);
+
+        p_gl.UseProgram(p_program);
+        p_gl.Uniform1i(p_gl.GetUniformLocation(p_program, "font"), 0);
+
+        CreateFontTexture();
+
+        // nothing else uses this context, so state is set once
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        return true;
+    }
+
+    void BeginFrame(int width, int height) override
+    {
+        SetRenderTargetSize(width, height);
+        p_frame_draws = p_draws;
+        p_draws = 0;
+
+        if (width != p_projection_width || height != p_projection_height) {
+            p_projection_width = width;
+            p_projection_height = height;
+            if (width && height) {
+                float projection[16];
+                Projection(width, height, projection);
+                p_gl.BufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(projection), projection);
+            }
+        }
+
+        // next region is reused once GPU is done with frame which used it
+        p_region = (p_region + 1) % RING_REGIONS;
+        WaitFence(p_region);
+        p_first = 0;
+        p_count = 0;
+    }
+
+    void EndFrame() override
+    {
+        Draw();
+        p_fences[p_region] = p_gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void Clear(const Color &color) override
+    {
+        // clear goes in between draws, so pending vertices go first
+        Draw();
+
+        const float k = 1.0f / 255.0f;
+        glClearColor(color.r * k, color.g * k, color.b * k, color.a * k);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    void Viewport(int left, int top, int width, int height) override
+    {
+        Draw();
+        OpenGLRenderer::Viewport(left, top, width, height);
+    }
+
+    void Rectangle(float left, float top, float width, float height, const Color &color) override
+    {
+        Reserve(6);
+        WriteQuad(p_vertices + Next(), left, top, left + width, top + height, -1, -1, -1, -1, color);
+        p_count += 6;
+    }
+
+    void Rectangles(const ColoredRectangle *rectangles, size_t count) override
+    {
+        while (count > 0) {
+            size_t quads = Reserve(count * 6) / 6;
+            Vertex *vertex = p_vertices + Next();
+            for (size_t n = 0; n < quads; ++n) {
+                const ColoredRectangle &rectangle = rectangles[n];
+                WriteQuad(
+                    vertex, rectangle.left, rectangle.top,
+                    rectangle.left + rectangle.width, rectangle.top + rectangle.height,
+                    -1, -1, -1, -1, rectangle.color
+                );
+                vertex += 6;
+            }
+
+            p_count += quads * 6;
+            rectangles += quads;
+            count -= quads;
+        }
+    }
+
+    void Glyphs(const GlyphQuad *glyphs, size_t count) override
+    {
+        const float ku = 1.0f / FONT_ATLAS_WIDTH;
+        const float kv = 1.0f / FONT_ATLAS_HEIGHT;
+
+        while (count > 0) {
+            size_t quads = Reserve(count * 6) / 6;
+            Vertex *vertex = p_vertices + Next();
+            for (size_t n = 0; n < quads; ++n) {
+                const GlyphQuad &quad = glyphs[n];
+                float u0 = (quad.glyph % FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL * ku;
+                float v0 = (quad.glyph / FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL * kv;
+                WriteQuad(
+                    vertex, quad.left, quad.top, quad.left + quad.width, quad.top + quad.height,
+                    u0, v0, u0 + FONT_GLYPH_WIDTH * ku, v0 + FONT_GLYPH_HEIGHT * kv, quad.color
+                );
+                vertex += 6;
+            }
+
+            p_count += quads * 6;
+            glyphs += quads;
+            count -= quads;
+        }
+    }
+
+    // draw calls made by previous frame
+    size_t frame_draws() const { return p_frame_draws; }
+
+    // why Initialize() failed
+    const char *log() const { return p_log; }
+
+private:
+    OpenGLCoreAPI(const OpenGLCoreAPI&);
+    OpenGLCoreAPI &operator=(const OpenGLCoreAPI&);
+
+    struct Vertex
+    {
+        float x;
+        float y;
+        float u;     // negative for rectangles
+        float v;
+        Color color;
+    };
+
+    // OpenGL types past 1.1 aren't there in every gl.h, so plain ones are
+    // used, sync object is just a pointer
+    typedef void *Sync;
+
+    struct Functions
+    {
+        void (APIENTRY *GenBuffers)(GLsizei n, GLuint *buffers);
+        void (APIENTRY *BindBuffer)(GLenum target, GLuint buffer);
+        void (APIENTRY *BindBufferBase)(GLenum target, GLuint index, GLuint buffer);
+        void (APIENTRY *BufferStorage)(GLenum target, ptrdiff_t size, const void *data, GLbitfield flags);
+        void (APIENTRY *BufferSubData)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void *data);
+        void *(APIENTRY *MapBufferRange)(GLenum target, ptrdiff_t offset, ptrdiff_t length, GLbitfield access);
+        void (APIENTRY *GenVertexArrays)(GLsizei n, GLuint *arrays);
+        void (APIENTRY *BindVertexArray)(GLuint array);
+        void (APIENTRY *EnableVertexAttribArray)(GLuint index);
+        void (APIENTRY *VertexAttribPointer)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+        GLuint (APIENTRY *CreateShader)(GLenum type);
+        void (APIENTRY *ShaderSource)(GLuint shader, GLsizei count, const char *const *source, const GLint *length);
+        void (APIENTRY *CompileShader)(GLuint shader);
+        void (APIENTRY *GetShaderiv)(GLuint shader, GLenum name, GLint *value);
+        void (APIENTRY *GetShaderInfoLog)(GLuint shader, GLsizei size, GLsizei *length, char *log);
+        void (APIENTRY *DeleteShader)(GLuint shader);
+        GLuint (APIENTRY *CreateProgram)();
+        void (APIENTRY *AttachShader)(GLuint program, GLuint shader);
+        void (APIENTRY *LinkProgram)(GLuint program);
+        void (APIENTRY *GetProgramiv)(GLuint program, GLenum name, GLint *value);
+        void (APIENTRY *GetProgramInfoLog)(GLuint program, GLsizei size, GLsizei *length, char *log);
+        void (APIENTRY *DeleteProgram)(GLuint program);
+        void (APIENTRY *UseProgram)(GLuint program);
+        GLuint (APIENTRY *GetUniformBlockIndex)(GLuint program, const char *name);
+        void (APIENTRY *UniformBlockBinding)(GLuint program, GLuint index, GLuint binding);
+        GLint (APIENTRY *GetUniformLocation)(GLuint program, const char *name);
+        void (APIENTRY *Uniform1i)(GLint location, GLint value);
+        void (APIENTRY *ActiveTexture)(GLenum texture);
+        const GLubyte *(APIENTRY *GetStringi)(GLenum name, GLuint index);
+        Sync (APIENTRY *FenceSync)(GLenum condition, GLbitfield flags);
+        GLenum (APIENTRY *ClientWaitSync)(Sync sync, GLbitfield flags, uint64_t timeout);
+        void (APIENTRY *DeleteSync)(Sync sync);
+    };
+
+    bool LoadFunctions(GLProcLoader loader)
+    {
+        // same order as in Functions
+        static const char *NAMES[] = {
+            "glGenBuffers", "glBindBuffer", "glBindBufferBase", "glBufferStorage",
+            "glBufferSubData", "glMapBufferRange", "glGenVertexArrays", "glBindVertexArray",
+            "glEnableVertexAttribArray", "glVertexAttribPointer", "glCreateShader",
+            "glShaderSource", "glCompileShader", "glGetShaderiv", "glGetShaderInfoLog",
+            "glDeleteShader", "glCreateProgram", "glAttachShader", "glLinkProgram",
+            "glGetProgramiv", "glGetProgramInfoLog", "glDeleteProgram", "glUseProgram",
+            "glGetUniformBlockIndex", "glUniformBlockBinding", "glGetUniformLocation",
+            "glUniform1i", "glActiveTexture", "glGetStringi", "glFenceSync",
+            "glClientWaitSync", "glDeleteSync"
+        };
+        static_assert(sizeof(NAMES) / sizeof(NAMES[0]) * sizeof(void*) == sizeof(Functions), "function names don't match Functions");
+
+        void **functions = reinterpret_cast<void**>(&p_gl);
+        for (size_t n = 0; n < sizeof(NAMES) / sizeof(NAMES[0]); ++n) {
+            functions[n] = loader(NAMES[n]);
+            if (functions[n] == nullptr) {
+                snprintf(p_log, sizeof(p_log), "%s is missing", NAMES[n]);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // loaders give functions even when driver can't do them, so version
+    // or extension is checked
+    bool HasBufferStorage()
+    {
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 4)) {
+            return true;
+        }
+
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint n = 0; n < count; ++n) {
+            const char *name = reinterpret_cast<const char*>(p_gl.GetStringi(GL_EXTENSIONS, GLuint(n)));
+            if (name && strcmp(name, "GL_ARB_buffer_storage") == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    GLuint CreateShader(GLenum type, const char *source)
+    {
+        GLuint shader = p_gl.CreateShader(type);
+        p_gl.ShaderSource(shader, 1, &source, nullptr);
+        p_gl.CompileShader(shader);
+
+        GLint status = 0;
+        p_gl.GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (!status) {
+            p_gl.GetShaderInfoLog(shader, sizeof(p_log), nullptr, p_log);
+            p_gl.DeleteShader(shader);
+            return 0;
+        }
+
+        return shader;
+    }
+
+    GLuint CreateProgram()
+    {
+        static const char *VERTEX_SHADER =
+            "#version 330 core\n"
+            "layout(std140) uniform Frame { mat4 projection; };\n"
+            "layout(location = 0) in vec2 position;\n"
+            "layout(location = 1) in vec2 texcoord;\n"
+            "layout(location = 2) in vec4 color;\n"
+            "out vec2 v_texcoord;\n"
+            "out vec4 v_color;\n"
+            "void main() {\n"
+            "    gl_Position = projection * vec4(position, 0.0, 1.0);\n"
+            "    v_texcoord = texcoord;\n"
+            "    v_color = color;\n"
+            "}\n";
+
+        // same as legacy alpha texture modulated by vertex color
+        static const char *FRAGMENT_SHADER =
+            "#version 330 core\n"
+            "uniform sampler2D font;\n"
+            "in vec2 v_texcoord;\n"
+            "in vec4 v_color;\n"
+            "out vec4 fragment;\n"
+            "void main() {\n"
+            "    float alpha = v_texcoord.x < 0.0 ? 1.0 : texture(font, v_texcoord).r;\n"
+            "    fragment = vec4(v_color.rgb, v_color.a * alpha);\n"
+            "}\n";
+
+        GLuint vertex = CreateShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+        GLuint fragment = CreateShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+        if (vertex == 0 || fragment == 0) {
+            if (vertex) p_gl.DeleteShader(vertex);
+            if (fragment) p_gl.DeleteShader(fragment);
+            return 0;
+        }
+
+        GLuint program = p_gl.CreateProgram();
+        p_gl.AttachShader(program, vertex);
+        p_gl.AttachShader(program, fragment);
+        p_gl.LinkProgram(program);
+        p_gl.DeleteShader(vertex);
+        p_gl.DeleteShader(fragment);
+
+        GLint status = 0;
+        p_gl.GetProgramiv(program, GL_LINK_STATUS, &status);
+        if (!status) {
+            p_gl.GetProgramInfoLog(program, sizeof(p_log), nullptr, p_log);
+            p_gl.DeleteProgram(program);
+            return 0;
+        }
+
+        return program;
+    }
+
+    // font atlas as single channel texture, glyph pixels are 255
+    void CreateFontTexture()
+    {
+        static uint8_t atlas[FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT];
+        memset(atlas, 0, sizeof(atlas));
+
+        for (int glyph = 0; glyph < FONT_GLYPH_COUNT; ++glyph) {
+            int cellx = (glyph % FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL;
+            int celly = (glyph / FONT_ATLAS_COLUMNS) * FONT_ATLAS_CELL;
+            for (int y = 0; y < FONT_GLYPH_HEIGHT; ++y) {
+                for (int x = 0; x < FONT_GLYPH_WIDTH; ++x) {
+                    bool set = (FONT_GLYPHS[glyph][y] >> (FONT_GLYPH_WIDTH - 1 - x)) & 1;
+                    atlas[cellx + x + (celly + y) * FONT_ATLAS_WIDTH] = set ? 255 : 0;
+                }
+            }
+        }
+
+        p_gl.ActiveTexture(GL_TEXTURE0);
+        glGenTextures(1, &p_font_texture);
+        glBindTexture(GL_TEXTURE_2D, p_font_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, GL_R8, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 0,
+            GL_RED, GL_UNSIGNED_BYTE, atlas
+        );
+    }
+
+    // same triangles as legacy Rectangle() draws
+    static void WriteQuad(Vertex *vertex, float left, float top, float right, float bottom, float u0, float v0, float u1, float v1, const Color &color)
+    {
+        vertex[0].x = left;  vertex[0].y = top;    vertex[0].u = u0; vertex[0].v = v0;
+        vertex[1].x = right; vertex[1].y = top;    vertex[1].u = u1; vertex[1].v = v0;
+        vertex[2].x = left;  vertex[2].y = bottom; vertex[2].u = u0; vertex[2].v = v1;
+        vertex[3].x = right; vertex[3].y = top;    vertex[3].u = u1; vertex[3].v = v0;
+        vertex[4].x = right; vertex[4].y = bottom; vertex[4].u = u1; vertex[4].v = v1;
+        vertex[5].x = left;  vertex[5].y = bottom; vertex[5].u = u0; vertex[5].v = v1;
+        for (int v = 0; v < 6; ++v) {
+            vertex[v].color = color;
+        }
+    }
+
+    // ring index of next vertex to write
+    size_t Next() const
+    {
+        return p_region * REGION_VERTICES + p_first + p_count;
+    }
+
+    // returns how many of wanted vertices fit into current region, always
+    // whole quads and at least one
+    // full region is drawn, and then GPU is waited for to start it over,
+    // this only happens with really huge frames
+    size_t Reserve(size_t wanted)
+    {
+        size_t available = REGION_VERTICES - p_first - p_count;
+        if (available < 6) {
+            Draw();
+            p_fences[p_region] = p_gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            WaitFence(p_region);
+            p_first = 0;
+            available = REGION_VERTICES;
+        }
+
+        size_t vertices = wanted < available ? wanted : available;
+        return vertices - vertices % 6;
+    }
+
+    // draws pending vertices of current region
+    void Draw()
+    {
+        if (p_count == 0) {
+            return;
+        }
+
+        glDrawArrays(GL_TRIANGLES, GLint(p_region * REGION_VERTICES + p_first), GLsizei(p_count));
+        p_first += p_count;
+        p_count = 0;
+        ++p_draws;
+    }
+
+    void WaitFence(size_t region)
+    {
+        Sync fence = p_fences[region];
+        if (fence == nullptr) {
+            return;
+        }
+
+        // first wait flushes commands, so fence surely gets signaled
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        for (;;) {
+            GLenum result = p_gl.ClientWaitSync(fence, flags, 100000000);
+            if (result != GL_TIMEOUT_EXPIRED) {
+                break;
+            }
+            flags = 0;
+        }
+
+        p_gl.DeleteSync(fence);
+        p_fences[region] = nullptr;
+    }
+
+private:
+    Functions p_gl;
+
+    GLuint  p_program;
+    GLuint  p_vertex_array;
+    GLuint  p_ring;             // persistently mapped vertex ring
+    GLuint  p_uniforms;         // projection block
+    GLuint  p_font_texture;
+    Vertex *p_vertices;         // mapped ring
+    Sync    p_fences[RING_REGIONS];
+
+    size_t  p_region;           // region of current frame
+    size_t  p_first;            // first pending vertex in region
+    size_t  p_count;            // pending vertices
+
+    int     p_projection_width; // size projection block was set for
+    int     p_projection_height;
+
+    size_t  p_draws;
+    size_t  p_frame_draws;
+
+    char    p_log[1024];
+};
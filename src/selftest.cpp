@@ -0,0 +1,555 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// self checks for things golden images can't show, headless platform runs
+// them with -selftest DIR, files made by checks are written into DIR
+// every check prints its name and result, run fails if any check fails
+
+#include <cstdio>
+#include <cstring>
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+// writes replay file frame by frame, frames could have any data, so
+// broken replays could be made too
+class SelfTestReplay
+{
+public:
+    SelfTestReplay(const char *dir, const char *name, uint64_t seed) :
+        p_file(nullptr)
+    {
+        snprintf(p_path, sizeof(p_path), "%s/%s", dir, name);
+        p_file = fopen(p_path, "wb");
+        if (p_file) {
+            ReplayHeader header;
+            memcpy(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+            header.version = REPLAY_VERSION;
+            header.seed = seed;
+            fwrite(&header, sizeof(header), 1, p_file);
+        }
+    }
+
+    ~SelfTestReplay()
+    {
+        Close();
+    }
+
+    void Frame(float interval, const InputEvent *events = nullptr, uint32_t count = 0)
+    {
+        if (p_file) {
+            ReplayFrame frame = { interval, count };
+            fwrite(&frame, sizeof(frame), 1, p_file);
+            if (count > 0) {
+                fwrite(events, sizeof(InputEvent), count, p_file);
+            }
+        }
+    }
+
+    // raw bytes, for cut off frames
+    void Bytes(const void *data, size_t size)
+    {
+        if (p_file) {
+            fwrite(data, 1, size, p_file);
+        }
+    }
+
+    void Close()
+    {
+        if (p_file) {
+            fclose(p_file);
+            p_file = nullptr;
+        }
+    }
+
+    const char *path() const { return p_path; }
+
+private:
+    SelfTestReplay(const SelfTestReplay&);
+    SelfTestReplay &operator=(const SelfTestReplay&);
+
+    FILE *p_file;
+    char  p_path[1024];
+};
+
+static bool SelfTestResult(const char *name, bool ok)
+{
+    printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+
+// verifier takes honest replays, including ones played past game over, and
+// rejects bad and cut off ones
+static bool SelfTestVerifier(const char *dir)
+{
+    const float interval = 1.0f / 60;
+    const uint64_t seed = 5;
+
+    // game without input ends with nothing when figures pile up, then bot
+    // plays next game, which doesn't count
+    Game game(seed);
+    VerifierPlatform platform;
+    Input input = {};
+    SelfTestReplay pastgameover(dir, "past_game_over.rpl", seed);
+    int tick = 0;
+    for (; game.game_overs() == 0 && tick < 100000; ++tick) {
+        game.ProcessInput(platform, input);
+        game.Update(interval);
+        pastgameover.Frame(interval);
+    }
+
+    HashCache cache(1 << 16);
+    BotInput bot(game, BOT_DEFAULT_WEIGHTS, &cache);
+    for (int end = tick + 3000; tick < end; ++tick) {
+        input.event_count = 0;
+        input.event_dropped = 0;
+        float botinterval = interval;
+        bot.NextFrame(input, uint32_t(tick * 1000 / 60), botinterval);
+        game.ProcessInput(platform, input);
+        game.Update(interval);
+        pastgameover.Frame(interval, input.events, uint32_t(input.event_count));
+    }
+    pastgameover.Close();
+
+    InputEvent key = {};
+    key.type = INPUT_KEY_DOWN;
+    key.keyboard.key = KEY_LEFT;
+
+    SelfTestReplay honest(dir, "honest.rpl", seed);
+    honest.Frame(interval, &key, 1);
+    honest.Frame(interval);
+    honest.Close();
+
+    // key far outside of keyboard state
+    InputEvent badkey = key;
+    badkey.keyboard.key = InputKey(100000);
+    SelfTestReplay malformedkey(dir, "malformed_key.rpl", seed);
+    malformedkey.Frame(interval);
+    malformedkey.Frame(interval, &badkey, 1);
+    malformedkey.Close();
+
+    // button bit past 32 bit mask
+    InputEvent badbutton = {};
+    badbutton.type = INPUT_BUTTON_DOWN;
+    badbutton.joystick.number = 0;
+    badbutton.joystick.button = InputJoystickButton(40);
+    SelfTestReplay malformedbutton(dir, "malformed_button.rpl", seed);
+    malformedbutton.Frame(interval, &badbutton, 1);
+    malformedbutton.Close();
+
+    InputEvent badjoystick = badbutton;
+    badjoystick.joystick.number = JOYSTICK_DEVICE_COUNT;
+    badjoystick.joystick.button = JOY_BUTTON_0;
+    SelfTestReplay malformedjoystick(dir, "malformed_joystick.rpl", seed);
+    malformedjoystick.Frame(interval, &badjoystick, 1);
+    malformedjoystick.Close();
+
+    SelfTestReplay nan(dir, "nan_interval.rpl", seed);
+    nan.Frame(interval);
+    nan.Frame(std::nanf(""));
+    nan.Close();
+
+    // slow motion
+    SelfTestReplay tiny(dir, "tiny_interval.rpl", seed);
+    tiny.Frame(0.0001f);
+    tiny.Close();
+
+    SelfTestReplay huge(dir, "huge_interval.rpl", seed);
+    huge.Frame(1e30f);
+    huge.Close();
+
+    // frame says it has event, but file ends in the middle of it
+    SelfTestReplay truncated(dir, "truncated.rpl", seed);
+    truncated.Frame(interval);
+    ReplayFrame frame = { interval, 1 };
+    truncated.Bytes(&frame, sizeof(frame));
+    truncated.Bytes(&key, sizeof(key) / 2);
+    truncated.Close();
+
+    // file ends in the middle of frame header
+    SelfTestReplay truncatedframe(dir, "truncated_frame.rpl", seed);
+    truncatedframe.Frame(interval);
+    truncatedframe.Bytes(&frame, sizeof(frame) - 1);
+    truncatedframe.Close();
+
+    char listpath[1024];
+    snprintf(listpath, sizeof(listpath), "%s/verify.txt", dir);
+    FILE *list = fopen(listpath, "w");
+    if (list == nullptr) {
+        return SelfTestResult("verifier", false);
+    }
+    fprintf(list, "%s 0 0\n", pastgameover.path());
+    fprintf(list, "%s 0 0\n", honest.path());
+    fprintf(list, "%s 0\n", malformedkey.path());
+    fprintf(list, "%s 0\n", malformedbutton.path());
+    fprintf(list, "%s 0\n", malformedjoystick.path());
+    fprintf(list, "%s 0\n", nan.path());
+    fprintf(list, "%s 0\n", tiny.path());
+    fprintf(list, "%s 0\n", huge.path());
+    fprintf(list, "%s 0\n", truncated.path());
+    fprintf(list, "%s 0\n", truncatedframe.path());
+    fclose(list);
+
+    static const VerifyStatus EXPECTED[] = {
+        VERIFY_OK, VERIFY_OK,
+        VERIFY_BROKEN, VERIFY_BROKEN, VERIFY_BROKEN,
+        VERIFY_BROKEN, VERIFY_BROKEN, VERIFY_BROKEN,
+        VERIFY_BROKEN, VERIFY_BROKEN
+    };
+    const size_t expected = sizeof(EXPECTED) / sizeof(EXPECTED[0]);
+
+    ReplayVerifier verifier;
+    bool ok = verifier.Load(listpath) && verifier.count() == expected;
+    if (ok) {
+        verifier.Run(1);
+        for (size_t n = 0; n < expected; ++n) {
+            if (verifier.entry(n).status != EXPECTED[n]) {
+                printf("    %s: unexpected status %d\n", verifier.entry(n).path, int(verifier.entry(n).status));
+                ok = false;
+            }
+        }
+    }
+
+    // bot game should have some lines, or past game over replay checks
+    // nothing
+    return SelfTestResult("verifier", ok && game.game_overs() == 1 && game.lines() > 0);
+}
+
+
+// gives one event at given tick as is, without applying it to input state,
+// so any event could go into recording
+class SelfTestEventSource : public InputSource
+{
+public:
+    SelfTestEventSource(int tick, const InputEvent &event) :
+        p_tick(0),
+        p_event_tick(tick),
+        p_event(event)
+    {}
+
+    bool NextFrame(Input &input, uint32_t, float &interval) override
+    {
+        if (p_tick++ == p_event_tick && input.event_count < INPUT_EVENT_COUNT) {
+            input.events[input.event_count++] = p_event;
+        }
+        interval = 1.0f / 60;
+        return true;
+    }
+
+private:
+    int        p_tick;
+    int        p_event_tick;
+    InputEvent p_event;
+};
+
+// records archive with given event at tick 30, keyframes are every 20
+// ticks, path gets archive file name
+static bool SelfTestArchiveRecord(const char *dir, const char *name, const InputEvent &event, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s", dir, name);
+
+    Game game(9);
+    SelfTestEventSource source(30, event);
+    ArchiveRecorder recorder(source, game);
+    if (!recorder.Open(path, 9, 20)) {
+        return false;
+    }
+
+    Input input = {};
+    for (int tick = 0; tick < 100; ++tick) {
+        input.event_count = 0;
+        float interval = 0;
+        recorder.NextFrame(input, 0, interval);
+    }
+    return true;
+}
+
+// seeks from keyframe at tick 20 through tick 30
+static bool SelfTestArchiveSeek(const char *path)
+{
+    Game game(9);
+    VerifierPlatform platform;
+    ArchiveInput archive;
+    return archive.Open(path) && archive.Seek(game, platform, 35);
+}
+
+// ways to damage keyframe state, each of them is out of game data bounds
+// or doesn't match the field
+enum SelfTestDamage
+{
+    DAMAGE_FIGURE,
+    DAMAGE_FIGURE_X,
+    DAMAGE_FIGURE_Y,
+    DAMAGE_HOLD,
+    DAMAGE_GARBAGE,
+    DAMAGE_GARBAGE_HOLE,
+    DAMAGE_ROW,
+    DAMAGE_HASH,
+    DAMAGE_COUNT
+};
+
+// damages state of keyframe at tick 20 right in the file
+static bool SelfTestDamageKeyframe(const char *path, int damage)
+{
+    FILE *file = fopen(path, "r+b");
+    if (file == nullptr) {
+        return false;
+    }
+
+    ArchiveHeader header;
+    ArchiveKeyframe keyframe;
+    GameStateHeader state;
+    bool ok =
+        fread(&header, sizeof(header), 1, file) == 1 && header.keyframes > 1 &&
+        fseek(file, long(header.index + sizeof(ArchiveKeyframe)), SEEK_SET) == 0 &&
+        fread(&keyframe, sizeof(keyframe), 1, file) == 1 &&
+        fseek(file, long(keyframe.offset), SEEK_SET) == 0 &&
+        fread(&state, sizeof(state), 1, file) == 1;
+
+    // top row is empty this early, filled cell in it isn't in the field
+    uint32_t row = 1;
+    long rowoffset = long(keyframe.offset + sizeof(state) + sizeof(Color) * state.width * state.height);
+
+    switch (damage) {
+        case DAMAGE_FIGURE:       state.figure.Make(None); break;
+        case DAMAGE_FIGURE_X:     state.figure_x = 1000; break;
+        case DAMAGE_FIGURE_Y:     state.figure_y = -1000; break;
+        case DAMAGE_HOLD:         state.hold = FigureType(50); break;
+        case DAMAGE_GARBAGE:      state.garbage = 1000; break;
+        case DAMAGE_GARBAGE_HOLE: state.garbage_hole = -5; break;
+        case DAMAGE_HASH:         state.hash ^= 1; break;
+    }
+
+    ok = ok && fseek(file, long(keyframe.offset), SEEK_SET) == 0 && fwrite(&state, sizeof(state), 1, file) == 1;
+    if (damage == DAMAGE_ROW) {
+        ok = ok && fseek(file, rowoffset, SEEK_SET) == 0 && fwrite(&row, sizeof(row), 1, file) == 1;
+    }
+
+    fclose(file);
+    return ok;
+}
+
+// archive with bad event in the middle or with damaged keyframe can't be
+// played through it
+static bool SelfTestArchive(const char *dir)
+{
+    InputEvent key = {};
+    key.type = INPUT_KEY_DOWN;
+    key.keyboard.key = KEY_LEFT;
+
+    InputEvent badkey = key;
+    badkey.keyboard.key = InputKey(100000);
+
+    InputEvent badpov = {};
+    badpov.type = INPUT_POV;
+    badpov.joystick.number = 1;
+    badpov.joystick.pov.pov = InputJoystickPOV(JOY_POV_COUNT);
+
+    char path[1024];
+    bool ok =
+        SelfTestArchiveRecord(dir, "honest.tfa", key, path, sizeof(path)) && SelfTestArchiveSeek(path) &&
+        SelfTestArchiveRecord(dir, "malformed_key.tfa", badkey, path, sizeof(path)) && !SelfTestArchiveSeek(path) &&
+        SelfTestArchiveRecord(dir, "malformed_pov.tfa", badpov, path, sizeof(path)) && !SelfTestArchiveSeek(path);
+
+    for (int damage = 0; damage < DAMAGE_COUNT && ok; ++damage) {
+        char name[64];
+        snprintf(name, sizeof(name), "damaged_state_%d.tfa", damage);
+        ok = SelfTestArchiveRecord(dir, name, key, path, sizeof(path)) && SelfTestDamageKeyframe(path, damage);
+        if (ok && SelfTestArchiveSeek(path)) {
+            printf("    damaged state %d is loaded\n", damage);
+            ok = false;
+        }
+    }
+
+    return SelfTestResult("archive", ok);
+}
+
+
+// plays script with event times starting at given time, figure column is
+// written for every tick
+static bool SelfTestPlayScript(const char *path, uint32_t start, int *columns, int ticks)
+{
+    ScriptInput script;
+    if (!script.Load(path)) {
+        return false;
+    }
+
+    Game game(3);
+    VerifierPlatform platform;
+    Input input = {};
+    const float interval = 1.0f / 60;
+    for (int tick = 0; tick < ticks; ++tick) {
+        input.event_count = 0;
+        input.event_dropped = 0;
+        float scriptinterval = interval;
+        script.NextFrame(input, start + uint32_t(tick * 1000 / 60), scriptinterval);
+        game.ProcessInput(platform, input);
+        game.Update(interval);
+        columns[tick] = game.figure_x();
+    }
+
+    return true;
+}
+
+// held directions repeat same way whatever platform clock is, real clocks
+// are often past 2^31 ms and wrap around
+static bool SelfTestInputClock(const char *dir)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/input_clock.txt", dir);
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        return SelfTestResult("input clock", false);
+    }
+    // tap moves once, hold repeats, script frame N is tick N - 1
+    fprintf(file, "2 down RIGHT\n4 up RIGHT\n10 down LEFT\n22 up LEFT\n");
+    fclose(file);
+
+    static const uint32_t STARTS[] = { 0, 0x90000000, 0xFFFFFF00 };
+    enum { TICKS = 60 };
+    int columns[3][TICKS];
+    bool ok = true;
+    for (int run = 0; run < 3 && ok; ++run) {
+        ok = SelfTestPlayScript(path, STARTS[run], columns[run], TICKS);
+    }
+
+    for (int tick = 0; tick < TICKS && ok; ++tick) {
+        if (columns[1][tick] != columns[0][tick] || columns[2][tick] != columns[0][tick]) {
+            printf("    tick %d: columns %d, %d, %d\n", tick, columns[0][tick], columns[1][tick], columns[2][tick]);
+            ok = false;
+        }
+    }
+
+    // tap is one column, hold of 12 ticks (200 ms) is first move and
+    // repeats due up to release
+    int held = 2 + (200 - SHIFT_DELAY) / SHIFT_REPEAT;
+    ok = ok && columns[0][3] == columns[0][0] + 1 && columns[0][30] == columns[0][3] - held;
+
+    return SelfTestResult("input clock", ok);
+}
+
+
+// GameBatch plays same games as Game: same random moves go to batch and to
+// Game objects, boards are compared every tick, so first difference shows
+// tick it happened at
+static bool SelfTestBatch()
+{
+    // figures fall row per few ticks, so many of them lock in short run
+    enum { GAMES = 64, TICKS = 40000, RATE = 4 };
+    const float interval = 1.0f / RATE;
+
+    GamePool pool(GAMES);
+    for (size_t game = 0; game < GAMES; ++game) {
+        pool.Create(game);
+    }
+    GameBatch batch(GAMES);
+    VerifierPlatform platform;
+    Random random(5);
+    Input input = {};
+
+    // lines are counted over whole run, they start over with every game
+    int lines[GAMES] = {};
+    int cleared = 0;
+    int gameovers = 0;
+    bool ok = true;
+    for (int tick = 0; tick < TICKS && ok; ++tick) {
+        int8_t moves[GAMES];
+        for (size_t game = 0; game < GAMES; ++game) {
+            moves[game] = int8_t(int(random.Next(3)) - 1);
+            GameBatch::MoveLikeBatch(*pool.game(game), platform, input, moves[game], uint32_t(tick * 1000 / RATE));
+            pool.game(game)->Update(interval);
+        }
+        batch.Move(moves);
+        batch.Update(interval);
+
+        for (size_t game = 0; game < GAMES && ok; ++game) {
+            const Game &other = *pool.game(game);
+            if (!batch.Matches(game, other)) {
+                printf("    game %zu differs at tick %d\n", game, tick);
+                ok = false;
+            }
+            cleared += other.lines() > lines[game] ? other.lines() - lines[game] : 0;
+            lines[game] = other.lines();
+        }
+    }
+    for (size_t game = 0; game < GAMES; ++game) {
+        gameovers += pool.game(game)->game_overs();
+    }
+    printf("    %d lines cleared, %d games over\n", cleared, gameovers);
+
+    // row removal and game over should happen, otherwise they aren't checked
+    return SelfTestResult("batch", ok && cleared > 0 && gameovers > 0);
+}
+
+
+#if !defined(_WIN32)
+// listener which never reads can't stall telemetry, reports are dropped
+// once socket buffer is full
+static bool SelfTestTelemetry(const char *dir)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    int length = snprintf(address.sun_path, sizeof(address.sun_path), "%s/telemetry.sock", dir);
+    if (length < 0 || size_t(length) >= sizeof(address.sun_path)) {
+        printf("    socket path is too long\n");
+        return SelfTestResult("telemetry", false);
+    }
+
+    unlink(address.sun_path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool ok =
+        listener >= 0 &&
+        bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+        listen(listener, 1) == 0;
+
+    if (ok) {
+        char target[sizeof(address.sun_path) + 8];
+        snprintf(target, sizeof(target), "unix:%s", address.sun_path);
+
+        Telemetry telemetry;
+        ok = telemetry.Open(target, 0);
+
+        // every report is over 1KB, so these are way over socket buffer
+        uint64_t phases[TELEMETRY_PHASE_COUNT] = {};
+        Input input = {};
+        for (int report = 1; report <= 10000 && ok; ++report) {
+            telemetry.RecordFrame(16000, phases, input);
+            telemetry.Flush(report);
+        }
+    }
+
+    if (listener >= 0) {
+        close(listener);
+    }
+    unlink(address.sun_path);
+
+    return SelfTestResult("telemetry", ok);
+}
+#endif
+
+
+static int RunSelfTest(const char *dir)
+{
+    bool ok = true;
+    ok = SelfTestVerifier(dir) && ok;
+    ok = SelfTestArchive(dir) && ok;
+    ok = SelfTestInputClock(dir) && ok;
+    ok = SelfTestBatch() && ok;
+#if !defined(_WIN32)
+    ok = SelfTestTelemetry(dir) && ok;
+#endif
+
+    printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// software implementation of graphics API
+// renders into plain RGBA memory buffer, doesn't need any GPU or window,
+// used for headless runs and frame captures
+
+#include "platform/platform.h"
+
+
+class SoftwareAPI : public GraphicsAPI
+{
+public:
+    SoftwareAPI(int width, int height) :
+        p_width(width),
+        p_height(height),
+        p_vp_left(0),
+        p_vp_top(0),
+        p_vp_width(width),
+        p_vp_height(height)
+    {
+        p_pixels = new Color[width * height];
+    }
+
+    ~SoftwareAPI()
+    {
+        delete[] p_pixels;
+    }
+
+    void Clear(const Color &color) override
+    {
+        // same as glClear - whole buffer is cleared regardless of viewport
+        for (int pixel = 0; pixel < p_width * p_height; ++pixel) {
+            p_pixels[pixel] = color;
+        }
+    }
+
+    void Viewport(int left, int top, int width, int height) override
+    {
+        p_vp_left = left;
+        p_vp_top = top;
+        p_vp_width = width;
+        p_vp_height = height;
+    }
+
+    void Rectangle(float left, float top, float width, float height, const Color &color) override
+    {
+        // fully transparent rectangles change nothing
+        if (color.a == 0) {
+            return;
+        }
+
+        // coordinates are in render target pixels, scaled into viewport
+        // exactly like ortho projection + viewport do in OpenGL
+        float kx = float(p_vp_width) / float(p_width);
+        float ky = float(p_vp_height) / float(p_height);
+
+        // pixel is covered when its center is inside rectangle
+        int x0 = Clamp(RoundUp(p_vp_left + left * kx - 0.5f), p_vp_left, p_vp_left + p_vp_width);
+        int x1 = Clamp(RoundUp(p_vp_left + (left + width) * kx - 0.5f), p_vp_left, p_vp_left + p_vp_width);
+        int y0 = Clamp(RoundUp(p_vp_top + top * ky - 0.5f), p_vp_top, p_vp_top + p_vp_height);
+        int y1 = Clamp(RoundUp(p_vp_top + (top + height) * ky - 0.5f), p_vp_top, p_vp_top + p_vp_height);
+
+        x0 = Clamp(x0, 0, p_width);
+        x1 = Clamp(x1, 0, p_width);
+        y0 = Clamp(y0, 0, p_height);
+        y1 = Clamp(y1, 0, p_height);
+
+        // blending is same as set up for OpenGL:
+        // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+        int sa = color.a;
+        int da = 255 - sa;
+        for (int y = y0; y < y1; ++y) {
+            Color *pixel = p_pixels + x0 + y * p_width;
+            for (int x = x0; x < x1; ++x, ++pixel) {
+                pixel->r = uint8_t((color.r * sa + pixel->r * da + 127) / 255);
+                pixel->g = uint8_t((color.g * sa + pixel->g * da + 127) / 255);
+                pixel->b = uint8_t((color.b * sa + pixel->b * da + 127) / 255);
+                pixel->a = uint8_t((color.a * sa + pixel->a * da + 127) / 255);
+            }
+        }
+    }
+
+    void Rectangles(const ColoredRectangle *rectangles, size_t count) override
+    {
+        for (size_t n = 0; n < count; ++n) {
+            const ColoredRectangle &rectangle = rectangles[n];
+            Rectangle(rectangle.left, rectangle.top, rectangle.width, rectangle.height, rectangle.color);
+        }
+    }
+
+    // glyph pixels are drawn as rectangles, which is same as nearest
+    // sampling of font atlas
+    void Glyphs(const GlyphQuad *glyphs, size_t count) override
+    {
+        for (size_t n = 0; n < count; ++n) {
+            const GlyphQuad &quad = glyphs[n];
+            const uint8_t *rows = FONT_GLYPHS[quad.glyph < FONT_GLYPH_COUNT ? quad.glyph : 0];
+            float pixelwidth = quad.width / FONT_GLYPH_WIDTH;
+            float pixelheight = quad.height / FONT_GLYPH_HEIGHT;
+
+            for (int y = 0; y < FONT_GLYPH_HEIGHT; ++y) {
+                for (int x = 0; x < FONT_GLYPH_WIDTH; ++x) {
+                    if ((rows[y] >> (FONT_GLYPH_WIDTH - 1 - x)) & 1) {
+                        Rectangle(
+                            quad.left + x * pixelwidth, quad.top + y * pixelheight,
+                            pixelwidth, pixelheight, quad.color
+                        );
+                    }
+                }
+            }
+        }
+    }
+
+    int width() const { return p_width; }
+    int height() const { return p_height; }
+    const Color *pixels() const { return p_pixels; }
+
+protected:
+    void GetRenderTargetSize(int &width, int &height) override
+    {
+        width = p_width;
+        height = p_height;
+    }
+
+private:
+    static int RoundUp(float value)
+    {
+        int result = int(value);
+        return float(result) < value ? result + 1 : result;
+    }
+
+    static int Clamp(int value, int minvalue, int maxvalue)
+    {
+        return value < minvalue ? minvalue : (value > maxvalue ? maxvalue : value);
+    }
+
+private:
+    int    p_width;
+    int    p_height;
+    int    p_vp_left;
+    int    p_vp_top;
+    int    p_vp_width;
+    int    p_vp_height;
+    Color *p_pixels;
+};
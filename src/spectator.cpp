@@ -0,0 +1,175 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// spectator view: all games of a pool on one screen
+// games are laid out in a grid which gives biggest boards for the screen,
+// screen is cleared once and all boards go into single rectangle batch, so
+// whole view is one submission to graphics API
+
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+
+class Spectator
+{
+public:
+    // capacity is maximal number of games shown
+    Spectator(size_t capacity) :
+        p_capacity(capacity * Game::BOARD_RECTANGLES),
+        p_width(0),
+        p_height(0),
+        p_count(0),
+        p_columns(1),
+        p_block_size(0),
+        p_cell_width(0),
+        p_cell_height(0)
+    {
+        p_rectangles = new ColoredRectangle[p_capacity];
+    }
+
+    ~Spectator()
+    {
+        delete[] p_rectangles;
+    }
+
+    void Render(GraphicsAPI &api, GamePool &pool, int width, int height)
+    {
+        api.Clear(Color(20, 40, 205));
+
+        size_t count = pool.count();
+        if (count == 0) {
+            return;
+        }
+
+        // layout depends only on screen size and number of games
+        if (width != p_width || height != p_height || count != p_count) {
+            Layout(width, height, count);
+        }
+
+        RectangleBatch batch(api, p_rectangles, p_capacity);
+        for (size_t n = 0; n < count; ++n) {
+            size_t column = n % p_columns;
+            size_t row = n / p_columns;
+
+            // board is centered in its grid cell
+            float x = column * p_cell_width + (p_cell_width - Game::FIELD_WIDTH * p_block_size) / 2;
+            float y = row * p_cell_height + (p_cell_height - Game::FIELD_HEIGHT * p_block_size) / 2;
+
+            pool.game(n)->RenderBoard(batch, x, y, p_block_size);
+        }
+        batch.Flush();
+    }
+
+private:
+    Spectator(const Spectator&);
+    Spectator &operator=(const Spectator&);
+
+    // tries every column count and takes one which gives biggest blocks,
+    // every board has half a block of free space around it
+    void Layout(int width, int height, size_t count)
+    {
+        p_width = width;
+        p_height = height;
+        p_count = count;
+        p_columns = 1;
+        p_block_size = 0;
+
+        for (size_t columns = 1; columns <= count; ++columns) {
+            size_t rows = (count + columns - 1) / columns;
+            float cellwidth = float(width) / float(columns);
+            float cellheight = float(height) / float(rows);
+
+            float block = cellwidth / (Game::FIELD_WIDTH + 1);
+            float blockbyheight = cellheight / (Game::FIELD_HEIGHT + 1);
+            block = blockbyheight < block ? blockbyheight : block;
+
+            // whole pixels, same as single game rendering
+            block = float(int(block));
+            if (block > p_block_size) {
+                p_block_size = block;
+                p_columns = columns;
+            }
+        }
+
+        size_t rows = (count + p_columns - 1) / p_columns;
+        p_cell_width = float(width) / float(p_columns);
+        p_cell_height = float(height) / float(rows);
+    }
+
+private:
+    ColoredRectangle *p_rectangles;
+    size_t            p_capacity;
+
+    // current layout
+    int    p_width;
+    int    p_height;
+    size_t p_count;
+    size_t p_columns;
+    float  p_block_size;
+    float  p_cell_width;
+    float  p_cell_height;
+};
+
+
+// games played by bots, content for spectator view when there are no real
+// players, also used to test spectator view headless
+class BotGames
+{
+public:
+    BotGames(size_t count, uint64_t seed) :
+        p_pool(count),
+        p_cache(1 << 16)
+    {
+        p_inputs = new Input[count]();
+        p_bot_memory = new uint8_t[sizeof(BotInput) * count];
+        p_bots = reinterpret_cast<BotInput*>(p_bot_memory);
+
+        // bots share field evaluation cache, same fields come up in many games
+        for (size_t n = 0; n < count; ++n) {
+            Game *game = p_pool.Create(seed + n);
+            new (p_bots + n) BotInput(*game, BOT_DEFAULT_WEIGHTS, &p_cache);
+        }
+    }
+
+    ~BotGames()
+    {
+        for (size_t n = 0; n < p_pool.count(); ++n) {
+            p_bots[n].~BotInput();
+        }
+        delete[] p_bot_memory;
+        delete[] p_inputs;
+    }
+
+    // every bot looks at its game and presses keys, then game is updated
+    void Update(PlatformAPI &api, uint32_t time, float interval)
+    {
+        for (size_t n = 0; n < p_pool.count(); ++n) {
+            Input &input = p_inputs[n];
+            input.event_count = 0;
+            input.event_dropped = 0;
+
+            float gameinterval = interval;
+            p_bots[n].NextFrame(input, time, gameinterval);
+
+            Game *game = p_pool.game(n);
+            game->ProcessInput(api, input);
+            game->Update(gameinterval);
+        }
+    }
+
+    GamePool &pool() { return p_pool; }
+
+private:
+    BotGames(const BotGames&);
+    BotGames &operator=(const BotGames&);
+
+    GamePool   p_pool;
+    HashCache  p_cache;
+    Input     *p_inputs;
+    uint8_t   *p_bot_memory;
+    BotInput  *p_bots;
+};
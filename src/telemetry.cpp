@@ -0,0 +1,262 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// frame time and input latency telemetry
+// platform main loop records every frame, telemetry keeps streaming histograms
+// and on every interval writes one JSON line with percentiles to a file or
+// unix domain socket (target "unix:/path/to/socket"), then starts over
+// socket is never waited on, report which doesn't fit into socket buffer
+// is dropped, so slow listener can't stall the game
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cerrno>
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+// frame phases measured by platform main loop
+enum TelemetryPhase
+{
+    TELEMETRY_INPUT,   // gathering platform input
+    TELEMETRY_PROCESS, // game input processing
+    TELEMETRY_UPDATE,  // game update
+    TELEMETRY_RENDER,  // game rendering including buffer swap
+    TELEMETRY_PHASE_COUNT
+};
+
+static const char *TELEMETRY_PHASE_NAMES[TELEMETRY_PHASE_COUNT] = {
+    "input", "process", "update", "render"
+};
+
+
+class Telemetry
+{
+public:
+    Telemetry() :
+        p_file(nullptr),
+        p_socket(-1),
+        p_interval(0),
+        p_last_flush(0),
+        p_event_max(0),
+        p_event_dropped(0),
+        p_reports_dropped(0)
+    {
+        p_socket_path[0] = 0;
+    }
+
+    ~Telemetry()
+    {
+        Close();
+    }
+
+    // target is file name (report lines are appended) or unix:path for
+    // unix domain socket, interval is in seconds
+    bool Open(const char *target, double interval)
+    {
+        Close();
+        p_interval = interval;
+
+        if (strncmp(target, "unix:", 5) == 0) {
+#if defined(_WIN32)
+            return false;
+#else
+            strncpy(p_socket_path, target + 5, sizeof(p_socket_path) - 1);
+            p_socket_path[sizeof(p_socket_path) - 1] = 0;
+            return Connect();
+#endif
+        }
+
+        p_file = fopen(target, "a");
+        return p_file != nullptr;
+    }
+
+    void Close()
+    {
+        if (p_file) {
+            fclose(p_file);
+            p_file = nullptr;
+        }
+#if !defined(_WIN32)
+        if (p_socket >= 0) {
+            close(p_socket);
+        }
+#endif
+        p_socket = -1;
+        p_socket_path[0] = 0;
+    }
+
+    bool active() const { return p_file != nullptr || p_socket_path[0] != 0; }
+
+    // records single frame, all times are in microseconds
+    // input is the one passed to game this frame
+    void RecordFrame(uint64_t frametime, const uint64_t phases[TELEMETRY_PHASE_COUNT], const Input &input)
+    {
+        p_frame.Record(frametime);
+        for (int phase = 0; phase < TELEMETRY_PHASE_COUNT; ++phase) {
+            p_phases[phase].Record(phases[phase]);
+        }
+
+        p_event_max = input.event_count > p_event_max ? input.event_count : p_event_max;
+        p_event_dropped += input.event_dropped;
+    }
+
+    // records time from input event to display of the frame which processed it
+    void RecordLatency(uint64_t latency)
+    {
+        p_latency.Record(latency);
+    }
+
+    // writes report if interval passed since last one, time is in seconds
+    void Flush(double time)
+    {
+        if (!active() || time - p_last_flush < p_interval) {
+            return;
+        }
+
+        // whole report is formatted on stack, nothing is allocated
+        char report[2048];
+        size_t length = 0;
+
+        length += Format(
+            report + length, sizeof(report) - length,
+            "{\"time\":%.3f,\"frames\":%llu,", time, (unsigned long long)p_frame.count()
+        );
+        length += FormatHistogram(report + length, sizeof(report) - length, "frame", p_frame);
+        for (int phase = 0; phase < TELEMETRY_PHASE_COUNT; ++phase) {
+            length += FormatHistogram(
+                report + length, sizeof(report) - length,
+                TELEMETRY_PHASE_NAMES[phase], p_phases[phase]
+            );
+        }
+        length += FormatHistogram(report + length, sizeof(report) - length, "latency", p_latency);
+        length += Format(
+            report + length, sizeof(report) - length,
+            "\"events_max\":%llu,\"events_dropped\":%llu,\"reports_dropped\":%llu}\n",
+            (unsigned long long)p_event_max, (unsigned long long)p_event_dropped,
+            (unsigned long long)p_reports_dropped
+        );
+
+        Write(report, length);
+
+        p_frame.Reset();
+        for (int phase = 0; phase < TELEMETRY_PHASE_COUNT; ++phase) {
+            p_phases[phase].Reset();
+        }
+        p_latency.Reset();
+        p_event_max = 0;
+        p_event_dropped = 0;
+        p_last_flush = time;
+    }
+
+private:
+    static size_t Format(char *buffer, size_t size, const char *format, ...)
+    {
+        va_list va;
+        va_start(va, format);
+        int result = vsnprintf(buffer, size, format, va);
+        va_end(va);
+
+        if (result < 0) {
+            return 0;
+        }
+        return size_t(result) < size ? size_t(result) : size - 1;
+    }
+
+    static size_t FormatHistogram(char *buffer, size_t size, const char *name, const Histogram &histogram)
+    {
+        return Format(
+            buffer, size,
+            "\"%s\":{\"count\":%llu,\"min\":%llu,\"mean\":%.1f,"
+            "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu},",
+            name,
+            (unsigned long long)histogram.count(),
+            (unsigned long long)histogram.min(),
+            histogram.mean(),
+            (unsigned long long)histogram.Percentile(0.5),
+            (unsigned long long)histogram.Percentile(0.9),
+            (unsigned long long)histogram.Percentile(0.99),
+            (unsigned long long)histogram.Percentile(0.999),
+            (unsigned long long)histogram.max()
+        );
+    }
+
+    void Write(const char *data, size_t size)
+    {
+        if (p_file) {
+            fwrite(data, 1, size, p_file);
+            fflush(p_file);
+            return;
+        }
+
+#if !defined(_WIN32)
+        // listener could go away and come back, reconnect on next report
+        if (p_socket < 0 && !Connect()) {
+            return;
+        }
+
+        // listener which doesn't read fills socket buffer, report is dropped
+        // then, partly sent report would break line framing, so connection
+        // starts over with next report
+        ssize_t sent = send(p_socket, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent == ssize_t(size)) {
+            p_reports_dropped = 0;
+            return;
+        }
+
+        ++p_reports_dropped;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        close(p_socket);
+        p_socket = -1;
+#endif
+    }
+
+#if !defined(_WIN32)
+    bool Connect()
+    {
+        p_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (p_socket < 0) {
+            return false;
+        }
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof(address.sun_path), "%s", p_socket_path);
+
+        if (connect(p_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            close(p_socket);
+            p_socket = -1;
+            return false;
+        }
+
+        return true;
+    }
+#endif
+
+private:
+    FILE     *p_file;
+    int       p_socket;
+    char      p_socket_path[108];
+    double    p_interval;
+    double    p_last_flush;
+
+    Histogram p_frame;
+    Histogram p_phases[TELEMETRY_PHASE_COUNT];
+    Histogram p_latency;
+    size_t    p_event_max;
+    size_t    p_event_dropped;
+    size_t    p_reports_dropped; // reports not written since last written one
+};
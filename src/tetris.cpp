@@ -42,7 +42,8 @@
                                                    +-------------------------------------+
 */
 
-#include <cstdlib>
+#include <cstring>
+#include <cmath>
 #include "engine/engine.h"
 #include "platform/platform.h"
 
@@ -57,7 +58,8 @@ enum FigureType
     RightL,
     LeftZ,
     RightZ,
-    T
+    T,
+    FigureTypeCount
 };
 
 class Figure
@@ -65,6 +67,7 @@ class Figure
 public:
     Figure() :
         p_type(None),
+        p_rotation(0),
         p_width(0),
         p_height(0)
     {}
@@ -72,6 +75,7 @@ public:
     void Make(FigureType type)
     {
         p_type = type;
+        p_rotation = 0;
         switch (type) {
             case Stick:
                 p_width = 1;
@@ -159,14 +163,16 @@ public:
         for (int n = 0; n < 6; ++n) {
             p_data[n] = newdata[n];
         }
+
+        p_rotation = (p_rotation + 1) & 3;
     }
 
-    void Render(GraphicsAPI &api, float xpos, float ypos, float block_size) const
+    void Render(RectangleBatch &batch, float xpos, float ypos, float block_size) const
     {
         int cell = 0;
         for (int y = 0; y < p_height; ++y) {
             for (int x = 0; x < p_width; ++x) {
-                api.Rectangle(
+                batch.Rectangle(
                     xpos + x * block_size, ypos + y * block_size,
                     block_size - 2, block_size - 2, p_data[cell++]
                 );
@@ -174,170 +180,1352 @@ public:
         }
     }
 
-    FigureType type() const { return p_type; }
-    int width() const { return p_width; }
-    int height() const { return p_height; }
-    Color data(int x, int y) const { return p_data[x + y * p_width]; }
+    // renders figure bricks with single color, used to show where figure lands
+    void RenderGhost(RectangleBatch &batch, float xpos, float ypos, float block_size, const Color &color) const
+    {
+        int cell = 0;
+        for (int y = 0; y < p_height; ++y) {
+            for (int x = 0; x < p_width; ++x) {
+                if (p_data[cell++].a > 0) {
+                    batch.Rectangle(
+                        xpos + x * block_size, ypos + y * block_size,
+                        block_size - 2, block_size - 2, color
+                    );
+                }
+            }
+        }
+    }
+
+    FigureType type() const { return p_type; }
+    int rotation() const { return p_rotation; }
+    int width() const { return p_width; }
+    int height() const { return p_height; }
+    Color data(int x, int y) const { return p_data[x + y * p_width]; }
+
+    // filled cells of figure row as bit mask, bit 0 is leftmost cell
+    uint32_t row(int y) const
+    {
+        uint32_t mask = 0;
+        for (int x = 0; x < p_width; ++x) {
+            if (p_data[x + y * p_width].a > 0) {
+                mask |= 1u << x;
+            }
+        }
+        return mask;
+    }
+
+private:
+    FigureType p_type;
+    int        p_rotation; // how many times figure was flipped
+    int        p_width;
+    int        p_height;
+    Color      p_data[6];
+};
+
+
+// figure shape data needed to compute where it lands
+struct FigureProfile
+{
+    int width;
+    int height;
+    int bottom[4]; // lowest filled cell of every figure column
+};
+
+// all figure shapes in all rotations are built once and then just copied
+// or rendered from here
+struct FigureShapes
+{
+    FigureShapes()
+    {
+        for (int type = None; type < FigureTypeCount; ++type) {
+            Figure figure;
+            figure.Make(FigureType(type));
+
+            rotations[type] = 0;
+            for (int rotation = 0; rotation < 4; ++rotation) {
+                figures[type][rotation] = figure;
+
+                FigureProfile &profile = profiles[type][rotation];
+                profile.width = figure.width();
+                profile.height = figure.height();
+                for (int x = 0; x < figure.width(); ++x) {
+                    profile.bottom[x] = 0;
+                    for (int y = 0; y < figure.height(); ++y) {
+                        if (figure.data(x, y).a > 0) {
+                            profile.bottom[x] = y;
+                        }
+                    }
+                }
+
+                // count rotations giving different shapes, like 1 for Box
+                bool unique = true;
+                for (int prev = 0; prev < rotation && unique; ++prev) {
+                    unique = !SameShape(figures[type][prev], figure);
+                }
+                if (unique) {
+                    rotations[type] = rotation + 1;
+                }
+
+                figure.Flip();
+            }
+        }
+    }
+
+    static bool SameShape(const Figure &a, const Figure &b)
+    {
+        if (a.width() != b.width() || a.height() != b.height()) {
+            return false;
+        }
+        for (int y = 0; y < a.height(); ++y) {
+            if (a.row(y) != b.row(y)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Figure        figures[FigureTypeCount][4];
+    FigureProfile profiles[FigureTypeCount][4];
+    int           rotations[FigureTypeCount]; // distinct rotations are first ones
+};
+
+static const FigureShapes &AllFigureShapes()
+{
+    static const FigureShapes shapes;
+    return shapes;
+}
+
+static const Figure &FigureShape(FigureType type, int rotation = 0)
+{
+    return AllFigureShapes().figures[type][rotation];
+}
+
+
+// landing rows of a figure dropped from above the field, for every
+// rotation and column at once
+enum PlacementConstants
+{
+    PLACEMENT_INVALID = -128 // figure doesn't fit horizontally at this column
+};
+
+struct Placements
+{
+    int    rotations;  // number of distinct rotations, only these are filled
+    int8_t rows[4][32]; // figure top row at [rotation][column]
+};
+
+// landing row for figure column c at field column x + c is
+// top[x + c] - 1 - bottom[c], figure lands at the smallest of these over all
+// its columns, so only column tops of the field are needed
+static void ComputePlacements(const uint32_t *rows, int width, int height, FigureType type, Placements &result)
+{
+    const FigureShapes &shapes = AllFigureShapes();
+    result.rotations = shapes.rotations[type];
+
+#if defined(ENGINE_SSE2)
+    if (width <= 16 && height < 120) {
+        // column tops of all 16 columns at once, one byte per column,
+        // empty column gets top equal to field height
+        const __m128i bits = _mm_setr_epi8(
+            1, 2, 4, 8, 16, 32, 64, -128,
+            1, 2, 4, 8, 16, 32, 64, -128
+        );
+        const __m128i ones = _mm_set1_epi8(-1);
+
+        __m128i top = _mm_set1_epi8(char(height));
+        for (int y = height - 1; y >= 0; --y) {
+            // expand row bits into bytes and replace tops of filled columns
+            __m128i row = _mm_unpacklo_epi64(
+                _mm_set1_epi8(char(rows[y] & 0xFF)),
+                _mm_set1_epi8(char((rows[y] >> 8) & 0xFF))
+            );
+            __m128i filled = _mm_cmpeq_epi8(_mm_and_si128(row, bits), bits);
+            top = _mm_min_epu8(top, _mm_or_si128(_mm_andnot_si128(filled, ones), _mm_set1_epi8(char(y))));
+        }
+
+        // landing rows are kept biased to stay unsigned for _mm_min_epu8
+        const int BIAS = 8;
+        for (int rotation = 0; rotation < result.rotations; ++rotation) {
+            const FigureProfile &profile = shapes.profiles[type][rotation];
+
+            __m128i land = _mm_set1_epi8(127);
+            for (int c = 0; c < profile.width; ++c) {
+                // lane x gets top of column x + c
+                __m128i shifted;
+                switch (c) {
+                    case 0:  shifted = top; break;
+                    case 1:  shifted = _mm_srli_si128(top, 1); break;
+                    case 2:  shifted = _mm_srli_si128(top, 2); break;
+                    default: shifted = _mm_srli_si128(top, 3); break;
+                }
+                shifted = _mm_add_epi8(shifted, _mm_set1_epi8(char(BIAS - 1 - profile.bottom[c])));
+                land = _mm_min_epu8(land, shifted);
+            }
+
+            uint8_t lanes[16];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), land);
+
+            int8_t *out = result.rows[rotation];
+            for (int x = 0; x < width; ++x) {
+                out[x] = x + profile.width <= width ? int8_t(lanes[x] - BIAS) : int8_t(PLACEMENT_INVALID);
+            }
+        }
+
+        return;
+    }
+#endif
+
+    int top[32];
+    for (int x = 0; x < width; ++x) {
+        top[x] = height;
+    }
+    for (int y = height - 1; y >= 0; --y) {
+        for (uint32_t row = rows[y]; row; row &= row - 1) {
+            top[BitScan(row)] = y;
+        }
+    }
+
+    for (int rotation = 0; rotation < result.rotations; ++rotation) {
+        const FigureProfile &profile = shapes.profiles[type][rotation];
+        int8_t *out = result.rows[rotation];
+
+        for (int x = 0; x < width; ++x) {
+            if (x + profile.width > width) {
+                out[x] = PLACEMENT_INVALID;
+                continue;
+            }
+
+            int land = height;
+            for (int c = 0; c < profile.width; ++c) {
+                int candidate = top[x + c] - 1 - profile.bottom[c];
+                land = candidate < land ? candidate : land;
+            }
+            out[x] = int8_t(land);
+        }
+    }
+}
+
+
+// fixed capacity ring queue of upcoming figures
+class FigureQueue
+{
+public:
+    enum { CAPACITY = 8 };
+
+    FigureQueue() :
+        p_head(0),
+        p_count(0)
+    {}
+
+    void Clear()
+    {
+        p_head = 0;
+        p_count = 0;
+    }
+
+    void Push(FigureType type)
+    {
+        if (p_count < CAPACITY) {
+            p_items[(p_head + p_count) % CAPACITY] = type;
+            ++p_count;
+        }
+    }
+
+    FigureType Pop()
+    {
+        if (p_count == 0) {
+            return None;
+        }
+
+        FigureType type = p_items[p_head];
+        p_head = (p_head + 1) % CAPACITY;
+        --p_count;
+        return type;
+    }
+
+    // index 0 is the figure which comes next
+    FigureType Peek(int index) const
+    {
+        return index < p_count ? p_items[(p_head + index) % CAPACITY] : None;
+    }
+
+    int count() const { return p_count; }
+
+    // queue from outside (loaded state) has all its fields in range and
+    // only real figures in it
+    bool Valid() const
+    {
+        if (p_head < 0 || p_head >= CAPACITY || p_count < 0 || p_count > CAPACITY) {
+            return false;
+        }
+        for (int index = 0; index < p_count; ++index) {
+            FigureType type = p_items[(p_head + index) % CAPACITY];
+            if (type <= None || type >= FigureTypeCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    FigureType p_items[CAPACITY];
+    int        p_head;
+    int        p_count;
+};
+
+
+// board features used to evaluate positions
+struct FieldFeatures
+{
+    int holes;     // empty cells with filled cells above them
+    int height;    // sum of all column heights
+    int bumpiness; // sum of height differences of neighbour columns
+    int top;       // height of highest column
+
+    uint64_t Pack() const
+    {
+        return
+            uint64_t(uint16_t(holes)) |
+            uint64_t(uint16_t(height)) << 16 |
+            uint64_t(uint16_t(bumpiness)) << 32 |
+            uint64_t(uint16_t(top)) << 48;
+    }
+
+    static FieldFeatures Unpack(uint64_t packed)
+    {
+        FieldFeatures features;
+        features.holes = int(packed & 0xFFFF);
+        features.height = int((packed >> 16) & 0xFFFF);
+        features.bumpiness = int((packed >> 32) & 0xFFFF);
+        features.top = int(packed >> 48);
+        return features;
+    }
+};
+
+// computes field features from occupancy rows in single top to bottom pass
+static FieldFeatures AnalyzeField(const uint32_t *rows, int width, int height)
+{
+    FieldFeatures features = {};
+
+    int columns[32] = {};
+    uint32_t seen = 0;
+    for (int y = 0; y < height; ++y) {
+        // every empty cell below first filled cell in column is a hole
+        features.holes += BitCount(seen & ~rows[y]);
+
+        uint32_t newcells = rows[y] & ~seen;
+        for (int x = 0; newcells; ++x, newcells >>= 1) {
+            if (newcells & 1) {
+                columns[x] = height - y;
+            }
+        }
+        seen |= rows[y];
+    }
+
+    for (int x = 0; x < width; ++x) {
+        features.height += columns[x];
+        features.top = columns[x] > features.top ? columns[x] : features.top;
+        if (x > 0) {
+            int difference = columns[x] - columns[x - 1];
+            features.bumpiness += difference < 0 ? -difference : difference;
+        }
+    }
+
+    return features;
+}
+
+
+// line removal and lock effects timings
+static const float FLASH_TIME = 0.15f;        // removed row flash, in seconds
+static const float COLLAPSE_SPEED = 40.0f;    // rows per second
+static const float PARTICLE_GRAVITY = 40.0f;  // cells per second^2
+
+// score for rows removed by one figure, multiplied by level
+static const int LINE_SCORES[5] = { 0, 40, 100, 300, 1200 };
+
+// garbage rows sent to opponent in versus mode for rows removed by one figure
+static const int LINE_ATTACKS[5] = { 0, 0, 1, 2, 4 };
+
+static const Color GARBAGE_COLOR = Color(110, 110, 110, 255);
+
+// delayed auto shift: held direction moves figure once on press, then after
+// delay it repeats at fixed rate, soft drop repeats at its rate right away
+// timings are in milliseconds of input event clock
+static const uint32_t SHIFT_DELAY = 150;
+static const uint32_t SHIFT_REPEAT = 33;
+static const uint32_t SOFT_DROP_REPEAT = 33;
+
+enum GameShift
+{
+    SHIFT_LEFT,
+    SHIFT_RIGHT,
+    SHIFT_DOWN,
+    SHIFT_COUNT
+};
+
+// inputs which could hold shift direction, direction is held while any
+// of them holds it
+enum ShiftSource
+{
+    SHIFT_SOURCE_KEYBOARD = 1,
+    SHIFT_SOURCE_POV      = 2
+};
+
+// actions done once per press
+enum GameAction
+{
+    ACTION_FLIP,
+    ACTION_DROP,
+    ACTION_HOLD
+};
+
+// game sounds, synthesized when audio is loaded
+enum GameSound
+{
+    SOUND_MOVE,
+    SOUND_FLIP,
+    SOUND_LOCK,
+    SOUND_CLEAR,
+    SOUND_CLEAR_FOUR,
+    SOUND_GAME_OVER,
+    GAME_SOUND_COUNT
+};
+
+// piece of synthesized sound: frequency slides from start to end and
+// volume fades out, square or triangle wave
+struct SoundTone
+{
+    float start;
+    float end;
+    float duration;
+    bool  square;
+};
+
+struct SoundRecipe
+{
+    float     volume;
+    int       count;
+    SoundTone tones[4];
+};
+
+static const SoundRecipe SOUND_RECIPES[GAME_SOUND_COUNT] = {
+    { 0.3f, 1, { { 880, 880, 0.03f, true } } },
+    { 0.3f, 1, { { 660, 990, 0.05f, true } } },
+    { 0.8f, 1, { { 220, 110, 0.08f, false } } },
+    { 0.6f, 3, { { 523, 523, 0.08f, false }, { 659, 659, 0.08f, false }, { 784, 784, 0.12f, false } } },
+    { 0.7f, 4, { { 523, 523, 0.1f, true }, { 659, 659, 0.1f, true }, { 784, 784, 0.1f, true }, { 1047, 1047, 0.25f, true } } },
+    { 0.7f, 1, { { 440, 110, 0.8f, true } } }
+};
+
+// writes sound samples, returns their count, samples should have room
+// for whole sound
+static size_t SynthesizeSound(const SoundRecipe &recipe, float *samples)
+{
+    size_t count = 0;
+    for (int n = 0; n < recipe.count; ++n) {
+        const SoundTone &tone = recipe.tones[n];
+        size_t length = size_t(tone.duration * AUDIO_SAMPLE_RATE);
+        float phase = 0;
+
+        for (size_t sample = 0; sample < length; ++sample) {
+            float t = float(sample) / float(length);
+            phase += (tone.start + (tone.end - tone.start) * t) / AUDIO_SAMPLE_RATE;
+            phase -= float(int(phase));
+
+            float wave = tone.square ?
+                (phase < 0.5f ? 1.0f : -1.0f) :
+                (phase < 0.5f ? 4 * phase - 1 : 3 - 4 * phase);
+
+            samples[count++] = wave * recipe.volume * (1 - t);
+        }
+    }
+    return count;
+}
+
+// game state saved by Game::SaveState(), field cells and rows follow it
+// state is raw memory, so it could be loaded only by same build (same as
+// replays), effects and cached data aren't saved
+struct GameStateHeader
+{
+    int32_t     width;
+    int32_t     height;
+    float       mouse_x;
+    float       mouse_y;
+    uint64_t    hash;
+    uint64_t    random;
+    Figure      figure;
+    int32_t     figure_x;
+    int32_t     figure_y;
+    FigureQueue queue;
+    FigureType  hold;
+    int32_t     hold_used;
+    int32_t     lines;
+    int32_t     score;
+    float       fall_timer;
+    float       fall_speed;
+    int32_t     show_perf;
+    int32_t     paused;
+    int32_t     garbage;
+    int32_t     garbage_hole;
+    int32_t     attack;
+    uint32_t    shift_held[SHIFT_COUNT];
+    uint32_t    shift_next[SHIFT_COUNT];
+    int32_t     shift_last;
+    uint32_t    input_clock;
+    int32_t     input_clock_set;
+    float       input_clock_fraction;
+    uint32_t    action_keys;
+};
+
+// text shown around the field, labels live in game arena and keep their
+// layout between frames
+struct GameHud
+{
+    enum { GLYPH_CAPACITY = 9 * TextLabel::CAPACITY };
+
+    TextLabel score_caption;
+    TextLabel score;
+    TextLabel lines_caption;
+    TextLabel lines;
+    TextLabel level_caption;
+    TextLabel level;
+    TextLabel paused;
+
+    // performance overlay, toggled with F3
+    TextLabel fps;
+    TextLabel frame;
+
+    GlyphQuad glyphs[GLYPH_CAPACITY];
+};
+
+
+// game field size, for standard boards it's compile time constant, so field
+// loops have constant bounds and strides and could be unrolled
+// zero size means size is given at run time
+template <int WIDTH, int HEIGHT>
+class FieldSize
+{
+public:
+    static_assert(WIDTH >= 4 && WIDTH <= 32 && HEIGHT >= 4 && HEIGHT <= 64, "unsupported field size");
+
+    FieldSize(int, int) {}
+
+    int width() const { return WIDTH; }
+    int height() const { return HEIGHT; }
+};
+
+template <>
+class FieldSize<0, 0>
+{
+public:
+    // rows are 32 bit masks and placement rows are 8 bit,
+    // any figure should fit into field
+    FieldSize(int width, int height) :
+        p_width(width < 4 ? 4 : (width > 32 ? 32 : width)),
+        p_height(height < 4 ? 4 : (height > 64 ? 64 : height))
+    {}
+
+    int width() const { return p_width; }
+    int height() const { return p_height; }
+
+private:
+    int p_width;
+    int p_height;
+};
+
+
+// game class, field size is template parameter, so standard board gets
+// code specialized for its size, zero size board takes size at run time
+// (see Game and CustomGame below)
+template <int WIDTH, int HEIGHT>
+class BasicGame
+{
+public:
+    enum
+    {
+        FIELD_WIDTH  = WIDTH,
+        FIELD_HEIGHT = HEIGHT,
+
+        // effect particles alive at once, more are just not emitted
+        PARTICLE_CAPACITY = 512,
+
+        // rectangles drawn by RenderBoard() for fixed size board: field
+        // cells with background, row flashes, figure with ghost and particles
+        BOARD_RECTANGLES = FIELD_WIDTH * FIELD_HEIGHT * 2 + FIELD_HEIGHT + 6 * 2 + PARTICLE_CAPACITY
+    };
+
+    // game which allocates its memory by itself, width and height are
+    // used only by run time sized board
+    BasicGame(uint64_t seed = 0, int width = WIDTH, int height = HEIGHT) :
+        p_mouse_x(0),
+        p_mouse_y(0),
+
+        p_size(width, height),
+        p_field_margin(50),
+
+        p_memory(new uint8_t[MemorySize(width, height)]),
+        p_effects(true)
+    {
+        Arena arena(p_memory, MemorySize(width, height));
+        Allocate(arena);
+        Reset(seed);
+    }
+
+    // game with all its data placed into caller supplied arena, arena should
+    // have at least MemorySize() bytes free (with 16 byte aligned memory block)
+    // and memory stays owned by caller
+    BasicGame(Arena &arena, uint64_t seed = 0, int width = WIDTH, int height = HEIGHT) :
+        p_mouse_x(0),
+        p_mouse_y(0),
+
+        p_size(width, height),
+        p_field_margin(50),
+
+        p_memory(nullptr),
+        p_effects(true)
+    {
+        Allocate(arena);
+        Reset(seed);
+    }
+
+    ~BasicGame()
+    {
+        delete[] p_memory;
+    }
+
+    // how much memory game needs besides game object itself
+    static size_t MemorySize(int width = WIDTH, int height = HEIGHT)
+    {
+        FieldSize<WIDTH, HEIGHT> size(width, height);
+        return
+            Arena::Align(sizeof(Color) * size.width() * size.height()) +
+            Arena::Align(sizeof(uint32_t) * size.height()) +
+            Arena::Align(sizeof(ColoredRectangle) * RectangleCapacity(size)) +
+            Arena::Align(sizeof(float) * size.height()) * 2 +
+            ParticlePool::MemorySize(PARTICLE_CAPACITY) +
+            Arena::Align(sizeof(GameHud));
+    }
+
+    // rectangles drawn by RenderBoard(), same as BOARD_RECTANGLES
+    // but for any board
+    static size_t BoardRectangles(int width, int height)
+    {
+        return size_t(width * height * 2 + height + 6 * 2 + PARTICLE_CAPACITY);
+    }
+
+    // starts new game on already allocated memory, no allocations happen here,
+    // so same game object could be reused for any number of games
+    void Reset(uint64_t seed)
+    {
+        for (int cell = 0; cell < p_size.width() * p_size.height(); ++cell) {
+            p_field[cell] = Color(0, 0, 0, 0);
+        }
+        for (int y = 0; y < p_size.height(); ++y) {
+            p_rows[y] = 0;
+        }
+        p_hash = 0;
+
+        p_hold = None;
+        p_hold_used = false;
+        p_landing_type = None;
+        p_landing_valid = false;
+
+        p_lines = 0;
+        p_score = 0;
+        p_game_overs = 0;
+        p_garbage = 0;
+        p_garbage_hole = 0;
+        p_attack = 0;
+        for (int shift = 0; shift < SHIFT_COUNT; ++shift) {
+            p_shift_held[shift] = 0;
+            p_shift_next[shift] = 0;
+        }
+        p_shift_last = SHIFT_LEFT;
+        p_input_clock = 0;
+        p_input_clock_set = false;
+        p_input_clock_fraction = 0;
+        p_action_keys = 0;
+        p_fall_timer = 0;
+        p_fall_speed = 1;
+        p_random.Seed(seed);
+
+        p_frame_time = 0;
+        p_show_perf = false;
+        p_paused = false;
+        p_redraw = true;
+        p_sounds = 0;
+        p_sound_pan = 0;
+
+        // effects have their own generator, so they never change the game
+        p_effects_random.Seed(~seed);
+        ClearEffects();
+
+        // queue is always kept full, so there's always enough figures
+        // to look ahead
+        p_queue.Clear();
+        while (p_queue.count() < FigureQueue::CAPACITY) {
+            p_queue.Push(RandomFigure());
+        }
+
+        SpawnFigure(p_queue.Pop());
+    }
+
+    void ProcessInput(PlatformAPI &api, const Input &input)
+    {
+        // check for ESC key for quit
+        if (input.keyboard.keys[KEY_ESCAPE]) {
+            api.Quit();
+        }
+
+        // copy mouse coords to internal fields so
+        // rectangle could follow mouse
+        if (p_mouse_x != float(input.mouse.x) || p_mouse_y != float(input.mouse.y)) {
+            p_mouse_x = float(input.mouse.x);
+            p_mouse_y = float(input.mouse.y);
+            p_redraw = true;
+        }
+
+        int oldx = p_figure_x;
+        int oldrotation = p_figure.rotation();
+
+        // events are applied one by one in their order, so every press
+        // counts, held directions repeat by event timestamps (see Shift*())
+        for (size_t ev = 0; ev < input.event_count; ++ev) {
+            const InputEvent &event = input.events[ev];
+            AdvanceInputClock(event.time);
+
+            switch (event.type) {
+                case INPUT_KEY_DOWN:
+                case INPUT_KEY_UP: {
+                    bool down = event.type == INPUT_KEY_DOWN;
+                    switch (event.keyboard.key) {
+                        case KEY_LEFT:  ShiftKey(SHIFT_LEFT, SHIFT_SOURCE_KEYBOARD, down, event.time); break;
+                        case KEY_RIGHT: ShiftKey(SHIFT_RIGHT, SHIFT_SOURCE_KEYBOARD, down, event.time); break;
+                        case KEY_DOWN:  ShiftKey(SHIFT_DOWN, SHIFT_SOURCE_KEYBOARD, down, event.time); break;
+                    }
+
+                    // other keys act on press only, os key repeat gives more
+                    // presses without release, those are ignored
+                    uint32_t bit = ActionKeyBit(event.keyboard.key);
+                    bool repeat = (p_action_keys & bit) != 0;
+                    p_action_keys = down ? p_action_keys | bit : p_action_keys & ~bit;
+                    if (!down || repeat) {
+                        break;
+                    }
+                    switch (event.keyboard.key) {
+                        case KEY_F3:    p_show_perf = !p_show_perf; p_redraw = true; break;
+                        case KEY_P:
+                        case KEY_PAUSE: SetPaused(!p_paused); break;
+                        case KEY_SPACE: Act(ACTION_DROP); break;
+                        case KEY_UP:    Act(ACTION_FLIP); break;
+                        case KEY_C:     Act(ACTION_HOLD); break;
+                    }
+                    break;
+                }
+
+                case INPUT_BUTTON_DOWN:
+                    switch (event.joystick.button) {
+                        case JOY_BUTTON_0: Act(ACTION_FLIP); break;
+                        case JOY_BUTTON_1: Act(ACTION_HOLD); break;
+                        case JOY_BUTTON_2: Act(ACTION_DROP); break;
+                        case JOY_BUTTON_7: SetPaused(!p_paused); break;
+                    }
+                    break;
+
+                // pov reports its new direction, directions it left are released
+                case INPUT_POV: {
+                    int value = event.joystick.pov.value;
+                    ShiftKey(SHIFT_LEFT, SHIFT_SOURCE_POV, value == JOY_DIRECTION_LEFT, event.time);
+                    ShiftKey(SHIFT_RIGHT, SHIFT_SOURCE_POV, value == JOY_DIRECTION_RIGHT, event.time);
+                    ShiftKey(SHIFT_DOWN, SHIFT_SOURCE_POV, value == JOY_DIRECTION_DOWN, event.time);
+                    if (value == JOY_DIRECTION_UP) {
+                        Act(ACTION_FLIP);
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (p_figure.rotation() != oldrotation) {
+            PlaySound(SOUND_FLIP);
+        } else if (p_figure_x != oldx) {
+            PlaySound(SOUND_MOVE);
+        }
+    }
+
+    // creates all game sounds, should be called once before game runs
+    void LoadAudio(AudioAPI &audio)
+    {
+        size_t capacity = 0;
+        for (int sound = 0; sound < GAME_SOUND_COUNT; ++sound) {
+            size_t length = 0;
+            for (int n = 0; n < SOUND_RECIPES[sound].count; ++n) {
+                length += size_t(SOUND_RECIPES[sound].tones[n].duration * AUDIO_SAMPLE_RATE);
+            }
+            capacity = length > capacity ? length : capacity;
+        }
+
+        float *samples = new float[capacity];
+        for (int sound = 0; sound < GAME_SOUND_COUNT; ++sound) {
+            size_t count = SynthesizeSound(SOUND_RECIPES[sound], samples);
+            audio.LoadSound(uint32_t(sound), samples, count);
+        }
+        delete[] samples;
+    }
+
+    // starts sounds of things happened since last call, called after update
+    // same way as RenderGraphics()
+    void RenderAudio(AudioAPI &audio)
+    {
+        for (int sound = 0; sound < GAME_SOUND_COUNT; ++sound) {
+            if (p_sounds & (1u << sound)) {
+                audio.Play(uint32_t(sound), 1.0f, p_sound_pan);
+            }
+        }
+        p_sounds = 0;
+    }
+
+    void Update(float interval)
+    {
+        // everything is frozen during pause, effects too, so nothing changes
+        // on screen and platform could stop rendering
+        if (p_paused) {
+            return;
+        }
+        p_redraw = true;
+
+        // smoothed frame time for performance overlay
+        p_frame_time += (interval - p_frame_time) * (p_frame_time > 0 ? 0.05f : 1.0f);
+
+        // input clock goes on between events, so held directions repeat
+        // without any new input, nothing is held before first event
+        if (p_input_clock_set) {
+            int oldx = p_figure_x;
+            p_input_clock_fraction += interval * 1000;
+            uint32_t elapsed = uint32_t(p_input_clock_fraction);
+            p_input_clock_fraction -= float(elapsed);
+            AdvanceInputClock(p_input_clock + elapsed);
+            if (p_figure_x != oldx) {
+                PlaySound(SOUND_MOVE);
+            }
+        }
+
+        p_fall_timer += p_fall_speed * interval;
+        if (p_fall_timer >= 1)  {
+            p_fall_timer -= 1;
+            MoveDown();
+        }
+
+        UpdateEffects(interval);
+    }
+
+    void RenderGraphics(GraphicsAPI &api, int width, int height)
+    {
+        api.Clear(Color(20, 40, 205));
+
+        // compute field pixel size
+        float block_size = float((height - p_field_margin * 2) / p_size.height());
+        float field_x = width / 2 - p_size.width() / 2 * block_size;
+        float field_y = float(p_field_margin);
+
+        // everything is collected into single batch and drawn at once
+        RectangleBatch batch(api, p_rectangles, RectangleCapacity(p_size));
+
+        RenderBoard(batch, field_x, field_y, block_size);
+
+        // render next figures at the right of the field and hold figure at the
+        // left, straight from prebuilt shapes
+        float preview_size = block_size * 0.6f;
+        float preview_x = field_x + (p_size.width() + 1) * block_size;
+        float preview_y = field_y;
+        for (int n = 0; n < PREVIEW_COUNT; ++n) {
+            const Figure &next = FigureShape(p_queue.Peek(n));
+            next.Render(batch, preview_x, preview_y, preview_size);
+            preview_y += (next.height() + 1) * preview_size;
+        }
+
+        if (p_hold != None) {
+            const Figure &hold = FigureShape(p_hold);
+            hold.Render(
+                batch, field_x - block_size - hold.width() * preview_size, field_y,
+                p_hold_used ? preview_size * 0.8f : preview_size
+            );
+        }
+
+        // tiny mouse rectangle, just to show mouse following
+        batch.Rectangle(p_mouse_x - 5, p_mouse_y - 5, 10, 10, Color(255, 255, 255));
+
+        batch.Flush();
+
+        RenderHud(api, field_x, field_y, block_size);
+        p_redraw = false;
+    }
+
+    // renders field with current figure and its ghost at given position,
+    // without clearing anything, so many games could be drawn on one screen
+    void RenderBoard(RectangleBatch &batch, float field_x, float field_y, float block_size)
+    {
+        // render field as set of boxes for now, bricks of collapsing rows
+        // are drawn above their place
+        int cell = 0;
+        for (int y = 0; y < p_size.height(); ++y) {
+            float brick_y = field_y + (y - p_row_offset[y]) * block_size;
+            for (int x = 0; x < p_size.width(); ++x) {
+                // field background
+                batch.Rectangle(
+                    field_x + x * block_size, field_y + y * block_size,
+                    block_size - 2, block_size - 2, Color(0, 0, 0, 20)
+                );
+
+                // field cell brick
+                batch.Rectangle(
+                    field_x + x * block_size, brick_y,
+                    block_size - 2, block_size - 2, p_field[cell++]
+                );
+            }
+        }
+
+        // flash over just removed rows
+        for (int y = 0; y < p_size.height(); ++y) {
+            if (p_row_flash[y] > 0) {
+                batch.Rectangle(
+                    field_x, field_y + y * block_size,
+                    p_size.width() * block_size - 2, block_size - 2,
+                    Color(255, 255, 255, uint8_t(255 * p_row_flash[y] / FLASH_TIME))
+                );
+            }
+        }
+
+        // render ghost of figure where it would land
+        p_figure.RenderGhost(
+            batch,
+            field_x + p_figure_x * block_size,
+            field_y + LandingRow() * block_size,
+            block_size, Color(255, 255, 255, 40)
+        );
+
+        // render figure
+        p_figure.Render(
+            batch,
+            field_x + p_figure_x * block_size,
+            field_y + p_figure_y * block_size,
+            block_size
+        );
+
+        // particles are in cells, centered at their position and fading out
+        float particle_size = block_size * 0.25f;
+        for (size_t n = 0; n < p_particles.count(); ++n) {
+            uint32_t tag = p_particles.tag(n);
+            batch.Rectangle(
+                field_x + p_particles.x(n) * block_size - particle_size / 2,
+                field_y + p_particles.y(n) * block_size - particle_size / 2,
+                particle_size, particle_size,
+                Color(tag & 0xFF, (tag >> 8) & 0xFF, (tag >> 16) & 0xFF, uint8_t(255 * p_particles.fade(n)))
+            );
+        }
+    }
+
+    // size of state written by SaveState()
+    size_t StateSize() const
+    {
+        return
+            sizeof(GameStateHeader) +
+            sizeof(Color) * p_size.width() * p_size.height() +
+            sizeof(uint32_t) * p_size.height();
+    }
+
+    // writes everything game needs to go on from current tick, state
+    // should have StateSize() bytes
+    void SaveState(uint8_t *state) const
+    {
+        GameStateHeader header = {};
+        header.width = p_size.width();
+        header.height = p_size.height();
+        header.mouse_x = p_mouse_x;
+        header.mouse_y = p_mouse_y;
+        header.hash = p_hash;
+        header.random = p_random.state();
+        header.figure = p_figure;
+        header.figure_x = p_figure_x;
+        header.figure_y = p_figure_y;
+        header.queue = p_queue;
+        header.hold = p_hold;
+        header.hold_used = p_hold_used;
+        header.lines = p_lines;
+        header.score = p_score;
+        header.fall_timer = p_fall_timer;
+        header.fall_speed = p_fall_speed;
+        header.show_perf = p_show_perf;
+        header.paused = p_paused;
+        header.garbage = p_garbage;
+        header.garbage_hole = p_garbage_hole;
+        header.attack = p_attack;
+        for (int shift = 0; shift < SHIFT_COUNT; ++shift) {
+            header.shift_held[shift] = p_shift_held[shift];
+            header.shift_next[shift] = p_shift_next[shift];
+        }
+        header.shift_last = p_shift_last;
+        header.input_clock = p_input_clock;
+        header.input_clock_set = p_input_clock_set;
+        header.input_clock_fraction = p_input_clock_fraction;
+        header.action_keys = p_action_keys;
+
+        size_t fieldsize = sizeof(Color) * p_size.width() * p_size.height();
+        memcpy(state, &header, sizeof(header));
+        memcpy(state + sizeof(header), p_field, fieldsize);
+        memcpy(state + sizeof(header) + fieldsize, p_rows, sizeof(uint32_t) * p_size.height());
+    }
+
+    // restores state written by SaveState(), fails if state is for
+    // different field size or isn't a state game could be in (state could
+    // come from damaged or forged file), game isn't changed then, no
+    // allocations happen here
+    bool LoadState(const uint8_t *state)
+    {
+        GameStateHeader header;
+        memcpy(&header, state, sizeof(header));
+        if (header.width != p_size.width() || header.height != p_size.height()) {
+            return false;
+        }
+
+        size_t fieldsize = sizeof(Color) * p_size.width() * p_size.height();
+        if (!ValidState(header, state + sizeof(header), state + sizeof(header) + fieldsize)) {
+            return false;
+        }
+
+        memcpy(p_field, state + sizeof(header), fieldsize);
+        memcpy(p_rows, state + sizeof(header) + fieldsize, sizeof(uint32_t) * p_size.height());
+
+        p_mouse_x = header.mouse_x;
+        p_mouse_y = header.mouse_y;
+        p_hash = header.hash;
+        p_random.Seed(header.random);
+        p_figure = FigureShape(header.figure.type(), header.figure.rotation());
+        p_figure_x = header.figure_x;
+        p_figure_y = header.figure_y;
+        p_queue = header.queue;
+        p_hold = header.hold;
+        p_hold_used = header.hold_used != 0;
+        p_lines = header.lines;
+        p_score = header.score;
+        p_fall_timer = header.fall_timer;
+        p_fall_speed = header.fall_speed;
+        p_show_perf = header.show_perf != 0;
+        p_paused = header.paused != 0;
+        p_redraw = true;
+        p_garbage = header.garbage;
+        p_garbage_hole = header.garbage_hole;
+        p_attack = header.attack;
+        for (int shift = 0; shift < SHIFT_COUNT; ++shift) {
+            p_shift_held[shift] = header.shift_held[shift];
+            p_shift_next[shift] = header.shift_next[shift];
+        }
+        p_shift_last = header.shift_last;
+        p_input_clock = header.input_clock;
+        p_input_clock_set = header.input_clock_set != 0;
+        p_input_clock_fraction = header.input_clock_fraction;
+        p_action_keys = header.action_keys;
+
+        p_landing_valid = false;
+        p_sounds = 0;
+        p_effects_random.Seed(~header.random);
+        ClearEffects();
+        return true;
+    }
+
+    // game code was reloaded while game state was kept, drop everything
+    // computed from code rather than state
+    void Reloaded()
+    {
+        p_landing_valid = false;
+        p_redraw = true;
+    }
+
+    // platform pauses game when its window goes to background, game is
+    // resumed only by player
+    void SetPaused(bool paused)
+    {
+        if (paused != p_paused) {
+            p_paused = paused;
+            p_redraw = true;
+
+            // keys held before pause don't repeat after it
+            for (int shift = 0; shift < SHIFT_COUNT; ++shift) {
+                p_shift_held[shift] = 0;
+            }
+        }
+    }
+
+    bool paused() const { return p_paused; }
+
+    // particles are only shown, games nobody looks at could skip them,
+    // game itself doesn't change either way
+    void SetEffects(bool effects) { p_effects = effects; }
+
+    // puts current figure with given rotation at given column right above
+    // the field, moves it down row by row until it collides and locks it
+    // there, same collision and lock paths falling figure takes, but without
+    // input and timers, so board benchmark could time just them
+    // figure which doesn't fit there stays as it was, false is returned then
+    bool Place(int rotation, int x)
+    {
+        FigureType type = p_figure.type();
+        if (type == None || rotation < 0 || rotation >= AllFigureShapes().rotations[type]) {
+            return false;
+        }
+
+        Figure figure = p_figure;
+        int figurex = p_figure_x;
+        int figurey = p_figure_y;
+
+        p_figure = FigureShape(type, rotation);
+        p_figure_x = x;
+        p_figure_y = -p_figure.height();
+        if (Collide(p_figure_x, p_figure_y)) {
+            p_figure = figure;
+            p_figure_x = figurex;
+            p_figure_y = figurey;
+            return false;
+        }
+
+        while (!Collide(p_figure_x, p_figure_y + 1)) {
+            ++p_figure_y;
+        }
+        PutFigureInTheWall();
+        return true;
+    }
+
+    // nothing changed since last RenderGraphics(), and nothing is going
+    // to change until new input comes, platform could wait for input then
+    bool idle() const { return p_paused && !p_redraw; }
+
+    // field analysis for bots, cache (if any) is used to skip analysis
+    // of already seen fields
+    FieldFeatures Features(HashCache *cache = nullptr) const
+    {
+        uint64_t packed;
+        if (cache && cache->Lookup(p_hash, packed)) {
+            return FieldFeatures::Unpack(packed);
+        }
+
+        FieldFeatures features = AnalyzeField(p_rows, p_size.width(), p_size.height());
+        if (cache) {
+            cache->Store(p_hash, features.Pack());
+        }
+        return features;
+    }
+
+    // landing rows for all rotations and columns of given figure
+    void GetPlacements(FigureType type, Placements &result) const
+    {
+        ComputePlacements(p_rows, p_size.width(), p_size.height(), type, result);
+    }
 
-private:
-    FigureType p_type;
-    int        p_width;
-    int        p_height;
-    Color      p_data[6];
-};
+    // Zobrist style key of a row with given content, computed instead of
+    // taken from table, empty row has zero key, so empty field hash is zero
+    // field hash is xor of keys of all its rows
+    static uint64_t RowKey(int y, uint32_t row)
+    {
+        if (row == 0) {
+            return 0;
+        }
 
+        uint64_t z = (uint64_t(y) << 32 | row) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
 
-// game class
-class Game
-{
-public:
-    Game() :
-        p_mouse_x(0),
-        p_mouse_y(0),
+    int field_width() const { return p_size.width(); }
+    int field_height() const { return p_size.height(); }
+    const uint32_t *field_rows() const { return p_rows; }
+    uint64_t field_hash() const { return p_hash; }
+
+    const Figure &figure() const { return p_figure; }
+    int figure_x() const { return p_figure_x; }
+    int figure_y() const { return p_figure_y; }
+
+    const FigureQueue &queue() const { return p_queue; }
+    FigureType hold() const { return p_hold; }
+    int lines() const { return p_lines; }
+    int score() const { return p_score; }
+    int level() const { return p_lines / 10 + 1; }
+
+    // how many times game was over since Reset(), game starts over by itself,
+    // so this is the only way to see the end of a game
+    int game_overs() const { return p_game_overs; }
+
+    // versus mode: garbage rows with a hole at given column come up from
+    // the bottom when next figure locks, rows removed by that figure cancel
+    // them first, pending rows share hole of the first ones
+    void QueueGarbage(int count, int hole)
+    {
+        if (p_garbage == 0) {
+            p_garbage_hole = hole < 0 ? 0 : (hole < p_size.width() ? hole : p_size.width() - 1);
+        }
 
-        p_field_width(10),
-        p_field_height(20),
-        p_field_margin(50),
+        p_garbage += count;
+        p_garbage = p_garbage < p_size.height() ? p_garbage : p_size.height();
+    }
+
+    // garbage rows to send to opponent since last call
+    int TakeAttack()
+    {
+        int attack = p_attack;
+        p_attack = 0;
+        return attack;
+    }
 
-        p_figure_x(4),
-        p_figure_y(0),
+    int garbage() const { return p_garbage; }
 
-        p_lines(0),
-        p_fall_timer(0),
-        p_fall_speed(1)
+private:
+    enum
     {
-        p_field = new Color[p_field_width * p_field_height];
-        for (int cell = 0; cell < p_field_width * p_field_height; ++cell) {
-            p_field[cell] = Color(0, 0, 0, 0);
-        }
+        // how many figures from queue are shown
+        PREVIEW_COUNT = 5
+    };
 
-        p_figure.Make(LeftL);
-    }
+    BasicGame(const BasicGame&);
+    BasicGame &operator=(const BasicGame&);
 
-    ~Game()
+    // rectangles drawn by RenderGraphics(): board, previews, hold and
+    // mouse rectangle
+    static size_t RectangleCapacity(const FieldSize<WIDTH, HEIGHT> &size)
     {
-        delete[] p_field;
+        return BoardRectangles(size.width(), size.height()) + PREVIEW_COUNT * 6 + 6 + 1;
     }
 
-    void ProcessInput(PlatformAPI &api, const Input &input)
+    // checks every loaded field which ends up as index or size: figure and
+    // its place, queue, hold, garbage, repeat state, and that field rows
+    // and hash match field cells, with that game can't get out of its data
+    // whatever else state has
+    bool ValidState(const GameStateHeader &header, const uint8_t *field, const uint8_t *rows) const
     {
-        // check for ESC key for quit
-        if (input.keyboard.keys[KEY_ESCAPE]) {
-            api.Quit();
+        int width = p_size.width();
+        int height = p_size.height();
+
+        // figure is taken from shapes, saved one should be exactly that
+        FigureType type = header.figure.type();
+        int rotation = header.figure.rotation();
+        if (type <= None || type >= FigureTypeCount || rotation < 0 || rotation > 3) {
+            return false;
+        }
+        const Figure &shape = FigureShape(type, rotation);
+        if (!FigureShapes::SameShape(header.figure, shape)) {
+            return false;
         }
 
-        // copy mouse coords to internal fields so
-        // rectangle could follow mouse
-        p_mouse_x = float(input.mouse.x);
-        p_mouse_y = float(input.mouse.y);
+        // figure is anywhere from right above the field down to its bottom
+        if (header.figure_x < 0 || header.figure_x > width - shape.width() ||
+            header.figure_y < -shape.height() || header.figure_y > height - shape.height()) {
+            return false;
+        }
 
-        // due to multiple input sources move in one direction could be performed only once
-        bool move_left = false;
-        bool move_right = false;
-        bool move_down = false;
-        bool drop = false;
-        bool flip = false;
+        // queue is filled up and then current figure is taken from it, every
+        // figure taken later is replaced right away
+        if (!header.queue.Valid() || header.queue.count() != FigureQueue::CAPACITY - 1 ||
+            header.hold < None || header.hold >= FigureTypeCount) {
+            return false;
+        }
 
-        for (size_t ev = 0; ev < input.event_count; ++ev) {
-            switch (input.events[ev].type) {
-                case INPUT_KEY_DOWN:
-                    switch (input.events[ev].keyboard.key) {
-                        case KEY_SPACE: drop = true; break;
-                        case KEY_UP:    flip = true; break;
-                        case KEY_DOWN:  move_down = true; break;
-                        case KEY_LEFT:  move_left = true; break;
-                        case KEY_RIGHT: move_right = true; break;
-                    }
-                    break;
+        if (header.garbage < 0 || header.garbage > height ||
+            header.garbage_hole < 0 || header.garbage_hole >= width ||
+            header.lines < 0 || header.score < 0 || header.attack < 0) {
+            return false;
+        }
 
-                case INPUT_BUTTON_DOWN:
-                    switch (input.events[ev].joystick.button) {
-                        case JOY_BUTTON_0: flip = true; break;
-                        case JOY_BUTTON_2: drop = true; break;
-                    }
-                    break;
+        if (!std::isfinite(header.fall_timer) || header.fall_timer < 0 ||
+            !std::isfinite(header.fall_speed) || header.fall_speed < 1 ||
+            !std::isfinite(header.input_clock_fraction) ||
+            header.input_clock_fraction < 0 || header.input_clock_fraction >= 1) {
+            return false;
+        }
 
-                case INPUT_POV:
-                    switch (input.events[ev].joystick.pov.value) {
-                        case JOY_DIRECTION_LEFT:  move_left = true; break;
-                        case JOY_DIRECTION_RIGHT: move_right = true; break;
-                        case JOY_DIRECTION_DOWN:  move_down = true; break;
-                        case JOY_DIRECTION_UP:    flip = true; break;
-                    }
-                    break;
+        if (header.shift_last != SHIFT_LEFT && header.shift_last != SHIFT_RIGHT) {
+            return false;
+        }
+        for (int shift = 0; shift < SHIFT_COUNT; ++shift) {
+            if (header.shift_held[shift] & ~uint32_t(SHIFT_SOURCE_KEYBOARD | SHIFT_SOURCE_POV)) {
+                return false;
             }
         }
 
-        if (drop) {
-            Drop();
-        } else {
-            if (flip) {
-                FlipFigure();
+        // rows are made of cells, full rows are always removed, and figure
+        // never overlaps bricks
+        uint32_t fullrow = (width < 32 ? 1u << width : 0u) - 1;
+        uint64_t hash = 0;
+        for (int y = 0; y < height; ++y) {
+            uint32_t row;
+            memcpy(&row, rows + sizeof(uint32_t) * y, sizeof(row));
+
+            uint32_t cells = 0;
+            for (int x = 0; x < width; ++x) {
+                Color cell;
+                memcpy(&cell, field + sizeof(Color) * (x + y * width), sizeof(cell));
+                cells |= cell.a > 0 ? 1u << x : 0;
             }
-
-            if (move_left) {
-                MoveLeft();
+            if (row != cells || row == fullrow) {
+                return false;
             }
 
-            if (move_right) {
-                MoveRight();
+            int figurerow = y - header.figure_y;
+            if (figurerow >= 0 && figurerow < shape.height() && (shape.row(figurerow) << header.figure_x) & row) {
+                return false;
             }
 
-            if (move_down) {
-                MoveDown();
-            }
+            hash ^= RowKey(y, row);
         }
+
+        return hash == header.hash;
     }
 
-    void Update(float interval)
+    void Allocate(Arena &arena)
     {
-        p_fall_timer += p_fall_speed * interval;
-        if (p_fall_timer >= 1)  {
-            p_fall_timer -= 1;
-            MoveDown();
-        }
+        p_field = arena.New<Color>(p_size.width() * p_size.height());
+        p_rows = arena.New<uint32_t>(p_size.height());
+        p_rectangles = arena.New<ColoredRectangle>(RectangleCapacity(p_size));
+        p_row_offset = arena.New<float>(p_size.height());
+        p_row_flash = arena.New<float>(p_size.height());
+        p_particles.Allocate(arena, PARTICLE_CAPACITY);
+        p_hud = arena.New<GameHud>(1);
     }
 
-    void RenderGraphics(GraphicsAPI &api, int width, int height)
+    FigureType RandomFigure()
     {
-        api.Clear(Color(20, 40, 205));
-
-        // compute field pixel size
-        float block_size = float((height - p_field_margin * 2) / p_field_height);
-        float field_x = width / 2 - p_field_width / 2 * block_size;
-        float field_y = float(p_field_margin);
+        return FigureType(p_random.Next(FigureTypeCount - 1) + 1);
+    }
 
-        // render field as set of boxes for now
-        int cell = 0;
-        for (int y = 0; y < p_field_height; ++y) {
-            for (int x = 0; x < p_field_width; ++x) {
-                // field background
-                api.Rectangle(
-                    field_x + x * block_size, field_y + y * block_size,
-                    block_size - 2, block_size - 2, Color(0, 0, 0, 20)
-                );
+    // places new figure right above the field, in the middle
+    void SpawnFigure(FigureType type)
+    {
+        p_figure = FigureShape(type);
+        p_figure_x = (p_size.width() - 2) / 2;
+        if (p_figure_x + p_figure.width() > p_size.width()) {
+            p_figure_x = p_size.width() - p_figure.width();
+        }
+        p_figure_y = -p_figure.height();
+    }
 
-                // field cell brick
-                api.Rectangle(
-                    field_x + x * block_size, field_y + y * block_size,
-                    block_size - 2, block_size - 2, p_field[cell++]
-                );
-            }
+    // puts current figure to hold slot and takes previously held one,
+    // this could be done only once per figure
+    void HoldFigure()
+    {
+        if (p_hold_used) {
+            return;
         }
 
-        // render figure
-        p_figure.Render(
-            api,
-            field_x + p_figure_x * block_size,
-            field_y + p_figure_y * block_size,
-            block_size
-        );
+        FigureType held = p_hold;
+        p_hold = p_figure.type();
+        p_hold_used = true;
 
-        // tiny mouse rectangle, just to show mouse following
-        api.Rectangle(p_mouse_x - 5, p_mouse_y - 5, 10, 10, Color(255, 255, 255));
+        if (held == None) {
+            SpawnFigure(p_queue.Pop());
+            p_queue.Push(RandomFigure());
+        } else {
+            SpawnFigure(held);
+        }
     }
 
-private:
     void ChangeFigureForTesting()
     {
         int t = p_figure.type();
@@ -362,8 +1550,8 @@ private:
 
         p_figure.Flip();
         p_figure_y -= p_figure.height() - oldheight;
-        if (p_figure_x + p_figure.width() > p_field_width) {
-            p_figure_x = p_field_width - p_figure.width();
+        if (p_figure_x + p_figure.width() > p_size.width()) {
+            p_figure_x = p_size.width() - p_figure.width();
         }
 
         // now figure is flipped and its position adjusted, but
@@ -379,6 +1567,137 @@ private:
         }
     }
 
+    // keys which act once per press, bit per key
+    static uint32_t ActionKeyBit(InputKey key)
+    {
+        switch (key) {
+            case KEY_F3:    return 1;
+            case KEY_P:     return 2;
+            case KEY_PAUSE: return 4;
+            case KEY_SPACE: return 8;
+            case KEY_UP:    return 16;
+            case KEY_C:     return 32;
+        }
+        return 0;
+    }
+
+    // figure stays where it is during pause
+    void Act(GameAction action)
+    {
+        if (p_paused) {
+            return;
+        }
+
+        switch (action) {
+            case ACTION_FLIP: FlipFigure(); break;
+            case ACTION_DROP: Drop(); break;
+            case ACTION_HOLD: HoldFigure(); break;
+        }
+    }
+
+    // time a is before time b on wrapping millisecond clock
+    static bool TimeBefore(uint32_t a, uint32_t b)
+    {
+        return int32_t(a - b) < 0;
+    }
+
+    static uint32_t ShiftDelay(int shift)
+    {
+        return shift == SHIFT_DOWN ? SOFT_DROP_REPEAT : SHIFT_DELAY;
+    }
+
+    static uint32_t ShiftRepeat(int shift)
+    {
+        return shift == SHIFT_DOWN ? SOFT_DROP_REPEAT : SHIFT_REPEAT;
+    }
+
+    // of left and right only last pressed one repeats
+    bool ShiftActive(int shift) const
+    {
+        return p_shift_held[shift] != 0 && (shift == SHIFT_DOWN || shift == p_shift_last);
+    }
+
+    void Shift(int shift)
+    {
+        switch (shift) {
+            case SHIFT_LEFT:  MoveLeft(); break;
+            case SHIFT_RIGHT: MoveRight(); break;
+            case SHIFT_DOWN:  MoveDown(); break;
+        }
+    }
+
+    // press or release of direction by one of its sources, press moves
+    // figure right away, repeats are counted from event time even when
+    // input clock already went further, so late events don't lose repeats
+    void ShiftKey(int shift, ShiftSource source, bool down, uint32_t time)
+    {
+        if (down && p_paused) {
+            return;
+        }
+
+        uint32_t held = p_shift_held[shift];
+        p_shift_held[shift] = down ? held | source : held & ~source;
+
+        if (down && held == 0) {
+            p_shift_next[shift] = time + ShiftDelay(shift);
+            if (shift != SHIFT_DOWN) {
+                p_shift_last = shift;
+            }
+            Shift(shift);
+        } else if (!down && held != 0 && p_shift_held[shift] == 0 && shift == p_shift_last) {
+            // other direction, if still held, goes on repeating, but not
+            // for the time it was overridden
+            int other = shift == SHIFT_LEFT ? SHIFT_RIGHT : SHIFT_LEFT;
+            if (p_shift_held[other]) {
+                p_shift_last = other;
+                if (TimeBefore(p_shift_next[other], time)) {
+                    p_shift_next[other] = time + SHIFT_REPEAT;
+                }
+            }
+        }
+    }
+
+    // applies repeats of held directions due by given time in their time
+    // order, so any number of moves fits in one frame
+    // event and update clocks drift a bit apart, input clock never goes back
+    // platform clocks could be anywhere on wrapping range, so clock starts
+    // from first event time after Reset()
+    void AdvanceInputClock(uint32_t time)
+    {
+        if (!p_input_clock_set) {
+            p_input_clock = time;
+            p_input_clock_set = true;
+        } else if (TimeBefore(p_input_clock, time)) {
+            p_input_clock = time;
+        }
+
+        // figure can't move further than this anyway
+        int limit = p_size.width() + p_size.height();
+        for (int moves = 0; ; ++moves) {
+            int next = -1;
+            for (int shift = 0; shift < SHIFT_COUNT; ++shift) {
+                if (ShiftActive(shift) && (next < 0 || TimeBefore(p_shift_next[shift], p_shift_next[next]))) {
+                    next = shift;
+                }
+            }
+
+            if (next < 0 || TimeBefore(p_input_clock, p_shift_next[next])) {
+                break;
+            }
+
+            // after long stall repeats just go on from now
+            if (moves == limit) {
+                for (int shift = 0; shift < SHIFT_COUNT; ++shift) {
+                    p_shift_next[shift] = p_input_clock + ShiftRepeat(shift);
+                }
+                break;
+            }
+
+            Shift(next);
+            p_shift_next[next] += ShiftRepeat(next);
+        }
+    }
+
     void MoveLeft()
     {
         if (!Collide(p_figure_x - 1, p_figure_y)) {
@@ -405,88 +1724,344 @@ private:
     // drops down current figure
     void Drop()
     {
-        while (!Collide(p_figure_x, p_figure_y + 1)) {
-            ++p_figure_y;
-        }
+        p_figure_y = LandingRow();
         PutFigureInTheWall();
     }
 
+    // row where current figure stops if dropped
+    // landing rows for all rotations and columns of current figure type are
+    // computed at once and kept until field changes
+    int LandingRow()
+    {
+        if (!p_landing_valid || p_landing_type != p_figure.type()) {
+            GetPlacements(p_figure.type(), p_landing);
+            p_landing_type = p_figure.type();
+            p_landing_valid = true;
+        }
+
+        // cached row is for figure dropped from above the field, so every row
+        // above it is free, it's only wrong when figure already went below it
+        // (slid under some overhang), so do usual scan then
+        int row = p_landing.rows[p_figure.rotation() % p_landing.rotations][p_figure_x];
+        if (row >= p_figure_y) {
+            return row;
+        }
+
+        row = p_figure_y;
+        while (!Collide(p_figure_x, row + 1)) {
+            ++row;
+        }
+        return row;
+    }
+
     // "copy" current figure bricks into field and set new figure
     // check for full filled rows and remove them
     void PutFigureInTheWall()
     {
+        // field is going to change
+        p_landing_valid = false;
+
         // if figure put outside field top - this is game over
         if (p_figure_y < 0) {
-            // now just clear field and reset speed and lines counter
-            for (int cell = 0; cell < p_field_width * p_field_height; ++cell) {
-                p_field[cell] = Color(0, 0, 0, 0);
-            }
-
-            p_fall_speed = 1;
-            p_fall_timer = 0;
-            p_lines = 0;
+            GameOver();
         } else {
             // copy figure bricks to field
             for (int y = 0; y < p_figure.height(); ++y) {
+                int fieldy = p_figure_y + y;
+                uint32_t row = p_rows[fieldy];
+
                 for (int x = 0; x < p_figure.width(); ++x) {
                     Color figurecol = p_figure.data(x, y);
                     if (figurecol.a > 0) {
-                        int fieldcell = (p_figure_x + x) + (p_figure_y + y) * p_field_width;
+                        int fieldcell = (p_figure_x + x) + fieldy * p_size.width();
                         p_field[fieldcell] = figurecol;
+                        row |= 1u << (p_figure_x + x);
+
+                        // bit of dust from under every figure brick
+                        for (int n = 0; n < 2 && p_effects; ++n) {
+                            EmitParticle(
+                                p_figure_x + x + EffectRandom(0.1f, 0.9f), fieldy + 1.0f,
+                                EffectRandom(-3, 3), EffectRandom(-4, -1),
+                                EffectRandom(0.2f, 0.4f), figurecol
+                            );
+                        }
                     }
                 }
+
+                SetRow(fieldy, row);
             }
 
             // check wall for destruction of full rows
-            // just walk all rows!
-            for (int y = 0; y < p_field_height; ++y) {
-                int blocksinarow = 0;
-                for (int x = 0; x < p_field_width; ++x) {
-                    if (p_field[x + y * p_field_width].a > 0) {
-                        ++blocksinarow;
+            // only rows touched by figure could become full
+            uint32_t fullrow = (p_size.width() < 32 ? 1u << p_size.width() : 0u) - 1;
+            int removed = 0;
+            int level = this->level();
+            for (int y = p_figure_y; y < p_figure_y + p_figure.height(); ++y) {
+                if (p_rows[y] == fullrow) {
+                    // bricks of removed row burst out and row flashes
+                    for (int x = 0; x < p_size.width() && p_effects; ++x) {
+                        for (int n = 0; n < 3; ++n) {
+                            EmitParticle(
+                                x + 0.5f, y + 0.5f,
+                                EffectRandom(-8, 8), EffectRandom(-12, -2),
+                                EffectRandom(0.4f, 0.8f), p_field[x + y * p_size.width()]
+                            );
+                        }
                     }
-                }
+                    p_row_flash[y] = FLASH_TIME;
+                    p_collapse_delay = FLASH_TIME;
 
-                if (blocksinarow == p_field_width) {
                     // this row should be removed, just do ugly copy of all previous rows
+                    // rows moved down are still shown where they were and then
+                    // collapse to their new place
                     for (int yy = y; yy > 0; --yy) {
-                        for (int x = 0; x < p_field_width; ++x) {
-                            p_field[x + yy * p_field_width] = p_field[x + (yy - 1) * p_field_width];
+                        for (int x = 0; x < p_size.width(); ++x) {
+                            p_field[x + yy * p_size.width()] = p_field[x + (yy - 1) * p_size.width()];
                         }
+                        SetRow(yy, p_rows[yy - 1]);
+                        p_row_offset[yy] = p_row_offset[yy - 1] + 1;
                     }
-                    for (int x = 0; x < p_field_width; ++x) {
+                    for (int x = 0; x < p_size.width(); ++x) {
                         p_field[x] = Color(0, 0, 0, 0);
                     }
+                    SetRow(0, 0);
+                    p_row_offset[0] = 0;
 
                     ++p_lines;
+                    ++removed;
                     p_fall_speed += 0.1f;
                 }
             }
+
+            p_score += LINE_SCORES[removed] * level;
+
+            // attack cancels pending garbage first, the rest goes to opponent
+            int attack = LINE_ATTACKS[removed];
+            int cancelled = attack < p_garbage ? attack : p_garbage;
+            p_garbage -= cancelled;
+            p_attack += attack - cancelled;
+
+            PlaySound(removed == 4 ? SOUND_CLEAR_FOUR : (removed > 0 ? SOUND_CLEAR : SOUND_LOCK));
+
+            if (removed == 0 && p_garbage > 0) {
+                InsertGarbage();
+            }
         }
 
-        // generate new figure
-        p_figure.Make(FigureType(rand() % 7 + 1));
-        p_figure_x = 4;
-        p_figure_y = -p_figure.height();
+        // take new figure from queue and refill it
+        SpawnFigure(p_queue.Pop());
+        p_queue.Push(RandomFigure());
+        p_hold_used = false;
+    }
+
+    // score, lines and level at the left of the field, performance overlay
+    // at top left corner, labels are set every frame, but only changed
+    // ones are formatted and laid out again
+    void RenderHud(GraphicsAPI &api, float field_x, float field_y, float block_size)
+    {
+        float size = float(int(block_size / 8));
+        size = size < 1 ? 1 : size;
+
+        float x = field_x - block_size - 8 * FONT_ADVANCE * size;
+        float y = field_y + block_size * 5;
+        float line = FONT_LINE_HEIGHT * size;
+        Color caption(150, 170, 255);
+        Color value(255, 255, 255);
+
+        GameHud &hud = *p_hud;
+        hud.score_caption.SetText("SCORE");
+        hud.score_caption.Place(x, y, size, caption);
+        hud.score.SetNumber("", p_score);
+        hud.score.Place(x, y + line, size, value);
+
+        hud.lines_caption.SetText("LINES");
+        hud.lines_caption.Place(x, y + line * 3, size, caption);
+        hud.lines.SetNumber("", p_lines);
+        hud.lines.Place(x, y + line * 4, size, value);
+
+        hud.level_caption.SetText("LEVEL");
+        hud.level_caption.Place(x, y + line * 6, size, caption);
+        hud.level.SetNumber("", level());
+        hud.level.Place(x, y + line * 7, size, value);
+
+        GlyphBatch batch(api, hud.glyphs, GameHud::GLYPH_CAPACITY);
+        batch.Add(hud.score_caption);
+        batch.Add(hud.score);
+        batch.Add(hud.lines_caption);
+        batch.Add(hud.lines);
+        batch.Add(hud.level_caption);
+        batch.Add(hud.level);
+
+        if (p_paused) {
+            hud.paused.SetText("PAUSED");
+            hud.paused.Place(
+                field_x + (p_size.width() * block_size - 6 * FONT_ADVANCE * size) / 2,
+                field_y + (p_size.height() * block_size - FONT_GLYPH_HEIGHT * size) / 2,
+                size, value
+            );
+            batch.Add(hud.paused);
+        }
+
+        if (p_show_perf && p_frame_time > 0) {
+            hud.fps.SetNumber("FPS ", int(1 / p_frame_time + 0.5f));
+            hud.fps.Place(size * 4, size * 4, size, value);
+            hud.frame.SetNumber("FRAME ", int(p_frame_time * 10000 + 0.5f), 1, " MS");
+            hud.frame.Place(size * 4, size * 4 + line, size, value);
+
+            batch.Add(hud.fps);
+            batch.Add(hud.frame);
+        }
+
+        batch.Flush();
+    }
+
+    // sound is started on next RenderAudio(), panned to where figure is
+    void PlaySound(GameSound sound)
+    {
+        p_sounds |= 1u << sound;
+        p_sound_pan = (p_figure_x + p_figure.width() * 0.5f) / p_size.width() - 0.5f;
+    }
+
+    // effects are only shown, game state never depends on them
+
+    void ClearEffects()
+    {
+        for (int y = 0; y < p_size.height(); ++y) {
+            p_row_offset[y] = 0;
+            p_row_flash[y] = 0;
+        }
+        p_collapse_delay = 0;
+        p_collapsing = false;
+        p_particles.Clear();
+    }
+
+    void UpdateEffects(float interval)
+    {
+        p_particles.Update(interval, PARTICLE_GRAVITY);
+
+        if (p_collapse_delay <= 0 && !p_collapsing) {
+            return;
+        }
+
+        // rows stay in place while removed rows flash, then fall down
+        p_collapse_delay -= interval;
+        p_collapsing = false;
+        for (int y = 0; y < p_size.height(); ++y) {
+            float flash = p_row_flash[y] - interval;
+            p_row_flash[y] = flash > 0 ? flash : 0;
+
+            if (p_collapse_delay <= 0) {
+                float offset = p_row_offset[y] - COLLAPSE_SPEED * interval;
+                p_row_offset[y] = offset > 0 ? offset : 0;
+            }
+
+            p_collapsing = p_collapsing || p_row_flash[y] > 0 || p_row_offset[y] > 0;
+        }
+    }
+
+    float EffectRandom(float from, float to)
+    {
+        return from + (to - from) * float(p_effects_random.Next(1024)) / 1024.0f;
+    }
+
+    void EmitParticle(float x, float y, float vx, float vy, float life, const Color &color)
+    {
+        p_particles.Emit(x, y, vx, vy, life, uint32_t(color.r) | uint32_t(color.g) << 8 | uint32_t(color.b) << 16);
+    }
+
+    // now just clear field and reset speed and lines counter
+    void GameOver()
+    {
+        for (int cell = 0; cell < p_size.width() * p_size.height(); ++cell) {
+            p_field[cell] = Color(0, 0, 0, 0);
+        }
+        for (int y = 0; y < p_size.height(); ++y) {
+            p_rows[y] = 0;
+        }
+        p_hash = 0;
+
+        p_fall_speed = 1;
+        p_fall_timer = 0;
+        p_lines = 0;
+        p_score = 0;
+        p_hold = None;
+        p_garbage = 0;
+        p_attack = 0;
+
+        ++p_game_overs;
+        ClearEffects();
+        PlaySound(SOUND_GAME_OVER);
+    }
+
+    // pushes whole field up by pending garbage rows and fills bottom rows,
+    // rows are contiguous in field storage, so shift is a single move of
+    // field memory, bricks pushed out of the top end the game
+    // called after lock, before next figure spawns above the field, so
+    // figure never gets inside garbage
+    void InsertGarbage()
+    {
+        int count = p_garbage;
+        int width = p_size.width();
+        int height = p_size.height();
+        p_garbage = 0;
+
+        for (int y = 0; y < count; ++y) {
+            if (p_rows[y] != 0) {
+                GameOver();
+                return;
+            }
+        }
+
+        memmove(p_field, p_field + count * width, sizeof(Color) * width * (height - count));
+        memmove(p_rows, p_rows + count, sizeof(uint32_t) * (height - count));
+        memmove(p_row_offset, p_row_offset + count, sizeof(float) * (height - count));
+        memmove(p_row_flash, p_row_flash + count, sizeof(float) * (height - count));
+
+        uint32_t garbagerow = ((width < 32 ? 1u << width : 0u) - 1) & ~(1u << p_garbage_hole);
+        for (int y = height - count; y < height; ++y) {
+            Color *row = p_field + y * width;
+            for (int x = 0; x < width; ++x) {
+                row[x] = x == p_garbage_hole ? Color(0, 0, 0, 0) : GARBAGE_COLOR;
+            }
+            p_rows[y] = garbagerow;
+            p_row_offset[y] = 0;
+            p_row_flash[y] = 0;
+        }
+
+        // every row changed its place, row keys depend on it
+        p_hash = 0;
+        for (int y = 0; y < height; ++y) {
+            p_hash ^= RowKey(y, p_rows[y]);
+        }
+
+        p_landing_valid = false;
+    }
+
+    // sets row occupancy mask and updates field hash accordingly
+    // only two row keys are involved, so hash never needs full recompute
+    void SetRow(int y, uint32_t row)
+    {
+        p_hash ^= RowKey(y, p_rows[y]) ^ RowKey(y, row);
+        p_rows[y] = row;
     }
 
     // this function checks current figure collision at position posx and posy
     bool Collide(int posx, int posy)
     {
         // game field width boundaries check
-        if (posx < 0 || posx + p_figure.width() > p_field_width) {
+        if (posx < 0 || posx + p_figure.width() > p_size.width()) {
             return true;
         }
 
         // game field bottom boundary check
-        if (posy + p_figure.height() > p_field_height) {
+        if (posy + p_figure.height() > p_size.height()) {
             return true;
         }
 
         // check collision with bricks in the game field
         for (int y = 0; y < p_figure.height(); ++y) {
             for (int x = 0; x < p_figure.width(); ++x) {
-                int fieldcell = (posx + x) + (posy + y) * p_field_width;
+                int fieldcell = (posx + x) + (posy + y) * p_size.width();
                 if (fieldcell >= 0 && p_figure.data(x, y).a > 0 && p_field[fieldcell].a > 0) {
                     return true;
                 }
@@ -500,20 +2075,145 @@ private:
     float  p_mouse_x;
     float  p_mouse_y;
 
-    int    p_field_width;  // in cells
-    int    p_field_height; // in cells
+    FieldSize<WIDTH, HEIGHT> p_size; // in cells
     int    p_field_margin; // in pixels
-    Color *p_field;
+    uint8_t  *p_memory;    // memory block owned by game, if any
+    bool      p_effects;   // particles are emitted, see SetEffects()
+    Color    *p_field;
+    uint32_t *p_rows;      // field occupancy, bit x of row y is set for filled cell
+    uint64_t  p_hash;      // field hash, updated along with p_rows
+    ColoredRectangle *p_rectangles; // render batch storage
+
+    // line removal and lock effects
+    float       *p_row_offset;      // rows above their place while collapsing, in cells
+    float       *p_row_flash;       // flash time left for removed rows
+    float        p_collapse_delay;  // time left before rows start to collapse
+    bool         p_collapsing;      // any row flash or offset left
+    ParticlePool p_particles;
+    Random       p_effects_random;  // separate from p_random, effects don't change game
+
+    GameHud *p_hud;
+    float    p_frame_time;  // smoothed frame interval, for performance overlay
+    bool     p_show_perf;
+    bool     p_paused;
+    bool     p_redraw;      // something changed since last RenderGraphics()
+
+    uint32_t p_sounds;     // sounds to start, bit per GameSound
+    float    p_sound_pan;
 
     Figure p_figure;       // current figure
     int    p_figure_x;     // and its position x
     int    p_figure_y;     // and y in cells
 
+    FigureQueue p_queue;     // upcoming figures
+    FigureType  p_hold;      // figure in hold slot
+    bool        p_hold_used; // hold already used for current figure
+
+    Placements  p_landing;       // landing rows of p_landing_type figure,
+    FigureType  p_landing_type;  // kept until field changes
+    bool        p_landing_valid;
+
     int    p_lines;        // how many row lines "broken"
+    int    p_score;
+    int    p_game_overs;   // not part of saved state, only counts
+    int    p_garbage;      // garbage rows waiting for next lock
+    int    p_garbage_hole; // column left empty in them
+    int    p_attack;       // garbage rows not yet taken for opponent
+
+    uint32_t p_shift_held[SHIFT_COUNT]; // ShiftSource bits holding direction
+    uint32_t p_shift_next[SHIFT_COUNT]; // time of next repeat
+    int      p_shift_last;              // last pressed of left and right
+    uint32_t p_input_clock;             // time repeats are applied up to
+    bool     p_input_clock_set;         // clock is synced to event time
+    float    p_input_clock_fraction;    // part of millisecond from updates
+    uint32_t p_action_keys;             // ActionKeyBit() of held keys
     float  p_fall_timer;   // current time of falling process
     float  p_fall_speed;   // how fast figure falls down one step
+
+    Random p_random;       // figure generator, same seed gives same game
+};
+
+// standard game
+typedef BasicGame<10, 20> Game;
+
+// game with field size given at run time, for custom boards
+typedef BasicGame<0, 0> CustomGame;
+
+
+// fixed pool of games in single memory block, used for mass simulation
+// every slot holds game object and all its data, games are created once
+// and then could be reused with Game::Reset()
+class GamePool
+{
+public:
+    GamePool(size_t capacity) :
+        p_slot_size(Arena::Align(sizeof(Game)) + Game::MemorySize()),
+        p_capacity(capacity),
+        p_count(0)
+    {
+        p_memory = new uint8_t[p_slot_size * capacity];
+    }
+
+    ~GamePool()
+    {
+        Clear();
+        delete[] p_memory;
+    }
+
+    // returns nullptr when pool is full
+    Game *Create(uint64_t seed)
+    {
+        if (p_count == p_capacity) {
+            return nullptr;
+        }
+
+        Arena arena(p_memory + p_slot_size * p_count, p_slot_size);
+        void *place = arena.Allocate(sizeof(Game));
+        Game *game = new (place) Game(arena, seed);
+        ++p_count;
+        return game;
+    }
+
+    void Clear()
+    {
+        for (size_t n = 0; n < p_count; ++n) {
+            game(n)->~Game();
+        }
+        p_count = 0;
+    }
+
+    Game *game(size_t index) { return reinterpret_cast<Game*>(p_memory + p_slot_size * index); }
+    size_t count() const { return p_count; }
+    size_t capacity() const { return p_capacity; }
+
+private:
+    GamePool(const GamePool&);
+    GamePool &operator=(const GamePool&);
+
+    uint8_t *p_memory;
+    size_t   p_slot_size;
+    size_t   p_capacity;
+    size_t   p_count;
 };
 
+// structure of arrays batch of games for mass simulation
+#include "batch.cpp"
+
+// bot playing the game through input
+#include "bot.cpp"
+
+// many games on one screen
+#include "spectator.cpp"
+
+// two boards sending garbage to each other
+#include "versus.cpp"
+
+#if defined(GAME_MODULE)
+// game is built as shared library for platform host, only module
+// interface is added
+#include "module.cpp"
+#else
 // main platform source - contains platform entry point and platform specific
 // functions
 #include "platform.cpp"
+#endif
@@ -0,0 +1,406 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// evolutionary tuner for bot weights
+// every generation each weight vector of population plays same set of
+// seeded games to the end (first game over) or to tick limit, fitness is
+// average number of lines removed, best vectors go to next generation as is,
+// the rest is bred from tournament winners with blend crossover and mutation
+// games are spread across worker threads same way verifier does it, every
+// worker has its own game and bot which are reset for every game, so nothing
+// is allocated while generation runs, features cache is shared by all
+// workers, it doesn't depend on weights
+//
+// population is saved into checkpoint file after every generation, when
+// checkpoint file already exists tuning continues from it
+// checkpoint is a text file:
+//     tuner <generation> <random state> <population size>
+//     <lines> <holes> <height> <bumpiness> <top> <fitness>
+//     ...
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+
+// weights are tuned as plain vector
+static float BotWeights::* const TUNER_WEIGHTS[] = {
+    &BotWeights::lines,
+    &BotWeights::holes,
+    &BotWeights::height,
+    &BotWeights::bumpiness,
+    &BotWeights::top
+};
+
+static const int TUNER_WEIGHT_COUNT = sizeof(TUNER_WEIGHTS) / sizeof(TUNER_WEIGHTS[0]);
+
+struct TunerSettings
+{
+    int   population;
+    int   games;       // games played by every vector in generation
+    int   ticks;       // game tick limit, good vectors could play forever
+    float rate;        // game ticks per second
+    int   elite;       // best vectors kept as is
+    int   tournament;  // vectors competing for every parent
+    float mutation;    // mutation strength
+};
+
+static const TunerSettings TUNER_DEFAULT_SETTINGS = { 64, 16, 60 * 60 * 20, 60, 4, 4, 0.2f };
+
+struct TunerIndividual
+{
+    BotWeights weights;
+    float      fitness;
+};
+
+
+class BotTuner
+{
+public:
+    BotTuner(const TunerSettings &settings = TUNER_DEFAULT_SETTINGS) :
+        p_settings(settings),
+        p_cache(1 << 20),
+        p_generation(0),
+        p_random(1),
+        p_next(0),
+        p_ticks(0)
+    {
+        if (p_settings.population < 2) {
+            p_settings.population = 2;
+        }
+        if (p_settings.elite >= p_settings.population) {
+            p_settings.elite = p_settings.population - 1;
+        }
+
+        p_population = new TunerIndividual[p_settings.population];
+        p_offspring = new TunerIndividual[p_settings.population];
+        p_results = new int[p_settings.population * p_settings.games];
+        p_seeds = new uint64_t[p_settings.games];
+    }
+
+    ~BotTuner()
+    {
+        delete[] p_population;
+        delete[] p_offspring;
+        delete[] p_results;
+        delete[] p_seeds;
+    }
+
+    // starts new population around default weights
+    void Start(uint64_t seed)
+    {
+        p_generation = 0;
+        p_random.Seed(seed);
+        p_best.weights = BOT_DEFAULT_WEIGHTS;
+        p_best.fitness = 0;
+
+        p_population[0].weights = BOT_DEFAULT_WEIGHTS;
+        for (int n = 1; n < p_settings.population; ++n) {
+            BotWeights &weights = p_population[n].weights;
+            for (int w = 0; w < TUNER_WEIGHT_COUNT; ++w) {
+                weights.*TUNER_WEIGHTS[w] = Uniform() * 2 - 1;
+            }
+            Normalize(weights);
+        }
+
+        for (int n = 0; n < p_settings.population; ++n) {
+            p_population[n].fitness = 0;
+        }
+    }
+
+    // false if file couldn't be read or doesn't match settings
+    bool LoadCheckpoint(const char *filename)
+    {
+        FILE *file = fopen(filename, "r");
+        if (file == nullptr) {
+            return false;
+        }
+
+        unsigned long long generation = 0, state = 0;
+        int population = 0;
+        bool ok =
+            fscanf(file, " tuner %llu %llu %d", &generation, &state, &population) == 3 &&
+            population == p_settings.population;
+
+        for (int n = 0; ok && n < population; ++n) {
+            TunerIndividual &individual = p_population[n];
+            for (int w = 0; ok && w < TUNER_WEIGHT_COUNT; ++w) {
+                ok = fscanf(file, "%f", &(individual.weights.*TUNER_WEIGHTS[w])) == 1;
+            }
+            ok = ok && fscanf(file, "%f", &individual.fitness) == 1;
+        }
+        fclose(file);
+
+        if (!ok) {
+            fprintf(stderr, "Checkpoint \"%s\" is broken or has different population size\n", filename);
+            return false;
+        }
+
+        p_generation = generation;
+        p_random.Seed(state);
+        p_best = p_population[0];
+        return true;
+    }
+
+    // checkpoint is written into temporary file which then replaces old one,
+    // so interrupted write never breaks existing checkpoint
+    bool SaveCheckpoint(const char *filename) const
+    {
+        char temp[1024];
+        snprintf(temp, sizeof(temp), "%s.tmp", filename);
+
+        FILE *file = fopen(temp, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't write checkpoint \"%s\"\n", temp);
+            return false;
+        }
+
+        fprintf(
+            file, "tuner %llu %llu %d\n",
+            (unsigned long long)p_generation, (unsigned long long)p_random.state(), p_settings.population
+        );
+        for (int n = 0; n < p_settings.population; ++n) {
+            const TunerIndividual &individual = p_population[n];
+            for (int w = 0; w < TUNER_WEIGHT_COUNT; ++w) {
+                fprintf(file, "%.9g ", individual.weights.*TUNER_WEIGHTS[w]);
+            }
+            fprintf(file, "%.9g\n", individual.fitness);
+        }
+
+        bool ok = fclose(file) == 0;
+#ifdef _WIN32
+        // rename doesn't replace existing file there
+        remove(filename);
+#endif
+        ok = ok && rename(temp, filename) == 0;
+        if (!ok) {
+            fprintf(stderr, "Couldn't write checkpoint \"%s\"\n", filename);
+        }
+        return ok;
+    }
+
+    // plays all games of current population on given number of threads,
+    // then breeds next one, returns time taken in seconds
+    // elite vectors play again on new games, so lucky ones don't stay forever
+    double Step(unsigned threads)
+    {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        threads = threads > 0 ? threads : 1;
+
+        // all vectors play same games, so they're compared fairly, games change
+        // every generation, so vectors aren't tuned to particular games
+        for (int n = 0; n < p_settings.games; ++n) {
+            p_seeds[n] = (uint64_t(p_random.Next()) << 32) | p_random.Next();
+        }
+
+        p_next = 0;
+        p_ticks = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        // calling thread is one of the workers
+        std::thread *workers = new std::thread[threads - 1];
+        for (unsigned n = 0; n < threads - 1; ++n) {
+            workers[n] = std::thread(&BotTuner::Work, this);
+        }
+        Work();
+        for (unsigned n = 0; n < threads - 1; ++n) {
+            workers[n].join();
+        }
+        delete[] workers;
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (int n = 0; n < p_settings.population; ++n) {
+            int lines = 0;
+            for (int g = 0; g < p_settings.games; ++g) {
+                lines += p_results[n * p_settings.games + g];
+            }
+            p_population[n].fitness = float(lines) / p_settings.games;
+        }
+
+        SortPopulation();
+        Breed();
+        ++p_generation;
+
+        return seconds;
+    }
+
+    uint64_t generation() const { return p_generation; }
+    int population() const { return p_settings.population; }
+    int games() const { return p_settings.games; }
+    uint64_t ticks() const { return p_ticks; }
+
+    // after Step() this is last generation result, before next generation
+    // replaces population
+    const TunerIndividual &best() const { return p_best; }
+
+private:
+    BotTuner(const BotTuner&);
+    BotTuner &operator=(const BotTuner&);
+
+    // every worker has single game and bot, task is a pair of vector and game
+    // and is taken one by one, games differ in length a lot
+    void Work()
+    {
+        Game game;
+        BotInput bot(game, BOT_DEFAULT_WEIGHTS, &p_cache);
+        VerifierPlatform platform;
+        Input input;
+        float interval = 1.0f / p_settings.rate;
+        uint64_t ticks = 0;
+
+        size_t count = size_t(p_settings.population) * p_settings.games;
+        for (;;) {
+            size_t task = p_next.fetch_add(1);
+            if (task >= count) {
+                break;
+            }
+
+            int individual = int(task / p_settings.games);
+            int gameindex = int(task % p_settings.games);
+
+            game.Reset(p_seeds[gameindex]);
+            bot.SetWeights(p_population[individual].weights);
+            platform.Reset();
+            memset(&input, 0, sizeof(input));
+
+            // game starts over by itself when it's over, so run stops at
+            // first game over, lines are taken before it resets them
+            int lines = 0;
+            for (int tick = 0; tick < p_settings.ticks && game.game_overs() == 0; ++tick) {
+                lines = game.lines();
+
+                input.event_count = 0;
+                input.event_dropped = 0;
+                float gameinterval = interval;
+                bot.NextFrame(input, uint32_t(tick * 1000.0f * interval), gameinterval);
+
+                game.ProcessInput(platform, input);
+                game.Update(gameinterval);
+                ++ticks;
+            }
+            if (game.game_overs() == 0) {
+                lines = game.lines();
+            }
+
+            p_results[task] = lines;
+        }
+
+        p_ticks += ticks;
+    }
+
+    float Uniform()
+    {
+        return float(p_random.Next() / 4294967296.0);
+    }
+
+    // sum of uniform numbers is close enough to normal distribution here
+    float Gaussian()
+    {
+        return (Uniform() + Uniform() + Uniform() + Uniform() - 2.0f) * 1.7320508f;
+    }
+
+    // only direction of weight vector matters for placement choice
+    static void Normalize(BotWeights &weights)
+    {
+        float length = 0;
+        for (int w = 0; w < TUNER_WEIGHT_COUNT; ++w) {
+            length += weights.*TUNER_WEIGHTS[w] * weights.*TUNER_WEIGHTS[w];
+        }
+
+        length = sqrtf(length);
+        if (length > 0) {
+            for (int w = 0; w < TUNER_WEIGHT_COUNT; ++w) {
+                weights.*TUNER_WEIGHTS[w] /= length;
+            }
+        }
+    }
+
+    // insertion sort, population is small
+    void SortPopulation()
+    {
+        for (int n = 1; n < p_settings.population; ++n) {
+            TunerIndividual individual = p_population[n];
+            int m = n;
+            for (; m > 0 && p_population[m - 1].fitness < individual.fitness; --m) {
+                p_population[m] = p_population[m - 1];
+            }
+            p_population[m] = individual;
+        }
+
+        p_best = p_population[0];
+    }
+
+    // population is sorted, so lower index wins tournament
+    int Tournament()
+    {
+        int winner = int(p_random.Next(uint32_t(p_settings.population)));
+        for (int n = 1; n < p_settings.tournament; ++n) {
+            int contender = int(p_random.Next(uint32_t(p_settings.population)));
+            winner = contender < winner ? contender : winner;
+        }
+        return winner;
+    }
+
+    void Breed()
+    {
+        for (int n = 0; n < p_settings.elite; ++n) {
+            p_offspring[n] = p_population[n];
+        }
+
+        for (int n = p_settings.elite; n < p_settings.population; ++n) {
+            const TunerIndividual &a = p_population[Tournament()];
+            const TunerIndividual &b = p_population[Tournament()];
+
+            // child is taken closer to fitter parent
+            float total = a.fitness + b.fitness;
+            float share = total > 0 ? a.fitness / total : 0.5f;
+
+            BotWeights &weights = p_offspring[n].weights;
+            for (int w = 0; w < TUNER_WEIGHT_COUNT; ++w) {
+                float value =
+                    a.weights.*TUNER_WEIGHTS[w] * share +
+                    b.weights.*TUNER_WEIGHTS[w] * (1 - share);
+
+                // not every weight is mutated, so good vectors aren't lost
+                if (p_random.Next(TUNER_WEIGHT_COUNT) == 0) {
+                    value += Gaussian() * p_settings.mutation;
+                }
+
+                weights.*TUNER_WEIGHTS[w] = value;
+            }
+            Normalize(weights);
+            p_offspring[n].fitness = 0;
+        }
+
+        TunerIndividual *swap = p_population;
+        p_population = p_offspring;
+        p_offspring = swap;
+    }
+
+private:
+    TunerSettings         p_settings;
+    HashCache             p_cache;       // field features, shared by workers
+    TunerIndividual      *p_population;
+    TunerIndividual      *p_offspring;
+    TunerIndividual       p_best;
+    int                  *p_results;     // lines for every vector and game
+    uint64_t             *p_seeds;       // games of current generation
+    uint64_t              p_generation;
+    Random                p_random;
+    std::atomic<size_t>   p_next;        // next task to take
+    std::atomic<uint64_t> p_ticks;
+};
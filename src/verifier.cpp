@@ -0,0 +1,285 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// batch replay verification
+// every replay is played from its seed with recorded input and intervals,
+// same way headless platform plays it, and result is compared with claimed
+// one, game is deterministic, so honest replay always gives same result
+// replays are spread across worker threads, every worker has its own game
+// which is reset for every replay, so nothing is allocated per game besides
+// file buffers
+//
+// replays are untrusted, so replay with bad event, cut off frame or frame
+// interval outside of normal tick range is broken, tiny intervals would let
+// player play in slow motion, huge ones aren't real ticks either
+// submitted game ends at its first game over, game starts over by itself
+// after it, so whatever is played past it doesn't count
+//
+// list file has one replay per line:
+//     <replay file> <claimed lines> [claimed score]
+// lines starting with # are comments
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+
+enum VerifyStatus
+{
+    VERIFY_PENDING,
+    VERIFY_OK,
+    VERIFY_MISMATCH, // replay gives different result than claimed
+    VERIFY_BROKEN    // replay couldn't be read or has bad data
+};
+
+// frame intervals replay could have, 1000 to 10 ticks per second
+static const float VERIFY_MIN_INTERVAL = 0.001f;
+static const float VERIFY_MAX_INTERVAL = 0.1f;
+
+struct VerifyEntry
+{
+    char        *path;
+    int          claimed_lines;
+    int          claimed_score; // negative when not claimed
+    VerifyStatus status;
+    int          lines;
+    int          score;
+    uint64_t     ticks;
+    double       time;          // game time in seconds
+};
+
+// game could ask to quit (ESC in replay), run ends there same as in
+// headless platform
+class VerifierPlatform : public PlatformAPI
+{
+public:
+    VerifierPlatform() :
+        p_quit(false)
+    {}
+
+    void Quit() override { p_quit = true; }
+    void DEBUGPrint(const char *, ...) override {}
+
+    void Reset() { p_quit = false; }
+    bool quit() const { return p_quit; }
+
+private:
+    bool p_quit;
+};
+
+
+class ReplayVerifier
+{
+public:
+    ReplayVerifier() :
+        p_entries(nullptr),
+        p_text(nullptr),
+        p_count(0),
+        p_next(0),
+        p_ticks(0)
+    {}
+
+    ~ReplayVerifier()
+    {
+        delete[] p_entries;
+        delete[] p_text;
+    }
+
+    bool Load(const char *filename)
+    {
+        FILE *file = fopen(filename, "rb");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't open replay list \"%s\"\n", filename);
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        delete[] p_text;
+        p_text = new char[size + 1];
+        size_t read = fread(p_text, 1, size_t(size), file);
+        p_text[read] = 0;
+        fclose(file);
+
+        // there can't be more entries than lines
+        size_t capacity = 1;
+        for (size_t n = 0; n < read; ++n) {
+            capacity += p_text[n] == '\n' ? 1 : 0;
+        }
+        delete[] p_entries;
+        p_entries = new VerifyEntry[capacity];
+        p_count = 0;
+
+        // paths are cut right in the text
+        int linenumber = 0;
+        for (char *line = p_text; line; ) {
+            char *end = strchr(line, '\n');
+            if (end) {
+                *end = 0;
+            }
+            ++linenumber;
+
+            char *path = line + strspn(line, " \t\r");
+            line = end ? end + 1 : nullptr;
+            if (*path == 0 || *path == '#') {
+                continue;
+            }
+
+            char *pathend = path + strcspn(path, " \t\r");
+            char *claim = *pathend ? pathend + 1 : pathend;
+            *pathend = 0;
+
+            VerifyEntry &entry = p_entries[p_count];
+            entry.path = path;
+            entry.claimed_score = -1;
+            entry.status = VERIFY_PENDING;
+            entry.lines = 0;
+            entry.score = 0;
+            entry.ticks = 0;
+            entry.time = 0;
+
+            char *next = nullptr;
+            entry.claimed_lines = int(strtol(claim, &next, 10));
+            if (next == claim) {
+                fprintf(stderr, "%s:%d: claimed lines expected\n", filename, linenumber);
+                return false;
+            }
+
+            claim = next;
+            int score = int(strtol(claim, &next, 10));
+            if (next != claim) {
+                entry.claimed_score = score;
+            }
+
+            ++p_count;
+        }
+
+        return true;
+    }
+
+    // plays all replays on given number of threads, returns time taken
+    // in seconds
+    double Run(unsigned threads)
+    {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        threads = threads > 0 ? threads : 1;
+
+        p_next = 0;
+        p_ticks = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        // calling thread is one of the workers
+        std::thread *workers = new std::thread[threads - 1];
+        for (unsigned n = 0; n < threads - 1; ++n) {
+            workers[n] = std::thread(&ReplayVerifier::Work, this);
+        }
+        Work();
+        for (unsigned n = 0; n < threads - 1; ++n) {
+            workers[n].join();
+        }
+        delete[] workers;
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t count() const { return p_count; }
+    const VerifyEntry &entry(size_t index) const { return p_entries[index]; }
+    uint64_t ticks() const { return p_ticks; }
+
+private:
+    ReplayVerifier(const ReplayVerifier&);
+    ReplayVerifier &operator=(const ReplayVerifier&);
+
+    // workers take replays one by one, replays differ in length a lot,
+    // so fixed split between threads would leave some of them idle
+    void Work()
+    {
+        Game game;
+        VerifierPlatform platform;
+        Input input;
+        uint64_t ticks = 0;
+
+        for (;;) {
+            size_t index = p_next.fetch_add(1);
+            if (index >= p_count) {
+                break;
+            }
+
+            VerifyEntry &entry = p_entries[index];
+            ReplayInput replay;
+            if (!replay.Open(entry.path)) {
+                entry.status = VERIFY_BROKEN;
+                continue;
+            }
+            replay.LimitIntervals(VERIFY_MIN_INTERVAL, VERIFY_MAX_INTERVAL);
+
+            game.Reset(replay.seed());
+            platform.Reset();
+            memset(&input, 0, sizeof(input));
+
+            // same loop as headless platform, time isn't used by replay
+            // lines and score are taken before every tick, game over resets
+            // them
+            entry.ticks = 0;
+            entry.time = 0;
+            int lines = 0;
+            int score = 0;
+            while (!platform.quit() && game.game_overs() == 0) {
+                lines = game.lines();
+                score = game.score();
+
+                input.event_count = 0;
+                input.event_dropped = 0;
+                float interval = 0;
+                if (!replay.NextFrame(input, 0, interval)) {
+                    break;
+                }
+
+                game.ProcessInput(platform, input);
+                game.Update(interval);
+                ++entry.ticks;
+                entry.time += interval;
+            }
+            ticks += entry.ticks;
+
+            if (replay.broken()) {
+                entry.status = VERIFY_BROKEN;
+                continue;
+            }
+
+            if (game.game_overs() == 0) {
+                lines = game.lines();
+                score = game.score();
+            }
+            entry.lines = lines;
+            entry.score = score;
+            bool match =
+                entry.lines == entry.claimed_lines &&
+                (entry.claimed_score < 0 || entry.score == entry.claimed_score);
+            entry.status = match ? VERIFY_OK : VERIFY_MISMATCH;
+        }
+
+        p_ticks += ticks;
+    }
+
+private:
+    VerifyEntry          *p_entries;
+    char                 *p_text;  // list file text, entry paths point here
+    size_t                p_count;
+    std::atomic<size_t>   p_next;  // next replay to take
+    std::atomic<uint64_t> p_ticks;
+};
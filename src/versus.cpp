@@ -0,0 +1,291 @@
+/*
+    TETRIS FROM SCRATCH
+    (C) livingcreative, 2015
+
+    feel free to use and modify
+*/
+
+// versus mode: two boards, rows removed on one board come up as garbage on
+// the other one
+// boards know nothing about each other, they only exchange messages through
+// MessageTransport, here boards are linked in process with loopback link,
+// latency shim could be put in between to see how game plays over slow link
+
+#include "engine/engine.h"
+#include "platform/platform.h"
+
+
+// two connected transport ends in one process, messages sent to one end
+// are received on the other one in same order
+// both ends are used from one thread, like versus match loop does it
+class LoopbackLink
+{
+public:
+    enum { CAPACITY = 64 };
+
+    LoopbackLink() :
+        p_a(p_queues[1], p_queues[0]),
+        p_b(p_queues[0], p_queues[1])
+    {}
+
+    MessageTransport &a() { return p_a; }
+    MessageTransport &b() { return p_b; }
+
+private:
+    LoopbackLink(const LoopbackLink&);
+    LoopbackLink &operator=(const LoopbackLink&);
+
+    // ring of messages going one way
+    struct Queue
+    {
+        Queue() : head(0), count(0) {}
+
+        VersusMessage messages[CAPACITY];
+        size_t        head;
+        size_t        count;
+    };
+
+    class End : public MessageTransport
+    {
+    public:
+        End(Queue &outgoing, Queue &incoming) :
+            p_outgoing(outgoing),
+            p_incoming(incoming)
+        {}
+
+        bool Send(const VersusMessage &message) override
+        {
+            if (p_outgoing.count == CAPACITY) {
+                return false;
+            }
+
+            p_outgoing.messages[(p_outgoing.head + p_outgoing.count) % CAPACITY] = message;
+            ++p_outgoing.count;
+            return true;
+        }
+
+        bool Receive(VersusMessage &message, uint32_t) override
+        {
+            if (p_incoming.count == 0) {
+                return false;
+            }
+
+            message = p_incoming.messages[p_incoming.head];
+            p_incoming.head = (p_incoming.head + 1) % CAPACITY;
+            --p_incoming.count;
+            return true;
+        }
+
+    private:
+        Queue &p_outgoing;
+        Queue &p_incoming;
+    };
+
+    Queue p_queues[2];
+    End   p_a;
+    End   p_b;
+};
+
+
+// delays messages received through other transport by latency plus random
+// jitter, messages are never reordered, message waits for previous one
+// jitter comes from seeded random, so same match plays same way every time
+class LatencyTransport : public MessageTransport
+{
+public:
+    enum { CAPACITY = 64 };
+
+    LatencyTransport(MessageTransport &link, uint32_t latency, uint32_t jitter = 0, uint64_t seed = 0) :
+        p_link(link),
+        p_latency(latency),
+        p_jitter(jitter),
+        p_random(seed),
+        p_head(0),
+        p_count(0),
+        p_last_delivery(0)
+    {}
+
+    bool Send(const VersusMessage &message) override
+    {
+        return p_link.Send(message);
+    }
+
+    bool Receive(VersusMessage &message, uint32_t time) override
+    {
+        // everything link has is in flight now, delivery time is set once
+        VersusMessage incoming;
+        while (p_count < CAPACITY && p_link.Receive(incoming, time)) {
+            uint32_t delivery = incoming.time + p_latency + (p_jitter ? p_random.Next(p_jitter + 1) : 0);
+            delivery = delivery > p_last_delivery ? delivery : p_last_delivery;
+            p_last_delivery = delivery;
+
+            size_t index = (p_head + p_count) % CAPACITY;
+            p_messages[index] = incoming;
+            p_delivery[index] = delivery;
+            ++p_count;
+        }
+
+        if (p_count == 0 || p_delivery[p_head] > time) {
+            return false;
+        }
+
+        message = p_messages[p_head];
+        p_head = (p_head + 1) % CAPACITY;
+        --p_count;
+        return true;
+    }
+
+private:
+    LatencyTransport(const LatencyTransport&);
+    LatencyTransport &operator=(const LatencyTransport&);
+
+    MessageTransport &p_link;
+    uint32_t          p_latency;  // in milliseconds
+    uint32_t          p_jitter;   // max extra latency
+    Random            p_random;
+
+    VersusMessage     p_messages[CAPACITY]; // messages in flight
+    uint32_t          p_delivery[CAPACITY]; // and their delivery times
+    size_t            p_head;
+    size_t            p_count;
+    uint32_t          p_last_delivery;
+};
+
+
+// one side of versus match: sends rows removed by its game as garbage,
+// puts garbage received from opponent into its game
+class VersusBoard
+{
+public:
+    VersusBoard(Game &game, MessageTransport &transport, uint64_t seed) :
+        p_game(game),
+        p_transport(transport),
+        p_random(seed),
+        p_game_overs(game.game_overs()),
+        p_wins(0),
+        p_sent(0),
+        p_received(0)
+    {}
+
+    // called after game update, time is frame time in milliseconds
+    void Update(uint32_t time)
+    {
+        VersusMessage message;
+        message.time = time;
+
+        // hole is chosen by sender, so receiver's figure sequence isn't
+        // touched by garbage
+        int attack = p_game.TakeAttack();
+        if (attack > 0) {
+            message.type = VERSUS_GARBAGE;
+            message.count = attack;
+            message.hole = int32_t(p_random.Next(uint32_t(p_game.field_width())));
+            p_sent += p_transport.Send(message) ? attack : 0;
+        }
+
+        if (p_game.game_overs() != p_game_overs) {
+            p_game_overs = p_game.game_overs();
+            message.type = VERSUS_GAME_OVER;
+            message.count = 0;
+            message.hole = 0;
+            p_transport.Send(message);
+        }
+
+        while (p_transport.Receive(message, time)) {
+            switch (message.type) {
+                case VERSUS_GARBAGE:
+                    p_game.QueueGarbage(message.count, message.hole);
+                    p_received += message.count;
+                    break;
+
+                case VERSUS_GAME_OVER:
+                    ++p_wins;
+                    break;
+            }
+        }
+    }
+
+    int wins() const { return p_wins; }
+    int sent() const { return p_sent; }
+    int received() const { return p_received; }
+
+private:
+    VersusBoard(const VersusBoard&);
+    VersusBoard &operator=(const VersusBoard&);
+
+    Game             &p_game;
+    MessageTransport &p_transport;
+    Random            p_random;     // garbage holes
+    int               p_game_overs; // last seen game over count
+    int               p_wins;       // opponent game overs
+    int               p_sent;       // garbage rows
+    int               p_received;
+};
+
+
+// two bots playing versus match on one machine, boards are linked through
+// loopback link with latency shim on both ends, games go into pool, so
+// match is shown with spectator view
+class VersusMatch
+{
+public:
+    VersusMatch(uint64_t seed, uint32_t latency = 0, uint32_t jitter = 0) :
+        p_pool(2),
+        p_cache(1 << 16),
+        p_shim_a(p_link.a(), latency, jitter, seed),
+        p_shim_b(p_link.b(), latency, jitter, seed + 1),
+        p_game_a(*p_pool.Create(seed)),
+        p_game_b(*p_pool.Create(seed + 1)),
+        p_bot_a(p_game_a, BOT_DEFAULT_WEIGHTS, &p_cache),
+        p_bot_b(p_game_b, BOT_DEFAULT_WEIGHTS, &p_cache),
+        p_board_a(p_game_a, p_shim_a, seed),
+        p_board_b(p_game_b, p_shim_b, seed + 1)
+    {
+        memset(&p_input_a, 0, sizeof(p_input_a));
+        memset(&p_input_b, 0, sizeof(p_input_b));
+    }
+
+    void Update(PlatformAPI &api, uint32_t time, float interval)
+    {
+        UpdateSide(api, p_bot_a, p_input_a, p_game_a, time, interval);
+        UpdateSide(api, p_bot_b, p_input_b, p_game_b, time, interval);
+
+        p_board_a.Update(time);
+        p_board_b.Update(time);
+    }
+
+    GamePool &pool() { return p_pool; }
+    const VersusBoard &board_a() const { return p_board_a; }
+    const VersusBoard &board_b() const { return p_board_b; }
+
+private:
+    VersusMatch(const VersusMatch&);
+    VersusMatch &operator=(const VersusMatch&);
+
+    static void UpdateSide(PlatformAPI &api, BotInput &bot, Input &input, Game &game, uint32_t time, float interval)
+    {
+        input.event_count = 0;
+        input.event_dropped = 0;
+
+        float gameinterval = interval;
+        bot.NextFrame(input, time, gameinterval);
+
+        game.ProcessInput(api, input);
+        game.Update(gameinterval);
+    }
+
+private:
+    GamePool         p_pool;
+    HashCache        p_cache;
+    LoopbackLink     p_link;
+    LatencyTransport p_shim_a;
+    LatencyTransport p_shim_b;
+    Game            &p_game_a;
+    Game            &p_game_b;
+    BotInput         p_bot_a;
+    BotInput         p_bot_b;
+    Input            p_input_a;
+    Input            p_input_b;
+    VersusBoard      p_board_a;
+    VersusBoard      p_board_b;
+};
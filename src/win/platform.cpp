@@ -9,12 +9,17 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <Windows.h>
 #define DIRECTINPUT_VERSION 0x0800
 #include <dinput.h>
 #include <gl/GL.h>
 #include "platform/platform.h"
 
+// timeBeginPeriod()/timeEndPeriod() for frame pacing, waveOut for audio
+#pragma comment(lib, "winmm.lib")
+
 
 // output platform debug information (only for testing)
 static void DEBUGPrintVA(const char *format, va_list va)
@@ -39,10 +44,105 @@ static void DEBUGPrint(const char *format, ...)
 
 // common engine functions and implementation
 #include "engine.cpp"
+#include "opengl.cpp"
+#include "openglcore.cpp"
+#include "telemetry.cpp"
+#include "inputsource.cpp"
+#include "archive.cpp"
+#include "audio.cpp"
+
+
+// looks for "name value" pair in command line and copies value
+// returns false if there's no such option
+static bool CommandLineOption(const char *name, char *value, size_t size)
+{
+    const char *cmdline = GetCommandLineA();
+    size_t namelength = strlen(name);
+
+    for (const char *option = strstr(cmdline, name); option; option = strstr(option + 1, name)) {
+        // option should be whole separate word
+        bool wordstart = option == cmdline || option[-1] == ' ' || option[-1] == '\t';
+        bool wordend = option[namelength] == ' ' || option[namelength] == '\t' || option[namelength] == 0;
+        if (!wordstart || !wordend) {
+            continue;
+        }
+
+        const char *start = option + namelength;
+        while (*start == ' ' || *start == '\t') {
+            ++start;
+        }
+
+        size_t length = 0;
+        while (start[length] && start[length] != ' ' && start[length] != '\t' && length + 1 < size) {
+            value[length] = start[length];
+            ++length;
+        }
+        value[length] = 0;
+
+        return true;
+    }
+
+    return false;
+}
+
+// converts performance counter interval into microseconds
+static uint64_t Microseconds(const LARGE_INTEGER &from, const LARGE_INTEGER &to, const LARGE_INTEGER &frequency)
+{
+    // whole seconds are converted separately, so long intervals don't overflow
+    int64_t ticks = to.QuadPart - from.QuadPart;
+    return uint64_t(ticks / frequency.QuadPart * 1000000 + ticks % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+
+// frame pacing
+// Sleep() wakes up on system timer tick only (1 ms at best with
+// timeBeginPeriod(1)), so pacer sleeps only coarse part of the wait and
+// the rest is spun on performance counter, which is precise
+// times are microseconds since start
+static void WaitForFrame(FramePacer &pacer, const LARGE_INTEGER &start, const LARGE_INTEGER &frequency)
+{
+    for (;;) {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        uint64_t nowus = Microseconds(start, now, frequency);
+        if (pacer.Ready(nowus)) {
+            return;
+        }
+
+        if (uint64_t sleep = pacer.SleepTime(nowus)) {
+            Sleep(DWORD(sleep / 1000));
+
+            LARGE_INTEGER wakeup;
+            QueryPerformanceCounter(&wakeup);
+            pacer.Slept(sleep / 1000 * 1000, Microseconds(now, wakeup, frequency));
+        } else {
+            YieldProcessor();
+        }
+    }
+}
+
+// refresh rate of the display window is on, 0 if unknown
+static int DisplayRefreshRate(HWND window)
+{
+    MONITORINFOEXA info = {};
+    info.cbSize = sizeof(info);
+    if (!GetMonitorInfoA(MonitorFromWindow(window, MONITOR_DEFAULTTOPRIMARY), &info)) {
+        return 0;
+    }
+
+    DEVMODEA mode = {};
+    mode.dmSize = sizeof(mode);
+    if (!EnumDisplaySettingsA(info.szDevice, ENUM_CURRENT_SETTINGS, &mode)) {
+        return 0;
+    }
+
+    // 0 and 1 mean "hardware default"
+    return mode.dmDisplayFrequency > 1 ? int(mode.dmDisplayFrequency) : 0;
+}
 
 
 // platform API implementation
-class WindowsPlatform : public PlatformAPI, public OpenGLAPI
+class WindowsPlatform : public PlatformAPI
 {
 public:
     void Quit() override
@@ -59,50 +159,28 @@ public:
         va_end(va);
 #endif
     }
-
-    void UpdateRenderTargetSize(int width, int height)
-    {
-        p_rt_width = width;
-        p_rt_height = height;
-    }
-
-protected:
-    void GetRenderTargetSize(int &width, int &height) override
-    {
-        width = p_rt_width;
-        height = p_rt_height;
-    }
-
-private:
-    int p_rt_width;
-    int p_rt_height;
 };
 
 
 // function for complete game frame render
 // used in main loop and WndProc WM_PAINT message to update window contents
 // while doing system ops such as moving or resizing which block main loop
-static void RenderGameFrame(WindowsPlatform &api, HWND mainwindow, HDC gldc, Game &game)
+// when spectator view is on, bot games are shown instead of the game
+static void RenderGameFrame(OpenGLRenderer &graphics, HWND mainwindow, HDC gldc, Game &game, Spectator *spectator, BotGames *spectate)
 {
-    // set full window viewport for testing
+    // full window viewport
     RECT rc;
     GetClientRect(mainwindow, &rc);
-    api.UpdateRenderTargetSize(rc.right, rc.bottom);
-    glViewport(0, 0, rc.right, rc.bottom);
+    graphics.BeginFrame(rc.right, rc.bottom);
 
     if (rc.right && rc.bottom) {
-        // set default ortho projection matrix for 2D rendering
-        GLfloat projection[16] = {
-            2 / float(rc.right), 0, 0, 0,
-            0, -2 / float(rc.bottom), 0, 0,
-            0, 0, 1, 0,
-            -1, 1, 0, 1
-        };
-        glMatrixMode(GL_PROJECTION);
-        glLoadMatrixf(projection);
-
         // ask game to render
-        game.RenderGraphics(api, rc.right, rc.bottom);
+        if (spectate) {
+            spectator->Render(graphics, spectate->pool(), rc.right, rc.bottom);
+        } else {
+            game.RenderGraphics(graphics, rc.right, rc.bottom);
+        }
+        graphics.EndFrame();
 
         // display render result
         SwapBuffers(gldc);
@@ -110,15 +188,71 @@ static void RenderGameFrame(WindowsPlatform &api, HWND mainwindow, HDC gldc, Gam
 }
 
 
+// OpenGL functions for core profile renderer, wglGetProcAddress() gives
+// some odd small values instead of nullptr for missing functions
+static void *WGLProcAddress(const char *name)
+{
+    PROC proc = wglGetProcAddress(name);
+    intptr_t value = reinterpret_cast<intptr_t>(proc);
+    return value >= -1 && value <= 3 ? nullptr : reinterpret_cast<void*>(proc);
+}
+
+// core profile context through WGL_ARB_create_context, legacy context
+// should be current, returns 0 if there's no such extension or context
+// can't be made
+static HGLRC CreateCoreContext(HDC gldc)
+{
+    typedef HGLRC (WINAPI *CreateContextAttribsFunction)(HDC, HGLRC, const int*);
+    CreateContextAttribsFunction createcontext = reinterpret_cast<CreateContextAttribsFunction>(
+        WGLProcAddress("wglCreateContextAttribsARB")
+    );
+    if (createcontext == nullptr) {
+        return 0;
+    }
+
+    // WGL_CONTEXT_MAJOR_VERSION_ARB, WGL_CONTEXT_MINOR_VERSION_ARB,
+    // WGL_CONTEXT_PROFILE_MASK_ARB with WGL_CONTEXT_CORE_PROFILE_BIT_ARB
+    const int attributes[] = {
+        0x2091, 3,
+        0x2092, 3,
+        0x9126, 0x0001,
+        0
+    };
+    return createcontext(gldc, 0, attributes);
+}
+
+
+// frames are paced by FramePacer (or not paced at all with -benchmark), so
+// driver vsync, which is usually on by default, would only make
+// SwapBuffers() wait on top of that, it's turned off through
+// WGL_EXT_swap_control, returns false if driver has no such extension or
+// refuses, context should be current
+static bool DisableVSync()
+{
+    typedef BOOL (WINAPI *SwapIntervalFunction)(int);
+    SwapIntervalFunction swapinterval = reinterpret_cast<SwapIntervalFunction>(
+        WGLProcAddress("wglSwapIntervalEXT")
+    );
+    return swapinterval && swapinterval(0);
+}
+
+
 // window class name
 static const char *MAIN_WINDOW_CLASS = "TETRISFROMSCRATCH";
 
+// joystick/gamepad devices, see below
+class InputDeviceWatcher;
+static void RescanInputDevices(InputDeviceWatcher &devices);
+
 // data passed to window, used to access some objects inside WndProc
 struct WindowData
 {
-    HDC             *gldc;
-    WindowsPlatform *api;
-    Game            *game;
+    HDC                *gldc;
+    InputDeviceWatcher *devices;
+    OpenGLRenderer     *graphics;
+    Game               *game;
+    Spectator          *spectator;
+    BotGames           *spectate;
 };
 
 // window callback function, used to react for system messages to window
@@ -138,7 +272,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM l
                 GetWindowLongPtrA(hwnd, GWLP_USERDATA)
             );
 
-            if (data == nullptr || data->api == nullptr || data->game == nullptr) {
+            if (data == nullptr || data->graphics == nullptr || data->game == nullptr) {
                 // break to default processing
                 break;
             } else {
@@ -146,7 +280,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM l
                 BeginPaint(hwnd, &ps);
                 EndPaint(hwnd, &ps);
 
-                RenderGameFrame(*data->api, hwnd, *data->gldc, *data->game);
+                RenderGameFrame(*data->graphics, hwnd, *data->gldc, *data->game, data->spectator, data->spectate);
 
                 return 0;
             }
@@ -157,6 +291,17 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM l
                 break;
             }
             return 0;
+
+        case WM_DEVICECHANGE: {
+            // some device was plugged in or removed, look for joysticks again
+            WindowData *data = reinterpret_cast<WindowData*>(
+                GetWindowLongPtrA(hwnd, GWLP_USERDATA)
+            );
+            if (data && data->devices) {
+                RescanInputDevices(*data->devices);
+            }
+            return TRUE;
+        }
     }
 
     // process all other messages with system default handler
@@ -166,6 +311,41 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM l
 
 // Direct Input related stuff
 
+// size of device buffer for buffered joystick/gamepad input, in device events
+static const DWORD JOYSTICK_BUFFER_SIZE = 64;
+
+// devices listed by one scan, all attached devices should be there, device
+// missing from scan is taken for removed one, joystick slot limit applies
+// only when devices are attached
+static const size_t INPUT_DEVICE_SCAN_COUNT = 32;
+
+// polled joysticks don't signal their changes, so while main loop waits for
+// input they're still checked this often, in milliseconds
+static const DWORD JOYSTICK_IDLE_POLL = 100;
+
+// joystick/gamepad axis configuration
+// dead zone is applied by DirectInput itself, in 1/10000 of axis range,
+// values inside dead zone are reported as axis center
+// threshold is minimal change of axis value (in axis units) which generates
+// INPUT_AXIS event, this filters noise of analog sticks
+struct JoyAxisConfig
+{
+    DWORD offset;
+    DWORD deadzone;
+    int   threshold;
+};
+
+static const JoyAxisConfig JOY_AXES[JOY_AXIS_COUNT] = {
+    { DIJOFS_X,         1500, 512 },
+    { DIJOFS_Y,         1500, 512 },
+    { DIJOFS_Z,         1500, 512 },
+    { DIJOFS_RX,        1500, 512 },
+    { DIJOFS_RY,        1500, 512 },
+    { DIJOFS_RZ,        1500, 512 },
+    { DIJOFS_SLIDER(0),    0, 256 },
+    { DIJOFS_SLIDER(1),    0, 256 }
+};
+
 // input device data
 struct InputDevice
 {
@@ -177,13 +357,13 @@ struct InputDevice
 struct InputDeviceList
 {
     size_t      count;
-    InputDevice devices[JOYSTICK_DEVICE_COUNT];
+    InputDevice devices[INPUT_DEVICE_SCAN_COUNT];
 };
 
 // generate mouse button events and set corresponding state
-static void MouseButtonEvent(Input &input, InputMouseButton button, bool down)
+static void MouseButtonEvent(Input &input, InputMouseButton button, bool down, uint32_t time)
 {
-    if (InputEvent *event = new_event(input)) {
+    if (InputEvent *event = new_event(input, time)) {
         event->type = down ? INPUT_MOUSE_DOWN : INPUT_MOUSE_UP;
         event->mouse.button = button;
         event->mouse.wheel = 0;
@@ -199,9 +379,9 @@ static void MouseButtonEvent(Input &input, InputMouseButton button, bool down)
 }
 
 // generate keyboard event and set state
-static void KeyboardEvent(Input &input, InputKey key, bool down)
+static void KeyboardEvent(Input &input, InputKey key, bool down, uint32_t time)
 {
-    if (InputEvent *event = new_event(input)) {
+    if (InputEvent *event = new_event(input, time)) {
         event->type = down ? INPUT_KEY_DOWN : INPUT_KEY_UP;
         event->keyboard.key = key;
     }
@@ -243,12 +423,54 @@ static void KeyboardEvent(Input &input, InputKey key, bool down)
     }
 }
 
+// compare joystick/gamepad button state and generate input event
+static void CheckJoyButton(Input &input, uint32_t joynum, uint32_t button, bool down, uint32_t time)
+{
+    uint32_t button_bit = 1 << button;
+    bool oldstate = (input.joystick[joynum].buttons & button_bit) != 0;
+
+    if (oldstate != down) {
+        if (InputEvent *event = new_event(input, time)) {
+            event->type = down ? INPUT_BUTTON_DOWN : INPUT_BUTTON_UP;
+            event->joystick.number = joynum;
+            event->joystick.button = InputJoystickButton(button);
+        }
+    }
+
+    if (down) {
+        input.joystick[joynum].buttons |= button_bit;
+    } else {
+        input.joystick[joynum].buttons &= ~button_bit;
+    }
+}
+
+// compare joystick/gamepad POV state and generate input event
+static void CheckJoyPOV(Input &input, uint32_t joynum, uint32_t pov, int povvalue, uint32_t time)
+{
+    if (input.joystick[joynum].povs[pov] != povvalue) {
+        input.joystick[joynum].povs[pov] = povvalue;
+        if (InputEvent *event = new_event(input, time)) {
+            event->type = INPUT_POV;
+            event->joystick.number = joynum;
+            event->joystick.pov.pov = InputJoystickPOV(pov);
+            event->joystick.pov.value = povvalue;
+        }
+    }
+}
+
 // compare joystick/gamepad axis state and generate input event
-static void CheckJoyAxis(Input &input, uint32_t joynum, uint32_t axisnumber, int axisvalue)
+// axis state holds last reported value, so slow drift still gets reported
+// once it accumulates above threshold
+static void CheckJoyAxis(Input &input, uint32_t joynum, uint32_t axisnumber, int axisvalue, uint32_t time)
 {
-    if (input.joystick[joynum].axes[axisnumber] != axisvalue) {
+    int change = axisvalue - input.joystick[joynum].axes[axisnumber];
+    if (change < 0) {
+        change = -change;
+    }
+
+    if (change > 0 && change >= JOY_AXES[axisnumber].threshold) {
         input.joystick[joynum].axes[axisnumber] = axisvalue;
-        if (InputEvent *event = new_event(input)) {
+        if (InputEvent *event = new_event(input, time)) {
             event->type = INPUT_AXIS;
             event->joystick.number = joynum;
             event->joystick.axis.axis = InputJoystickAxis(axisnumber);
@@ -257,12 +479,124 @@ static void CheckJoyAxis(Input &input, uint32_t joynum, uint32_t axisnumber, int
     }
 }
 
+// set up joystick/gamepad device for buffered input
+static void SetupJoystick(IDirectInputDevice8A *device, HWND window, HANDLE notification)
+{
+    device->SetCooperativeLevel(window, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
+    device->SetDataFormat(&c_dfDIJoystick);
+
+    // event is signaled on device state change, so idle main loop could
+    // wait for it, it should be set before device is acquired
+    if (notification) {
+        device->SetEventNotification(notification);
+    }
+
+    DIPROPDWORD prop = {};
+    prop.diph.dwSize = sizeof(DIPROPDWORD);
+    prop.diph.dwHeaderSize = sizeof(DIPROPHEADER);
+
+    // device keeps changes in its buffer between frames
+    prop.diph.dwObj = 0;
+    prop.diph.dwHow = DIPH_DEVICE;
+    prop.dwData = JOYSTICK_BUFFER_SIZE;
+    device->SetProperty(DIPROP_BUFFERSIZE, &prop.diph);
+
+    // set up dead zones, missing axes just fail to set property
+    prop.diph.dwHow = DIPH_BYOFFSET;
+    for (uint32_t axis = 0; axis < JOY_AXIS_COUNT; ++axis) {
+        prop.diph.dwObj = JOY_AXES[axis].offset;
+        prop.dwData = JOY_AXES[axis].deadzone;
+        device->SetProperty(DIPROP_DEADZONE, &prop.diph);
+    }
+}
+
+// get full device state and generate events for all changes
+// used when device buffer can't be trusted (device just acquired or buffer overflow)
+static void SyncJoystickState(Input &input, uint32_t joynum, IDirectInputDevice8A *device, uint32_t time)
+{
+    DIJOYSTATE state = {};
+    if (device->GetDeviceState(sizeof(state), &state) != DI_OK) {
+        return;
+    }
+
+    for (uint32_t btn = 0; btn < JOY_BUTTON_COUNT; ++btn) {
+        CheckJoyButton(input, joynum, btn, state.rgbButtons[btn] >= 128, time);
+    }
+
+    for (uint32_t pov = 0; pov < JOY_POV_COUNT; ++pov) {
+        CheckJoyPOV(input, joynum, pov, int(state.rgdwPOV[pov]), time);
+    }
+
+    CheckJoyAxis(input, joynum, JOY_AXIS_0, state.lX, time);
+    CheckJoyAxis(input, joynum, JOY_AXIS_1, state.lY, time);
+    CheckJoyAxis(input, joynum, JOY_AXIS_2, state.lZ, time);
+    CheckJoyAxis(input, joynum, JOY_AXIS_3, state.lRx, time);
+    CheckJoyAxis(input, joynum, JOY_AXIS_4, state.lRy, time);
+    CheckJoyAxis(input, joynum, JOY_AXIS_5, state.lRz, time);
+    CheckJoyAxis(input, joynum, JOY_AXIS_6, state.rglSlider[0], time);
+    CheckJoyAxis(input, joynum, JOY_AXIS_7, state.rglSlider[1], time);
+}
+
+// translate single buffered device change into input event
+static void JoystickDataEvent(Input &input, uint32_t joynum, const DIDEVICEOBJECTDATA &data)
+{
+    DWORD offset = data.dwOfs;
+    uint32_t time = data.dwTimeStamp;
+
+    if (offset >= DIJOFS_BUTTON(0) && offset < DIJOFS_BUTTON(JOY_BUTTON_COUNT)) {
+        CheckJoyButton(input, joynum, offset - DIJOFS_BUTTON(0), (data.dwData & 0x80) != 0, time);
+    } else if (offset >= DIJOFS_POV(0) && offset < DIJOFS_POV(JOY_POV_COUNT)) {
+        CheckJoyPOV(input, joynum, (offset - DIJOFS_POV(0)) / sizeof(DWORD), int(data.dwData), time);
+    } else {
+        for (uint32_t axis = 0; axis < JOY_AXIS_COUNT; ++axis) {
+            if (JOY_AXES[axis].offset == offset) {
+                CheckJoyAxis(input, joynum, axis, int(data.dwData), time);
+                break;
+            }
+        }
+    }
+}
+
+// read all changes buffered by device since last frame
+static void ReadJoystick(Input &input, uint32_t joynum, IDirectInputDevice8A *device)
+{
+    // polled devices fill their buffer only on Poll() call,
+    // for other devices this does nothing
+    device->Poll();
+
+    DIDEVICEOBJECTDATA data[JOYSTICK_BUFFER_SIZE];
+    DWORD count = JOYSTICK_BUFFER_SIZE;
+    HRESULT result = device->GetDeviceData(sizeof(DIDEVICEOBJECTDATA), data, &count, 0);
+
+    if (result == DIERR_INPUTLOST || result == DIERR_NOTACQUIRED) {
+        // device isn't acquired (yet or anymore), everything which happened
+        // meanwhile is lost, so pick up whole state once acquired
+        if (SUCCEEDED(device->Acquire())) {
+            SyncJoystickState(input, joynum, device, GetTickCount());
+        }
+        return;
+    }
+
+    if (FAILED(result)) {
+        return;
+    }
+
+    for (DWORD n = 0; n < count; ++n) {
+        JoystickDataEvent(input, joynum, data[n]);
+    }
+
+    if (result == DI_BUFFEROVERFLOW) {
+        // some changes were dropped by device, state could be out of sync
+        SyncJoystickState(input, joynum, device, GetTickCount());
+    }
+}
+
 // callback function for IDirectInput8A::EnumDevices, records devices to InputDeviceList
 // passed via pvRef
 static BOOL CALLBACK DIEnumDevicesCallback(LPCDIDEVICEINSTANCEA lpddi, LPVOID pvRef)
 {
     InputDeviceList *devlist = reinterpret_cast<InputDeviceList*>(pvRef);
-    if (devlist->count < JOYSTICK_DEVICE_COUNT) {
+    if (devlist->count < INPUT_DEVICE_SCAN_COUNT) {
         DEBUGPrint("Joystick device #%i, \"%s\"\n", devlist->count, lpddi->tszProductName);
 
         devlist->devices[devlist->count].giud = lpddi->guidInstance;
@@ -273,6 +607,566 @@ static BOOL CALLBACK DIEnumDevicesCallback(LPCDIDEVICEINSTANCEA lpddi, LPVOID pv
     return TRUE;
 }
 
+static bool FindInputDevice(const InputDeviceList &devlist, const GUID &guid, size_t &index)
+{
+    for (index = 0; index < devlist.count; ++index) {
+        if (IsEqualGUID(devlist.devices[index].giud, guid)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// joysticks/gamepads are found and opened on background thread, so slow
+// device enumeration doesn't hold window and first frame
+// thread scans devices once started and then on every Rescan() (window gets
+// WM_DEVICECHANGE when devices come and go), main thread picks up scan
+// results in Update(), attaches new devices to free joystick slots and
+// detaches removed ones
+// scan lists all devices, but thread creates only as many of not attached
+// devices as there are free slots, rest of them wait in the list without
+// device object, when slot frees main thread asks for new scan, which
+// creates waiting device then
+class InputDeviceWatcher
+{
+public:
+    InputDeviceWatcher() :
+        p_instance(0),
+        p_window(0),
+        p_input(nullptr),
+        p_thread(0),
+        p_wake(0),
+        p_notification(0),
+        p_quit(0),
+        p_ready(0)
+    {
+        memset(&p_devices, 0, sizeof(p_devices));
+        memset(&p_found, 0, sizeof(p_found));
+        memset(&p_attached, 0, sizeof(p_attached));
+        p_devices.count = JOYSTICK_DEVICE_COUNT;
+        InitializeCriticalSection(&p_lock);
+    }
+
+    ~InputDeviceWatcher()
+    {
+        Stop();
+        DeleteCriticalSection(&p_lock);
+    }
+
+    // devices are set up for given window
+    void Start(HINSTANCE instance, HWND window)
+    {
+        p_instance = instance;
+        p_window = window;
+
+        // shared by all devices, created before any device
+        p_notification = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+
+        // event starts signaled, so first scan goes right away
+        p_wake = CreateEventA(nullptr, FALSE, TRUE, nullptr);
+        if (p_wake) {
+            p_thread = CreateThread(nullptr, 0, ThreadProc, this, 0, nullptr);
+        }
+
+        if (p_thread == 0) {
+            DEBUGPrint("Couldn't start input device thread!\n");
+        }
+    }
+
+    void Stop()
+    {
+        if (p_thread) {
+            InterlockedExchange(&p_quit, 1);
+            SetEvent(p_wake);
+            WaitForSingleObject(p_thread, INFINITE);
+            CloseHandle(p_thread);
+            p_thread = 0;
+        }
+
+        if (p_wake) {
+            CloseHandle(p_wake);
+            p_wake = 0;
+        }
+
+        // devices go before DirectInput object they were created with
+        for (size_t dev = 0; dev < JOYSTICK_DEVICE_COUNT; ++dev) {
+            ReleaseDevice(p_devices.devices[dev].device);
+            ReleaseDevice(p_found.devices[dev].device);
+        }
+
+        if (p_input) {
+            p_input->Release();
+            p_input = nullptr;
+        }
+
+        if (p_notification) {
+            CloseHandle(p_notification);
+            p_notification = 0;
+        }
+    }
+
+    // asks for new scan, called from window procedure
+    void Rescan()
+    {
+        if (p_wake) {
+            SetEvent(p_wake);
+        }
+    }
+
+    // applies last scan results, generates INPUT_CONNECT and INPUT_DISCONNECT
+    // events, called every frame on main thread, does nothing until
+    // there's new scan
+    void Update(Input &input, uint32_t time)
+    {
+        if (InterlockedExchange(&p_ready, 0) == 0) {
+            return;
+        }
+
+        // newly created devices are owned by main thread from now on
+        InputDeviceList found;
+        EnterCriticalSection(&p_lock);
+        found = p_found;
+        for (size_t dev = 0; dev < p_found.count; ++dev) {
+            p_found.devices[dev].device = nullptr;
+        }
+        LeaveCriticalSection(&p_lock);
+
+        size_t index;
+        bool removed = false;
+        for (uint32_t slot = 0; slot < JOYSTICK_DEVICE_COUNT; ++slot) {
+            InputDevice &attached = p_devices.devices[slot];
+            if (attached.device && !FindInputDevice(found, attached.giud, index)) {
+                removed = true;
+                DEBUGPrint("Joystick #%u removed\n", slot);
+                ReleaseDevice(attached.device);
+                DeviceEvent(input, INPUT_DISCONNECT, slot, time);
+
+                InputJoystickState empty = {};
+                input.joystick[slot] = empty;
+            }
+        }
+
+        // devices which don't fit into free slots are dropped, they aren't
+        // attached, so thread offers them again with next scan
+        // device could be created again before thread sees it attached
+        for (size_t dev = 0; dev < found.count; ++dev) {
+            if (found.devices[dev].device == nullptr) {
+                continue;
+            }
+
+            if (Attached(found.devices[dev].giud)) {
+                ReleaseDevice(found.devices[dev].device);
+                continue;
+            }
+
+            uint32_t slot = 0;
+            while (slot < JOYSTICK_DEVICE_COUNT && p_devices.devices[slot].device) {
+                ++slot;
+            }
+
+            if (slot == JOYSTICK_DEVICE_COUNT) {
+                ReleaseDevice(found.devices[dev].device);
+                continue;
+            }
+
+            DEBUGPrint("Joystick #%u attached\n", slot);
+            p_devices.devices[slot] = found.devices[dev];
+            DeviceEvent(input, INPUT_CONNECT, slot, time);
+        }
+
+        // thread only needs to know which devices not to create
+        InputDeviceList attached = {};
+        for (uint32_t slot = 0; slot < JOYSTICK_DEVICE_COUNT; ++slot) {
+            if (p_devices.devices[slot].device) {
+                attached.devices[attached.count++].giud = p_devices.devices[slot].giud;
+            }
+        }
+        EnterCriticalSection(&p_lock);
+        p_attached = attached;
+        LeaveCriticalSection(&p_lock);
+
+        // devices waiting for a slot get it with next scan, only removal
+        // asks for it, so device which can't be created isn't asked for
+        // again and again
+        if (removed && attached.count < JOYSTICK_DEVICE_COUNT) {
+            for (size_t dev = 0; dev < found.count; ++dev) {
+                if (found.devices[dev].device == nullptr && !Attached(found.devices[dev].giud)) {
+                    Rescan();
+                    break;
+                }
+            }
+        }
+    }
+
+    // attached devices by joystick slot, empty slots have no device
+    const InputDeviceList &devices() const { return p_devices; }
+
+    bool attached() const
+    {
+        for (size_t dev = 0; dev < JOYSTICK_DEVICE_COUNT; ++dev) {
+            if (p_devices.devices[dev].device) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // event signaled by any attached device on its state change
+    HANDLE notification() const { return p_notification; }
+
+private:
+    InputDeviceWatcher(const InputDeviceWatcher&);
+    InputDeviceWatcher &operator=(const InputDeviceWatcher&);
+
+    // removed devices leave their guid in empty slot, so only slots with
+    // device count
+    bool Attached(const GUID &guid) const
+    {
+        for (size_t slot = 0; slot < JOYSTICK_DEVICE_COUNT; ++slot) {
+            const InputDevice &device = p_devices.devices[slot];
+            if (device.device && IsEqualGUID(device.giud, guid)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static DWORD WINAPI ThreadProc(LPVOID param)
+    {
+        reinterpret_cast<InputDeviceWatcher*>(param)->Run();
+        return 0;
+    }
+
+    void Run()
+    {
+        // even creation of DirectInput could take a while
+        DirectInput8Create(p_instance, DIRECTINPUT_VERSION, IID_IDirectInput8A, reinterpret_cast<LPVOID*>(&p_input), nullptr);
+        if (p_input == nullptr) {
+            // Direct input isn't critical part, game can be run without
+            // any Direct Input devices, just log failure
+            DEBUGPrint(
+                "Couldn't initialize DirectInput, "
+                "running game without game controller support!\n"
+            );
+            return;
+        }
+
+        while (WaitForSingleObject(p_wake, INFINITE) == WAIT_OBJECT_0 && p_quit == 0) {
+            InputDeviceList found = {};
+            p_input->EnumDevices(DI8DEVCLASS_GAMECTRL, DIEnumDevicesCallback, &found, DIEDFL_ATTACHEDONLY);
+
+            // devices of previous scan which main thread didn't pick up yet
+            // are taken back, so nothing is created twice, attached devices
+            // are main thread's already
+            InputDeviceList pending;
+            InputDeviceList attached;
+            EnterCriticalSection(&p_lock);
+            pending = p_found;
+            attached = p_attached;
+            for (size_t dev = 0; dev < p_found.count; ++dev) {
+                p_found.devices[dev].device = nullptr;
+            }
+            LeaveCriticalSection(&p_lock);
+
+            // only devices which could get a slot are created, others just
+            // stay listed, so they aren't taken for removed ones
+            size_t index;
+            size_t freeslots = JOYSTICK_DEVICE_COUNT - attached.count;
+            for (size_t dev = 0; dev < found.count; ++dev) {
+                InputDevice &device = found.devices[dev];
+
+                if (FindInputDevice(attached, device.giud, index) || freeslots == 0) {
+                    continue;
+                }
+                --freeslots;
+
+                if (FindInputDevice(pending, device.giud, index) && pending.devices[index].device) {
+                    device.device = pending.devices[index].device;
+                    pending.devices[index].device = nullptr;
+                    continue;
+                }
+
+                p_input->CreateDevice(device.giud, &device.device, nullptr);
+                if (device.device) {
+                    SetupJoystick(device.device, p_window, p_notification);
+                }
+            }
+
+            // pending devices which are gone already or don't fit anymore
+            for (size_t dev = 0; dev < pending.count; ++dev) {
+                ReleaseDevice(pending.devices[dev].device);
+            }
+
+            EnterCriticalSection(&p_lock);
+            p_found = found;
+            LeaveCriticalSection(&p_lock);
+            InterlockedExchange(&p_ready, 1);
+        }
+    }
+
+    static void ReleaseDevice(IDirectInputDevice8A *&device)
+    {
+        if (device) {
+            device->Unacquire();
+            device->Release();
+            device = nullptr;
+        }
+    }
+
+    static void DeviceEvent(Input &input, InputEventType type, uint32_t slot, uint32_t time)
+    {
+        if (InputEvent *event = new_event(input, time)) {
+            event->type = type;
+            event->joystick.number = slot;
+        }
+    }
+
+private:
+    HINSTANCE        p_instance;
+    HWND             p_window;
+    IDirectInput8A  *p_input;
+    HANDLE           p_thread;
+    HANDLE           p_wake;    // signaled when devices should be scanned
+    HANDLE           p_notification; // signaled by devices, see SetupJoystick()
+    volatile LONG    p_quit;
+    volatile LONG    p_ready;   // there's scan result not picked up yet
+    CRITICAL_SECTION p_lock;    // guards p_found and p_attached
+    InputDeviceList  p_found;   // last scan result, only new devices have device object
+    InputDeviceList  p_attached; // guids of attached devices for thread, no device objects
+    InputDeviceList  p_devices; // attached devices, owned by main thread
+};
+
+static void RescanInputDevices(InputDeviceWatcher &devices)
+{
+    devices.Rescan();
+}
+
+// blocks main loop until window gets a message or joystick reports something
+// used when there's nothing to update and render, so paused or minimized
+// game doesn't use CPU at all
+static void WaitForInput(const InputDeviceWatcher &devices)
+{
+    HANDLE notification = devices.notification();
+    MsgWaitForMultipleObjectsEx(
+        notification ? 1 : 0, &notification,
+        devices.attached() ? JOYSTICK_IDLE_POLL : INFINITE,
+        QS_ALLINPUT, MWMO_INPUTAVAILABLE
+    );
+}
+
+
+// input from real devices: window messages for mouse and keyboard and
+// buffered DirectInput joysticks/gamepads
+// message queue is pumped here, so this source should be asked for input
+// every frame even when game is driven by other source
+class WindowsInput : public InputSource
+{
+public:
+    WindowsInput(InputDeviceWatcher &devices) :
+        p_devices(devices)
+    {}
+
+    // returns false when WM_QUIT is received
+    bool NextFrame(Input &input, uint32_t, float &) override
+    {
+        bool running = true;
+
+        // pull out all system messages from queue
+        MSG msg;
+        while (PeekMessageA(&msg, 0, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                running = false;
+            }
+
+            TranslateMessage(&msg);
+            DispatchMessageA(&msg);
+
+            // process input from mouse/keyboard and some other messages
+            switch (msg.message) {
+                case WM_MOUSEMOVE: {
+                    POINTS *pt = reinterpret_cast<POINTS*>(&msg.lParam);
+
+                    if (InputEvent *event = new_event(input, msg.time)) {
+                        event->type = INPUT_MOUSE_MOVE;
+                        event->mouse.button = MOUSE_BUTTON_COUNT;
+                        event->mouse.wheel = 0;
+                        event->mouse.x = pt->x;
+                        event->mouse.y = pt->y;
+                    }
+
+                    input.mouse.x = pt->x;
+                    input.mouse.y = pt->y;
+
+                    break;
+                }
+
+                case WM_LBUTTONDOWN:
+                    MouseButtonEvent(input, MOUSE_BUTTON_LEFT, true, msg.time);
+                    break;
+
+                case WM_LBUTTONUP:
+                    MouseButtonEvent(input, MOUSE_BUTTON_LEFT, false, msg.time);
+                    break;
+
+                case WM_RBUTTONDOWN:
+                    MouseButtonEvent(input, MOUSE_BUTTON_RIGHT, true, msg.time);
+                    break;
+
+                case WM_RBUTTONUP:
+                    MouseButtonEvent(input, MOUSE_BUTTON_RIGHT, false, msg.time);
+                    break;
+
+                case WM_SYSKEYDOWN:
+                case WM_KEYDOWN:
+                    KeyboardEvent(input, InputKey(msg.wParam), true, msg.time);
+                    break;
+
+                case WM_SYSKEYUP:
+                case WM_KEYUP:
+                    KeyboardEvent(input, InputKey(msg.wParam), false, msg.time);
+                    break;
+            }
+        }
+
+        // devices could come and go at any time
+        p_devices.Update(input, GetTickCount());
+
+        // process input from joystick/gamepad, only changes since last
+        // frame are read from device buffers
+        const InputDeviceList &devlist = p_devices.devices();
+        for (uint32_t dev = 0; dev < devlist.count; ++dev) {
+            if (IDirectInputDevice8A *device = devlist.devices[dev].device) {
+                ReadJoystick(input, dev, device);
+            }
+        }
+
+        return running;
+    }
+
+private:
+    WindowsInput(const WindowsInput&);
+    WindowsInput &operator=(const WindowsInput&);
+
+    InputDeviceWatcher &p_devices;
+};
+
+
+// audio output through waveOut, few short buffers are queued to the device,
+// Write() waits until device is done with the oldest one
+class WaveOutAudioOutput : public AudioOutput
+{
+public:
+    enum { BUFFER_COUNT = 3 };
+
+    WaveOutAudioOutput() :
+        p_device(0),
+        p_event(0),
+        p_next(0)
+    {
+        memset(p_headers, 0, sizeof(p_headers));
+    }
+
+    ~WaveOutAudioOutput()
+    {
+        Close();
+    }
+
+    bool Open(size_t frames)
+    {
+        p_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+        if (p_event == 0) {
+            return false;
+        }
+
+        WAVEFORMATEX format = {};
+        format.wFormatTag = WAVE_FORMAT_PCM;
+        format.nChannels = 2;
+        format.nSamplesPerSec = AUDIO_SAMPLE_RATE;
+        format.wBitsPerSample = 16;
+        format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+        format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+        MMRESULT result = waveOutOpen(
+            &p_device, WAVE_MAPPER, &format,
+            DWORD_PTR(p_event), 0, CALLBACK_EVENT
+        );
+        if (result != MMSYSERR_NOERROR) {
+            p_device = 0;
+            Close();
+            return false;
+        }
+
+        // buffers are marked as done, so first writes don't wait
+        for (int n = 0; n < BUFFER_COUNT; ++n) {
+            WAVEHDR &header = p_headers[n];
+            header.lpData = reinterpret_cast<LPSTR>(new int16_t[frames * 2]);
+            header.dwBufferLength = DWORD(frames * 2 * sizeof(int16_t));
+            waveOutPrepareHeader(p_device, &header, sizeof(header));
+            header.dwFlags |= WHDR_DONE;
+        }
+
+        p_frames = frames;
+        p_next = 0;
+        return true;
+    }
+
+    void Close()
+    {
+        if (p_device) {
+            waveOutReset(p_device);
+            for (int n = 0; n < BUFFER_COUNT; ++n) {
+                waveOutUnprepareHeader(p_device, p_headers + n, sizeof(WAVEHDR));
+            }
+            waveOutClose(p_device);
+            p_device = 0;
+        }
+
+        for (int n = 0; n < BUFFER_COUNT; ++n) {
+            delete[] reinterpret_cast<int16_t*>(p_headers[n].lpData);
+        }
+        memset(p_headers, 0, sizeof(p_headers));
+
+        if (p_event) {
+            CloseHandle(p_event);
+            p_event = 0;
+        }
+    }
+
+    bool Write(const int16_t *samples, size_t frames) override
+    {
+        if (p_device == 0 || frames > p_frames) {
+            return false;
+        }
+
+        WAVEHDR &header = p_headers[p_next];
+        while ((header.dwFlags & WHDR_DONE) == 0) {
+            WaitForSingleObject(p_event, 100);
+        }
+
+        memcpy(header.lpData, samples, frames * 2 * sizeof(int16_t));
+        header.dwBufferLength = DWORD(frames * 2 * sizeof(int16_t));
+        header.dwFlags &= ~WHDR_DONE;
+        if (waveOutWrite(p_device, &header, sizeof(header)) != MMSYSERR_NOERROR) {
+            header.dwFlags |= WHDR_DONE;
+            return false;
+        }
+
+        p_next = (p_next + 1) % BUFFER_COUNT;
+        return true;
+    }
+
+private:
+    WaveOutAudioOutput(const WaveOutAudioOutput&);
+    WaveOutAudioOutput &operator=(const WaveOutAudioOutput&);
+
+    HWAVEOUT p_device;
+    HANDLE   p_event;
+    WAVEHDR  p_headers[BUFFER_COUNT];
+    size_t   p_frames;
+    int      p_next;
+};
+
 
 // main entry point function, program execution starts here
 int APIENTRY WinMain(
@@ -284,14 +1178,16 @@ int APIENTRY WinMain(
     bool initerror = false;
 
     HWND mainwindow = 0;
-    IDirectInput8A *input = nullptr;
-    InputDeviceList devlist = {};
+    InputDeviceWatcher devices;
     HDC gldc = 0;
     HGLRC glrc = 0;
+    OpenGLCoreAPI coregl;
+    bool corerenderer = false;
+    bool vsync = true;
 
     LARGE_INTEGER frequency;
 
-    WindowData data = { &gldc };
+    WindowData data = { &gldc, &devices };
 
     // this is "loop trick"
     // if some initialization step failed - just break to skip other parts
@@ -328,31 +1224,9 @@ int APIENTRY WinMain(
         // initialize timer frequency
         QueryPerformanceFrequency(&frequency);
 
-        // initialize input (DirectX Input)
-        DirectInput8Create(hInstance, DIRECTINPUT_VERSION, IID_IDirectInput8A, reinterpret_cast<LPVOID*>(&input), nullptr);
-        if (input == nullptr) {
-            // Direct input isn't critical part, game can be run without
-            // any Direct Input devices, just log failure
-            DEBUGPrint(
-                "Couldn't initialize DirectInput, "
-                "running game without game controller support!\n"
-            );
-        } else {
-            // enum joystick/gamepad devices
-            input->EnumDevices(DI8DEVCLASS_GAMECTRL, DIEnumDevicesCallback, &devlist, DIEDFL_ALLDEVICES);
-
-            // initialize all devices found
-            for (size_t dev = 0; dev < devlist.count; ++dev) {
-                IDirectInputDevice8A *device = nullptr;
-                input->CreateDevice(devlist.devices[dev].giud, &device, nullptr);
-                devlist.devices[dev].device = device;
-
-                if (device) {
-                    device->SetCooperativeLevel(mainwindow, DISCL_NONEXCLUSIVE | DISCL_FOREGROUND);
-                    device->SetDataFormat(&c_dfDIJoystick);
-                }
-            }
-        }
+        // initialize input (DirectX Input), devices are found on background
+        // thread and show up as they're ready
+        devices.Start(hInstance, mainwindow);
 
         // initialize OpenGL
         // OpenGL initialization is platform specific, rest of the OpenGL is not
@@ -394,6 +1268,32 @@ int APIENTRY WinMain(
         }
         wglMakeCurrent(gldc, glrc);
 
+        // core profile renderer, -renderer core
+        // core context is made by extension function, which is there only
+        // when some context is current, legacy context stays if core one
+        // can't be made or can't do core renderer
+        char renderer[16];
+        if (CommandLineOption("-renderer", renderer, sizeof(renderer)) && strcmp(renderer, "core") == 0) {
+            HGLRC corerc = CreateCoreContext(gldc);
+            if (corerc && wglMakeCurrent(gldc, corerc) && coregl.Initialize(WGLProcAddress)) {
+                wglDeleteContext(glrc);
+                glrc = corerc;
+                corerenderer = true;
+            } else {
+                DEBUGPrint("Core profile renderer isn't available (%s), using legacy one\n", coregl.log());
+                wglMakeCurrent(gldc, glrc);
+                if (corerc) {
+                    wglDeleteContext(corerc);
+                }
+            }
+        }
+
+        // swap interval belongs to context, so it's set for the one kept
+        vsync = !DisableVSync();
+        if (vsync) {
+            DEBUGPrint("Couldn't turn off vsync, frames are limited to display refresh rate\n");
+        }
+
         // just for testing, set nice background color
         glClearColor(0.2f, 0.4f, 1.0f, 1.0f);
 
@@ -418,15 +1318,147 @@ int APIENTRY WinMain(
             (GetKeyState(VK_CAPITAL) & 1 ? KEY_CAPS : 0) |
             (GetKeyState(VK_NUMLOCK) & 1 ? KEY_NUM : 0);
 
+        // input source selection, real devices by default:
+        //     -script <file>  scripted key events
+        //     -replay <file>  recorded input, game is started with recorded seed
+        //     -archive <file> [-seek <tick>]
+        //                     replay archive, played from given tick
+        //     -bot            bot plays the game
+        //     -record <file>  record input from selected source
+        //     -record-archive <file>
+        //                     record input with game keyframes into seekable archive
+        //     -spectate <n>   n games played by bots shown instead of the game
+        char option[MAX_PATH];
+        bool script = CommandLineOption("-script", option, sizeof(option));
+        bool replay = !script && CommandLineOption("-replay", option, sizeof(option));
+        bool archive = !script && !replay && CommandLineOption("-archive", option, sizeof(option));
+        bool bot = !script && !replay && !archive && CommandLineOption("-bot", option, sizeof(option));
+
+        ScriptInput scriptinput;
+        ReplayInput replayinput;
+        ArchiveInput archiveinput;
+        script = script && scriptinput.Load(option);
+        replay = replay && replayinput.Open(option);
+        archive = archive && archiveinput.Open(option);
+
         WindowsPlatform api;
-        Game game;
+        OpenGLAPI legacygl;
+        OpenGLRenderer *graphics = corerenderer ? static_cast<OpenGLRenderer*>(&coregl) : &legacygl;
+        uint64_t seed = replay ? replayinput.seed() : (archive ? archiveinput.seed() : GetTickCount());
+        Game game(seed);
+
+        if (archive && CommandLineOption("-seek", option, sizeof(option))) {
+            archiveinput.Seek(game, api, uint64_t(_atoi64(option)));
+        }
+
+        BotGames *spectate = nullptr;
+        if (CommandLineOption("-spectate", option, sizeof(option)) && atoi(option) > 0) {
+            spectate = new BotGames(atoi(option), seed);
+        }
+        Spectator spectator(spectate ? spectate->pool().count() : 0);
 
         // update window data structure
-        data.api = &api;
+        data.graphics = graphics;
         data.game = &game;
+        data.spectator = &spectator;
+        data.spectate = spectate;
+
+        WindowsInput hardware(devices);
+        Input hardwareinput = input;
+        HashCache botcache(1 << 16);
+        BotInput botinput(game, BOT_DEFAULT_WEIGHTS, &botcache);
+
+        InputSource *source = &hardware;
+        if (script) {
+            source = &scriptinput;
+        } else if (replay) {
+            source = &replayinput;
+        } else if (archive) {
+            source = &archiveinput;
+        } else if (bot) {
+            source = &botinput;
+        }
+
+        // real devices are always read, when game is driven by other source
+        // they are read separately
+        bool synthetic = source != &hardware;
+
+        RecordingInput recording(*source);
+        if (CommandLineOption("-record", option, sizeof(option)) && recording.Open(option, seed)) {
+            source = &recording;
+        }
+
+        ArchiveRecorder archiverecording(*source, game);
+        if (CommandLineOption("-record-archive", option, sizeof(option)) && archiverecording.Open(option, seed)) {
+            source = &archiverecording;
+        }
+
+        // optional telemetry output:
+        //     -telemetry <file or unix:socket> [-telemetry-interval <seconds>]
+        Telemetry telemetry;
+        if (CommandLineOption("-telemetry", option, sizeof(option))) {
+            char interval[32] = "10";
+            CommandLineOption("-telemetry-interval", interval, sizeof(interval));
+            if (!telemetry.Open(option, atof(interval))) {
+                DEBUGPrint("Couldn't open telemetry output \"%s\"\n", option);
+            }
+        }
+
+        // audio output, waveOut device by default:
+        //     -audio null      no audio output
+        //     -audio <file>    audio is written into .wav file
+        AudioMixer mixer;
+        WaveOutAudioOutput waveaudio;
+        WavFileAudioOutput fileaudio(true);
+        NullAudioOutput nullaudio;
+        AudioOutput *audiooutput = &nullaudio;
+        if (CommandLineOption("-audio", option, sizeof(option))) {
+            if (strcmp(option, "null") != 0 && fileaudio.Open(option)) {
+                audiooutput = &fileaudio;
+            }
+        } else if (waveaudio.Open(AUDIO_BLOCK_FRAMES)) {
+            audiooutput = &waveaudio;
+        } else {
+            DEBUGPrint("Couldn't open audio device\n");
+        }
+        AudioThread audiothread(mixer, *audiooutput);
+        game.LoadAudio(mixer);
+        audiothread.Start();
+
+        // frame rate:
+        //     -fps <hz>             frames are paced to given rate, by default
+        //                           to display refresh rate
+        //     -benchmark <seconds>  no pacing at all, game quits after given
+        //                           time and frame time statistics are written
+        //                           to -benchmark-out <file> (benchmark.txt by default)
+        char fps[32] = "0";
+        CommandLineOption("-fps", fps, sizeof(fps));
+        int framerate = atoi(fps);
+        if (framerate <= 0) {
+            framerate = DisplayRefreshRate(mainwindow);
+        }
+        if (framerate <= 0) {
+            framerate = 60;
+        }
+
+        double benchmark = 0;
+        if (CommandLineOption("-benchmark", option, sizeof(option))) {
+            benchmark = atof(option);
+        }
+        Histogram frametimes;
+
+        // ask for 1 ms timer resolution, so sleeps in pacing are short enough
+        bool timerperiod = benchmark <= 0 && timeBeginPeriod(1) == TIMERR_NOERROR;
 
         LARGE_INTEGER lasttime;
         QueryPerformanceCounter(&lasttime);
+        LARGE_INTEGER starttime = lasttime;
+
+        FramePacer pacer;
+        pacer.Start(0, 1000000 / framerate);
+
+        // game is paused once when window goes to background, player resumes it
+        bool background = false;
 
         bool running = mainwindow != 0;
         while (running) {
@@ -434,140 +1466,150 @@ int APIENTRY WinMain(
             LARGE_INTEGER currenttime;
             QueryPerformanceCounter(&currenttime);
 
+            // scripted and recorded input should play same way regardless of
+            // window state, so only real player's game is paused
+            bool minimized = IsIconic(mainwindow) != 0;
+            bool wasbackground = background;
+            background = minimized || GetForegroundWindow() != mainwindow;
+            if (background && !wasbackground && !synthetic) {
+                game.SetPaused(true);
+            }
+
             // reset event count, events passed by frame basis
             input.event_count = 0;
+            input.event_dropped = 0;
 
-            // pull out all system messages from queue
-            MSG msg;
-            while (PeekMessageA(&msg, 0, 0, 0, PM_REMOVE)) {
-                if (msg.message == WM_QUIT) {
-                    running = false;
+            float interval = float(
+                double(currenttime.QuadPart - lasttime.QuadPart) / double(frequency.QuadPart)
+            );
+            uint32_t time = GetTickCount();
+
+            // other input source gets only ESC from real devices to be able to quit
+            if (synthetic) {
+                hardwareinput.event_count = 0;
+                hardwareinput.event_dropped = 0;
+                running = hardware.NextFrame(hardwareinput, time, interval);
+                if (hardwareinput.keyboard.keys[KEY_ESCAPE]) {
+                    api.Quit();
                 }
+            }
+            if (!source->NextFrame(input, time, interval)) {
+                running = false;
+            }
 
-                TranslateMessage(&msg);
-                DispatchMessageA(&msg);
+            LARGE_INTEGER inputtime;
+            QueryPerformanceCounter(&inputtime);
 
-                // process input from mouse/keyboard and some other messages
-                switch (msg.message) {
-                    case WM_MOUSEMOVE: {
-                        POINTS *pt = reinterpret_cast<POINTS*>(&msg.lParam);
+            // pass input to game, spectated games get input from their bots
+            if (spectate == nullptr) {
+                game.ProcessInput(api, input);
+            }
 
-                        if (InputEvent *event = new_event(input)) {
-                            event->type = INPUT_MOUSE_MOVE;
-                            event->mouse.button = MOUSE_BUTTON_COUNT;
-                            event->mouse.wheel = 0;
-                            event->mouse.x = pt->x;
-                            event->mouse.y = pt->y;
-                        }
+            LARGE_INTEGER processtime;
+            QueryPerformanceCounter(&processtime);
 
-                        input.mouse.x = pt->x;
-                        input.mouse.y = pt->y;
+            // update game state (and animations)
+            if (spectate) {
+                spectate->Update(api, time, interval);
+            } else {
+                game.Update(interval);
+            }
 
-                        break;
-                    }
+            // sounds requested by update go to audio thread
+            game.RenderAudio(mixer);
+
+            LARGE_INTEGER updatetime;
+            QueryPerformanceCounter(&updatetime);
 
-                    case WM_LBUTTONDOWN:
-                        MouseButtonEvent(input, MOUSE_BUTTON_LEFT, true);
-                        break;
+            // render game graphics, paused game is rendered only when
+            // something changed, WM_PAINT takes care of window exposure
+            if (!minimized && (spectate || !game.idle())) {
+                RenderGameFrame(*graphics, mainwindow, gldc, game, &spectator, spectate);
+            }
 
-                    case WM_LBUTTONUP:
-                        MouseButtonEvent(input, MOUSE_BUTTON_LEFT, false);
-                        break;
+            if (telemetry.active()) {
+                LARGE_INTEGER rendertime;
+                QueryPerformanceCounter(&rendertime);
+
+                uint64_t phases[TELEMETRY_PHASE_COUNT] = {
+                    Microseconds(currenttime, inputtime, frequency),
+                    Microseconds(inputtime, processtime, frequency),
+                    Microseconds(processtime, updatetime, frequency),
+                    Microseconds(updatetime, rendertime, frequency)
+                };
+                telemetry.RecordFrame(Microseconds(lasttime, currenttime, frequency), phases, input);
+
+                // event timestamps come from system tick counter, so latency
+                // precision is limited by its resolution, other sources have
+                // recorded or made up times, latency means nothing for them
+                if (!synthetic) {
+                    DWORD displaytime = GetTickCount();
+                    for (size_t ev = 0; ev < input.event_count; ++ev) {
+                        telemetry.RecordLatency(uint64_t(displaytime - input.events[ev].time) * 1000);
+                    }
+                }
 
-                    case WM_RBUTTONDOWN:
-                        MouseButtonEvent(input, MOUSE_BUTTON_RIGHT, true);
-                        break;
+                telemetry.Flush(double(rendertime.QuadPart - starttime.QuadPart) / double(frequency.QuadPart));
+            }
 
-                    case WM_RBUTTONUP:
-                        MouseButtonEvent(input, MOUSE_BUTTON_RIGHT, false);
-                        break;
+            lasttime = currenttime;
 
-                    case WM_SYSKEYDOWN:
-                    case WM_KEYDOWN:
-                        KeyboardEvent(input, InputKey(msg.wParam), true);
-                        break;
+            if (benchmark > 0) {
+                LARGE_INTEGER frameend;
+                QueryPerformanceCounter(&frameend);
+                frametimes.Record(Microseconds(currenttime, frameend, frequency));
 
-                    case WM_SYSKEYUP:
-                    case WM_KEYUP:
-                        KeyboardEvent(input, InputKey(msg.wParam), false);
-                        break;
+                if (double(frameend.QuadPart - starttime.QuadPart) / double(frequency.QuadPart) >= benchmark) {
+                    running = false;
                 }
+                continue;
             }
 
-            // process input from joystick/gamepad
-            for (uint32_t dev = 0; dev < devlist.count; ++dev) {
-                IDirectInputDevice8A *device = devlist.devices[dev].device;
-                if (device) {
-                    // get current device state
-                    DIJOYSTATE state = {};
-                    bool statereceived = true;
-                    if (device->GetDeviceState(sizeof(state), &state) != S_OK) {
-                        device->Acquire();
-                        statereceived = device->GetDeviceState(sizeof(state), &state) == S_OK;;
-                    }
+            // nothing goes on until player does something, frame schedule
+            // and interval start over after wait
+            // spectated bot games keep running while window is seen
+            if (!synthetic && (minimized || (spectate == nullptr && game.idle()))) {
+                WaitForInput(devices);
 
-                    if (statereceived) {
-                        for (uint32_t btn = 0; btn < JOY_BUTTON_COUNT; ++btn) {
-                            uint32_t button_bit = 1 << btn;
-                            bool newstate = state.rgbButtons[btn] >= 128;
-                            bool oldstate = (input.joystick[dev].buttons & button_bit) != 0;
-
-                            if (oldstate != newstate) {
-                                if (InputEvent *event = new_event(input)) {
-                                    event->type = newstate ? INPUT_BUTTON_DOWN : INPUT_BUTTON_UP;
-                                    event->joystick.number = dev;
-                                    event->joystick.button = InputJoystickButton(btn);
-                                }
-                            }
-
-                            if (newstate) {
-                                input.joystick[dev].buttons |= button_bit;
-                            } else {
-                                input.joystick[dev].buttons &= ~button_bit;
-                            }
-                        }
-
-                        for (uint32_t pov = 0; pov < JOY_POV_COUNT; ++pov) {
-                            int povvalue = state.rgdwPOV[pov];
-                            if (input.joystick[dev].povs[pov] != povvalue) {
-                                input.joystick[dev].povs[pov] = povvalue;
-                                if (InputEvent *event = new_event(input)) {
-                                    event->type = INPUT_POV;
-                                    event->joystick.number = dev;
-                                    event->joystick.pov.pov = InputJoystickPOV(pov);
-                                    event->joystick.pov.value = povvalue;
-                                }
-                            }
-                        }
-
-                        CheckJoyAxis(input, dev, JOY_AXIS_0, state.lX);
-                        CheckJoyAxis(input, dev, JOY_AXIS_1, state.lY);
-                        CheckJoyAxis(input, dev, JOY_AXIS_2, state.lZ);
-                        CheckJoyAxis(input, dev, JOY_AXIS_3, state.lRx);
-                        CheckJoyAxis(input, dev, JOY_AXIS_4, state.lRy);
-                        CheckJoyAxis(input, dev, JOY_AXIS_5, state.lRz);
-                        CheckJoyAxis(input, dev, JOY_AXIS_6, state.rglSlider[0]);
-                        CheckJoyAxis(input, dev, JOY_AXIS_7, state.rglSlider[1]);
-                    }
-                }
+                QueryPerformanceCounter(&lasttime);
+                pacer.Start(Microseconds(starttime, lasttime, frequency), 1000000 / framerate);
+                continue;
             }
 
-            // pass input to game
-            game.ProcessInput(api, input);
+            // wait for next frame time
+            LARGE_INTEGER frameend;
+            QueryPerformanceCounter(&frameend);
+            pacer.NextFrame(Microseconds(starttime, frameend, frequency));
+            WaitForFrame(pacer, starttime, frequency);
+        }
+
+        if (timerperiod) {
+            timeEndPeriod(1);
+        }
 
-            // update game state (and animations)
-            game.Update(
-                float(double(currenttime.QuadPart - lasttime.QuadPart) /
-                      double(frequency.QuadPart))
-            );
-            lasttime = currenttime;
+        audiothread.Stop();
 
-            // render game graphics
-            RenderGameFrame(api, mainwindow, gldc, game);
+        if (benchmark > 0) {
+            if (!CommandLineOption("-benchmark-out", option, sizeof(option))) {
+                strcpy_s(option, "benchmark.txt");
+            }
 
-            // sleep 10ms
-            Sleep(10);
+            if (FILE *report = fopen(option, "a")) {
+                // frames limited by vsync aren't uncapped, that's reported
+                fprintf(
+                    report,
+                    "frames %llu, frame time min %.3f ms, avg %.3f ms, p99 %.3f ms, max %.3f ms%s\n",
+                    (unsigned long long)frametimes.count(),
+                    frametimes.min() / 1000.0, frametimes.mean() / 1000.0,
+                    frametimes.Percentile(0.99) / 1000.0, frametimes.max() / 1000.0,
+                    vsync ? ", vsync couldn't be turned off" : ""
+                );
+                fclose(report);
+            }
         }
+
+        data.spectate = nullptr;
+        delete spectate;
     }
 
     // clean up OpenGL
@@ -581,17 +1623,7 @@ int APIENTRY WinMain(
     }
 
     // clean up input
-    if (input) {
-        for (size_t dev = 0; dev < devlist.count; ++dev) {
-            IDirectInputDevice8A *device = devlist.devices[dev].device;
-            if (device) {
-                device->Unacquire();
-                device->Release();
-            }
-        }
-
-        input->Release();
-    }
+    devices.Stop();
 
     // destroy main window
     DestroyWindow(mainwindow);